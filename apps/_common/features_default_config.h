@@ -106,6 +106,48 @@
 #ifndef OT_PARAM_VLFPS
 #   define OT_PARAM_VLFPS               3                                   // Number of files that can be open simultaneously
 #endif
+#ifndef OT_PARAM_VLWATCHERS
+#   define OT_PARAM_VLWATCHERS          8                                   // Number of Veelite file watchers (1-16)
+#endif
+#ifndef OT_PARAM_VLHDRCACHE
+#   define OT_PARAM_VLHDRCACHE          4                                   // Number of Veelite file headers with cached updates
+#endif
+#ifndef OT_PARAM_OTAT_SIZE
+#   define OT_PARAM_OTAT_SIZE           8                                   // Number of OTAt actions that may be registered
+#endif
+#ifndef OT_PARAM_OTAT_WINDOW
+#   define OT_PARAM_OTAT_WINDOW         16                                  // Ticks: OTAt actions due this close together run in one wakeup
+#endif
+#ifndef OT_PARAM_OTAT_ALPID
+#   define OT_PARAM_OTAT_ALPID          6                                   // ALP ID used by OTAt
+#endif
+#ifndef OT_PARAM_DASHFORTH_DSTACK
+#   define OT_PARAM_DASHFORTH_DSTACK    16                                  // DASHForth data stack cells
+#endif
+#ifndef OT_PARAM_DASHFORTH_RSTACK
+#   define OT_PARAM_DASHFORTH_RSTACK    8                                   // DASHForth return stack cells
+#endif
+#ifndef OT_PARAM_DASHFORTH_VARS
+#   define OT_PARAM_DASHFORTH_VARS      8                                   // DASHForth variables
+#endif
+#ifndef OT_PARAM_DASHFORTH_INSIZE
+#   define OT_PARAM_DASHFORTH_INSIZE    32                                  // Bytes of DASHForth applet input
+#endif
+#ifndef OT_PARAM_DASHFORTH_OUTSIZE
+#   define OT_PARAM_DASHFORTH_OUTSIZE   32                                  // Bytes of DASHForth applet output
+#endif
+#ifndef OT_PARAM_DASHFORTH_CODESIZE
+#   define OT_PARAM_DASHFORTH_CODESIZE  128                                 // Bytes of DASHForth applet bytecode
+#endif
+#ifndef OT_PARAM_DASHFORTH_MAXOPS
+#   define OT_PARAM_DASHFORTH_MAXOPS    20000                               // Instructions a DASHForth applet may run, in total
+#endif
+#ifndef OT_PARAM_DASHFORTH_OPSPERTICK
+#   define OT_PARAM_DASHFORTH_OPSPERTICK 64                                 // DASHForth instructions per tick (conservative)
+#endif
+#ifndef OT_PARAM_DASHFORTH_SLICE
+#   define OT_PARAM_DASHFORTH_SLICE     2                                   // Ticks: DASHForth task reserve, and synchronous run limit
+#endif
 #ifndef OT_PARAM_SESSION_DEPTH
 #   define OT_PARAM_SESSION_DEPTH       4                                   // Max simultaneous sessions (i.e. tasks)
 #endif
@@ -138,7 +180,7 @@
 #   define OT_FEATURE_C_SERVER          (OT_FEATURE_CAPI)                   // "otapi" C function usage in server-side apps
 #endif
 #ifndef OT_FEATURE_DASHFORTH
-#   define OT_FEATURE_DASHFORTH         NOT_AVAILABLE                       // DASHFORTH Applet VM (server-side), or JIT (client-side)
+#   define OT_FEATURE_DASHFORTH         DISABLED                            // DASHFORTH Applet VM (server-side)
 #endif
 #ifndef OT_FEATURE_LOGGER
 #   define OT_FEATURE_LOGGER            ENABLED                             // Mpipe-based data logging & printing
@@ -168,7 +210,19 @@
 #   define OT_FEATURE_VLNEW             ENABLED                             // File create/delete in Veelite
 #endif
 #ifndef OT_FEATURE_VLRESTORE
-#   define OT_FEATURE_VLRESTORE         DISABLED                            // File restore in Veelite
+#   define OT_FEATURE_VLRESTORE         DISABLED                            // File restore (delta patching) in Veelite
+#endif
+#ifndef OT_FEATURE_VLWATCH
+#   define OT_FEATURE_VLWATCH           ENABLED                             // File change watchers in Veelite
+#endif
+#ifndef OT_FEATURE_VLHDRCACHE
+#   define OT_FEATURE_VLHDRCACHE        DISABLED                            // Write-back cache for Veelite header updates (needs vl_flush() on power-down)
+#endif
+#ifndef OT_FEATURE_VLRING
+#   define OT_FEATURE_VLRING            ENABLED                             // Circular log (ring) files in Veelite
+#endif
+#ifndef OT_FEATURE_OTAT
+#   define OT_FEATURE_OTAT              DISABLED                            // OTAt timed-action (at/cron) service
 #endif
 #ifndef OT_FEATURE_VL_SECURITY
 #   define OT_FEATURE_VL_SECURITY       NOT_AVAILABLE                       // AES128 on pre-shared key, for stored files
@@ -287,6 +341,27 @@
 #ifndef M2_FEATURE_BEACONS
 #   define M2_FEATURE_BEACONS           ENABLED                             // Automated Beacon transmissions
 #endif
+#ifndef M2_FEATURE_ACKBLOOM
+#   define M2_FEATURE_ACKBLOOM          ENABLED                             // Bloom-filter encoded A2P ack lists
+#endif
+#ifndef M2_FEATURE_QUERYCACHE
+#   define M2_FEATURE_QUERYCACHE        ENABLED                             // Memoize results of repeated M2QP queries
+#endif
+#ifndef M2_FEATURE_AGGREGATE
+#   define M2_FEATURE_AGGREGATE         ENABLED                             // On-node aggregation commands (M2QP)
+#endif
+#ifndef M2_PARAM_AGG_LASTN
+#   define M2_PARAM_AGG_LASTN           8                                   // Max elements returned by an aggregate "last N"
+#endif
+#ifndef M2_PARAM_REQIMAGE
+#   define M2_PARAM_REQIMAGE            48                                  // Max transport payload of a C API request image (0 = disabled)
+#endif
+#ifndef M2_PARAM_REQPATCHES
+#   define M2_PARAM_REQPATCHES          4                                   // Max patch points in a C API request image
+#endif
+#ifndef M2_PARAM_QUERYCACHE
+#   define M2_PARAM_QUERYCACHE          4                                   // Number of cached query results (1-255)
+#endif
 #ifndef M2_PARAM_BEACON_TCA
 #   define M2_PARAM_BEACON_TCA          12                                  // Ticks to do CSMA for Beacons
 #endif
@@ -305,11 +380,11 @@
 
 
 /// General derived constants
-#if (!defined(M2_PARAM_MFPP) && M2_FEATURE_M2DP)
-#   define M2_PARAM_MFPP                4                                   // Max Frames Per Packet (1-255, partly device-dependent)
-#else
+#if (M2_FEATURE_M2DP != ENABLED)
 #   undef M2_PARAM_MFPP
 #   define M2_PARAM_MFPP                1                                   // MFPP always 1 when M2DP is DISABLED (don't change)
+#elif !defined(M2_PARAM_MFPP)
+#   define M2_PARAM_MFPP                4                                   // Max Frames Per Packet (1-255, partly device-dependent)
 #endif
 #define M2_FEATURE_MULTIFRAME           (M2_PARAM_MFPP > 1)
 #define M2_FEATURE_RTC_SCHEDULER        (M2_FEATURE_RTCSLEEP || M2_FEATURE_RTCHOLD || M2_FEATURE_RTCSBEACON)
@@ -189,7 +189,7 @@
   */
 #define ISF_TOTAL_BYTES                         1536
 #define ISF_NUM_M1_FILES                        7
-#define ISF_NUM_M2_FILES                        18
+#define ISF_NUM_M2_FILES                        19
 #define ISF_NUM_EXT_FILES                       1   // Usually at least 1 (app ext)
 #define ISF_NUM_USER_FILES                      0  //max allowed user files
 
@@ -255,6 +255,7 @@
 #define ISF_ID_hardware_fault_status            0x16
 #define ISF_ID_gnss_output                      0x17
 #define ISF_ID_agps_input                       0x18
+#define ISF_ID_radio_fifo_stats                 0x19
 #define ISF_ID_application_extension            0xFF
 
 /// ISF Mirror Enabling: <BR>
@@ -287,6 +288,7 @@
 #define ISF_ENMIRROR_hardware_fault_status      __SET_MIRROR(0)
 #define ISF_ENMIRROR_gnss_output                __SET_MIRROR(1)
 #define ISF_ENMIRROR_agps_input                 __SET_MIRROR(1)
+#define ISF_ENMIRROR_radio_fifo_stats           __SET_MIRROR(1)
 #define ISF_ENMIRROR_application_extension      __SET_MIRROR(1)
 
 
@@ -324,6 +326,7 @@
 #define ISF_MOD_hardware_fault_status           b00100100
 #define ISF_MOD_gnss_output                     b00100000
 #define ISF_MOD_agps_input                      b00110000
+#define ISF_MOD_radio_fifo_stats                b00100100
 #define ISF_MOD_application_extension           b00100100
 
 /// ISF file default length: 
@@ -354,6 +357,7 @@
 #define ISF_LEN_hardware_fault_status           3
 #define ISF_LEN_gnss_output                     0
 #define ISF_LEN_agps_input                      0
+#define ISF_LEN_radio_fifo_stats                0
 #define ISF_LEN_application_extension           0
 
 /// Stock ISF file max data lengths (not aligned, just max)
@@ -384,6 +388,7 @@
 #define ISF_MAX_hardware_fault_status           3
 #define ISF_MAX_gnss_output                     96  // Designed to support UBX-8 NAV-PVT
 #define ISF_MAX_agps_input                      200 // Designed for GPS MGA messages on UBX-8
+#define ISF_MAX_radio_fifo_stats                16  // RX FIFO thresholds & lags, 8 classes
 #define ISF_MAX_application_extension           64
 
 
@@ -423,7 +428,8 @@
 #   define ISF_BASE_hardware_fault_status       (ISF_BASE_table_query_results+ISF_ALLOC(table_query_results))
 #   define ISF_BASE_gnss_output                 (ISF_BASE_hardware_fault_status+ISF_ALLOC(hardware_fault_status))
 #   define ISF_BASE_agps_input                  (ISF_BASE_gnss_output+ISF_ALLOC(gnss_output))
-#   define ISF_BASE_application_extension       (ISF_BASE_agps_input+ISF_ALLOC(agps_input))
+#   define ISF_BASE_radio_fifo_stats            (ISF_BASE_agps_input+ISF_ALLOC(agps_input))
+#   define ISF_BASE_application_extension       (ISF_BASE_radio_fifo_stats+ISF_ALLOC(radio_fifo_stats))
 #   define ISF_BASE_NEXT                        (ISF_BASE_application_extension+ISF_ALLOC(application_extension ))
 
 #else
@@ -452,6 +458,7 @@
 #   define ISF_BASE_hardware_fault_status       (ISF_BASE_table_query_results+ISF_ALLOC(table_query_results))
 #   define ISF_BASE_gnss_output                 (0xFFFF)
 #   define ISF_BASE_agps_input                  (0xFFFF)
+#   define ISF_BASE_radio_fifo_stats            (0xFFFF)
 #   define ISF_BASE_application_extension       (0xFFFF)
 #   define ISF_BASE_NEXT                        (ISF_BASE_hardware_fault_status+ISF_ALLOC(hardware_fault_status))
 #endif
@@ -484,7 +491,8 @@
 #define ISF_MIRROR_hardware_fault_status        (ISF_MIRROR_table_query_results+ISF_MIRALLOC(table_query_results))
 #define ISF_MIRROR_gnss_output                  (ISF_MIRROR_hardware_fault_status+ISF_MIRALLOC(hardware_fault_status))
 #define ISF_MIRROR_agps_input                   (ISF_MIRROR_gnss_output+ISF_MIRALLOC(gnss_output))
-#define ISF_MIRROR_application_extension        (ISF_MIRROR_agps_input+ISF_MIRALLOC(agps_input))
+#define ISF_MIRROR_radio_fifo_stats             (ISF_MIRROR_agps_input+ISF_MIRALLOC(agps_input))
+#define ISF_MIRROR_application_extension        (ISF_MIRROR_radio_fifo_stats+ISF_MIRALLOC(radio_fifo_stats))
 #define ISF_MIRROR_NEXT                         (ISF_MIRROR_application_extension+ISF_MIRALLOC(application_extension))
 
 
@@ -514,6 +522,7 @@
                                 ISF_ALLOC(hardware_fault_status) + \
                                 ISF_ALLOC(gnss_output) + \
                                 ISF_ALLOC(agps_input) + \
+                                ISF_ALLOC(radio_fifo_stats) + \
                                 ISF_ALLOC(application_extension))
 
 #define ISF_VWORM_HEAP_BYTES    ISF_VWORM_STOCK_BYTES
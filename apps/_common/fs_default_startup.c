@@ -360,6 +360,13 @@ const ot_u8 overhead_files[] = {
     SPLIT_SHORT_LE(ISF_BASE(agps_input)),
     SPLIT_SHORT_LE(ISF_MIRROR(agps_input)),
 
+    ISF_LEN(radio_fifo_stats), 0x00,
+    SPLIT_SHORT_LE(ISF_ALLOC(radio_fifo_stats)),
+    ISF_ID(radio_fifo_stats),
+    ISF_MOD(radio_fifo_stats),
+    SPLIT_SHORT_LE(ISF_BASE(radio_fifo_stats)),
+    SPLIT_SHORT_LE(ISF_MIRROR(radio_fifo_stats)),
+
     ISF_LEN(application_extension), 0x00,
     SPLIT_SHORT_LE(ISF_ALLOC(application_extension)),
     ISF_ID(application_extension),
@@ -595,6 +602,9 @@ const ot_u8 isf_stock_files[] = {
 	/* AGPS Input id=0x18, len=0, alloc=? */
 	/* Stored Exclusively in mirror */
 
+    /* Radio FIFO Stats: id=0x19, len=0, alloc=16 */
+    /* Stored Exclusively in mirror */
+
     /* Application Extension: id=0xFF, len=0, alloc=64 */
     /* Stored Exclusively in mirror */
 };
@@ -38,20 +38,66 @@
 
 
 
+/** @brief Computes CRC32 over a block of data
+  * @param block_addr   (ot_u8*) start of the block (need not be aligned)
+  * @param block_words  (ot_uint) number of 32 bit words in the block
+  * @retval ot_u32      CRC32 of the block
+  * @ingroup CRC32
+  */
 ot_u32 crc32_calc_block(ot_u8* block_addr, ot_uint block_words);
 
 
+/** @brief Updates a running CRC32 with arbitrary-length data
+  * @param crc          (ot_u32) CRC32 of the preceding data, or 0 to start
+  * @param data         (ot_u8*) data to add to the CRC
+  * @param length       (ot_u32) number of bytes of data
+  * @retval ot_u32      CRC32 of all data so far
+  * @ingroup CRC32
+  *
+  * This is for large data (e.g. whole files or firmware images), which can be
+  * fed in any number of pieces of any size.  Not all platforms implement it.
+  */
+ot_u32 crc32_update(ot_u32 crc, ot_u8* data, ot_u32 length);
+
+
+/** @brief Sets up a CRC32 stream
+  * @param writeout     (ot_bool) True to write the CRC after the stream data
+  * @param stream_words (ot_uint) number of 32 bit words in the stream
+  * @param stream       (ot_u8*) start of the stream data
+  * @retval None
+  * @ingroup CRC32
+  */
 void crc32_init_stream(ot_bool writeout, ot_uint stream_words, ot_u8* stream);
 
 
+/** @brief Adds the next word of the stream to the CRC
+  * @retval None
+  * @ingroup CRC32
+  *
+  * Once all the words are processed, the next call writes out the CRC (if 
+  * writeout was set in crc32_init_stream()).
+  */
 void crc32_calc_stream();
 
 
+/** @brief Same as crc32_calc_stream(), but for n words at once
+  * @param n_words      (ot_uint) number of 32 bit words to process
+  * @retval None
+  * @ingroup CRC32
+  */
 void crc32_calc_nstream(ot_uint n_words);
 
 
+/** @brief Checks a stream that has a CRC32 at the end of it.
+  * @retval ot_bool     True if the CRC32 validates
+  * @ingroup CRC32
+  */
 ot_bool crc32_check();
 
 
-ot_u16 crc32_get();
+/** @brief Returns the CRC32 of the stream, so far
+  * @retval ot_u32      CRC32 value
+  * @ingroup CRC32
+  */
+ot_u32 crc32_get();
 
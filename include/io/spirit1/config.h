@@ -72,6 +72,7 @@
 #define RF_FEATURE_RXTIMER              DISABLED            // RX Timeout capability    Low
 #define RF_FEATURE_TXTIMER              DISABLED            // TX MAC capability        DASH7-specific
 #define RF_FEATURE_CSMATIMER            DISABLED
+#define RF_FEATURE_FIFOADAPT            ENABLED             // Adaptive RX FIFO threshold (driver)
 
 //More esoteric stuff
 #define RF_FEATURE_SCANCYCLE            DISABLED            // Wake-on scan cycle       DASH7-specific
@@ -94,6 +95,12 @@
 #define RF_PARAM_RCO_CAL_INTERVAL       32                      //SPIRIT1-Specific
 #define RF_PARAM_VCO_CAL_INTERVAL       32                      //SPIRIT1-Specific
 
+// Largest FIFO transfer in one SPI transaction.  spirit1.busrx is this size.
+// The default moves a full FIFO, so each FIFO interrupt is one transaction.
+#ifndef RF_PARAM_BURST_BYTES
+#   define RF_PARAM_BURST_BYTES         RF_FEATURE_RXFIFO_BYTES //SPIRIT1-Specific
+#endif
+
 
 /** Radio Buffer Allocation constants
   * SPIRIT1 has internal buffer
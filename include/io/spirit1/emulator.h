@@ -0,0 +1,168 @@
+/* Copyright 2016 JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+/**
+  * @file       /include/io/spirit1/emulator.h
+  * @author     JP Norair
+  * @version    R100
+  * @date       20 Oct 2016
+  * @brief      Register-level SPIRIT1 emulator for the POSIX C platform
+  * @ingroup    SPIRIT1
+  *
+  * The POSIX C platform driver (platform/posix_c/io_SPIRIT1.c) implements the
+  * SPIRIT1 SPI bus, GPIO pins and GPIO interrupts on top of a software model
+  * of the chip, so the real driver (io/spirit1/radio_rm2.c) runs unmodified.
+  * The model includes:
+  * <LI> The register file, with the status registers computed on read </LI>
+  * <LI> The 96 byte TX and RX FIFOs, with almost-full/empty thresholds </LI>
+  * <LI> The MC state machine: STANDBY, SLEEP, READY, LOCK, RX, TX </LI>
+  * <LI> GPIO0-3 outputs, per GPIOx_CONF, and the edge interrupts on them </LI>
+  * <LI> RX timeout timer, LDC timer, and RSSI-threshold carrier sense, which
+  *      is what the driver uses for CSMA </LI>
+  *
+  * The model works at the packet handler's data layer: bytes on the air are
+  * the bytes in the FIFO.  Whitening, FEC, CRC and AES are not modeled.
+  *
+  * There is no thread behind the model.  It keeps virtual time in us, and the
+  * caller advances it with spirit1emu_run().  ISRs are called synchronously
+  * from spirit1emu_run() and from SPI transfers, like a MCU with one interrupt
+  * priority level for the radio.  Packets come in with spirit1emu_inject() and
+  * go out through the callback set with spirit1emu_set_txfn().
+  *
+  ******************************************************************************
+  */
+
+#ifndef __IO_SPIRIT1_EMULATOR_H
+#define __IO_SPIRIT1_EMULATOR_H
+
+#include <otstd.h>
+
+
+/** @typedef spirit1emu_txfn
+  * Called when the model has sent a packet.  sync is SYNC1:SYNC4, data is the
+  * packet as read from the TX FIFO, length is PCKTLEN.
+  */
+typedef void (*spirit1emu_txfn)(ot_u32 sync, const ot_u8* data, ot_int length);
+
+
+/** @typedef spirit1emu_stats
+  * Counters for profiling the driver against the model.  Times in _us fields
+  * are virtual time.  Times in _ns fields are host CPU time spent in the ISRs.
+  *
+  * rx_peak is the fullest the RX FIFO has been, and tx_trough is the emptiest
+  * the TX FIFO has been during a TX: they show how close a FIFO refill
+  * strategy runs to overflow or underflow.
+  */
+typedef struct {
+    ot_u32  spi_transfers;
+    ot_u32  spi_bytes;
+    ot_u32  spi_us;
+    ot_u32  isr_calls[3];
+    ot_u32  isr_ns[3];
+    ot_u32  rx_syncs;
+    ot_u32  rx_missed;
+    ot_u32  rx_packets;
+    ot_u32  rx_bytes;
+    ot_u32  rx_overflows;
+    ot_u32  rx_underreads;
+    ot_u32  tx_packets;
+    ot_u32  tx_bytes;
+    ot_u32  tx_underflows;
+    ot_u32  tx_overflows;
+    ot_u8   rx_peak;
+    ot_u8   tx_trough;
+} spirit1emu_stats;
+
+
+
+/** @brief  Power-cycles the model: registers to reset values, state to READY
+  * @param  None
+  * @retval None
+  * @ingroup SPIRIT1
+  */
+void spirit1emu_reset(void);
+
+
+/** @brief  Advances virtual time, running any chip events and ISRs due
+  * @param  us          (ot_u32) microseconds to advance
+  * @retval None
+  * @ingroup SPIRIT1
+  */
+void spirit1emu_run(ot_u32 us);
+
+
+/** @brief  Returns virtual time
+  * @param  None
+  * @retval ot_u32      microseconds since the emulator started
+  * @ingroup SPIRIT1
+  */
+ot_u32 spirit1emu_time(void);
+
+
+/** @brief  Sets the channel RSSI when no packet is on the air
+  * @param  rssi        (ot_u8) RSSI in RSSI_LEVEL encoding (0.5 dB, 0 = -130 dBm)
+  * @retval None
+  * @ingroup SPIRIT1
+  */
+void spirit1emu_set_rssi(ot_u8 rssi);
+
+
+/** @brief  Puts a packet on the air, starting now
+  * @param  sync        (ot_u32) sync word (SYNC1:SYNC4), or 0 to match any
+  * @param  rssi        (ot_u8) RSSI of the packet, in RSSI_LEVEL encoding
+  * @param  data        (const ot_u8*) packet data, as it should enter the RX FIFO
+  * @param  length      (ot_int) packet data length
+  * @retval ot_int      0 on success, -1 if another packet is on the air
+  * @ingroup SPIRIT1
+  *
+  * The packet is received if the model is in RX when its sync word ends, and
+  * the sync word matches.  Bytes beyond length, up to PCKTLEN, are zeros.
+  */
+ot_int spirit1emu_inject(ot_u32 sync, ot_u8 rssi, const ot_u8* data, ot_int length);
+
+
+/** @brief  Sets the callback for sent packets
+  * @param  txfn        (spirit1emu_txfn) callback, or NULL
+  * @retval None
+  * @ingroup SPIRIT1
+  */
+void spirit1emu_set_txfn(spirit1emu_txfn txfn);
+
+
+/** @brief  Reads a register without the side effects of an SPI read
+  * @param  addr        (ot_u8) register address
+  * @retval ot_u8       register value
+  * @ingroup SPIRIT1
+  */
+ot_u8 spirit1emu_peek(ot_u8 addr);
+
+
+/** @brief  Returns the profiling counters
+  * @param  None
+  * @retval spirit1emu_stats*   counters, updated live
+  * @ingroup SPIRIT1
+  */
+const spirit1emu_stats* spirit1emu_getstats(void);
+
+
+/** @brief  Clears the profiling counters
+  * @param  None
+  * @retval None
+  * @ingroup SPIRIT1
+  */
+void spirit1emu_clearstats(void);
+
+
+#endif
@@ -61,9 +61,9 @@
   * <LI>busrx   (ot_u8) scratch space for RX'ed SPI bus data </LI>
   *
   * @note The maximum SPI transfer depends on the allocation of busrx.  A DMA
-  *       is used with the SPI, so it needs to dump the RX data here.  24 bytes
-  *       is quite safe with the current implementation, and it is unlikely to
-  *       be too small for any implementation based on the current one.
+  *       is used with the SPI, so it needs to dump the RX data here.  It is
+  *       RF_PARAM_BURST_BYTES long, which by default is the size of the FIFO,
+  *       so radio_getburst() can empty the FIFO in one transfer.
   *
   * @note The results of any SPI read will get stored in spirit1.busrx.  If you
   *       use a function in this interface library that returns a value from
@@ -85,7 +85,7 @@ typedef struct {
 #   endif
     SPIRIT1_IMode   imode;
     ot_u16          status;
-    ot_u8           busrx[24];
+    ot_u8           busrx[RF_PARAM_BURST_BYTES];
 } spirit1_struct;
 
 extern spirit1_struct spirit1;
@@ -204,11 +204,10 @@ void spirit1_spibus_wait();
   *
   * spirit1_spibus_io() can be used for any sort of SPI-based IO to the SPIRIT1.
   * The return data from the SPIRIT1 is stored in spirit1.busrx.  The allocation
-  * of spirit1.busrx (typically 24 bytes) stipulates the maximum amount of data
-  * that can be transfered (+2) in a single call to this function.  Therefore,
-  * with 24 bytes allocated to busrx, (cmd_len + resp_len) must be less than or 
-  * equal to 26 bytes.  In practice, this is more than enough for OpenTag in 
-  * its current implementation.
+  * of spirit1.busrx (RF_PARAM_BURST_BYTES) stipulates the maximum amount of
+  * data that can be transfered (+2) in a single call to this function.  With
+  * the default of 96 bytes, (cmd_len + resp_len) must be less than or equal to
+  * 98 bytes, which is a full FIFO plus the command header.
   */
 void spirit1_spibus_io(ot_u8 cmd_len, ot_u8 resp_len, ot_u8* cmd);
 
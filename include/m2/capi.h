@@ -421,6 +421,19 @@ ot_u16 otapi_put_isf_return(ot_u8* status, isfcall_tmpl* isfcall);
 
 
 
+/** @brief  Writes ISF aggregate call data to the request queue.
+  * @param  status      (ot_u8*) returns a status code (0 = error)
+  * @param  isfagg      (isfagg_tmpl*) isf aggregate call data for request
+  * @retval ot_u16      post-op length of the TX queue
+  *
+  * Used with the Aggregation commands (CMD_aggregate_on_file/series) in place
+  * of otapi_put_isf_call().  Responders return the reduction of the called
+  * data, rather than the data.  See m2qp_isf_aggregate() in m2/transport.h.
+  */
+ot_u16 otapi_put_isf_agg(ot_u8* status, isfagg_tmpl* isfagg);
+
+
+
 
 /** @brief  Writes the request datastream command, including read directives
   * @param  status      (ot_u8*) returns a status code (0 = error)
@@ -482,6 +495,105 @@ ot_u16 otapi_put_propds(ot_u8* status, ot_queue* dsq);
   */
 ot_u16 otapi_put_udp_tmpl(ot_u8* status, udp_tmpl* udp);
 
+
+
+
+/**
+  * Request Image API Functions (implemented in capi.c)
+  * ========================================================================<BR>
+  * A request that is sent over and over can be compiled once into a request
+  * image, and replayed later without serializing any templates.  To compile
+  * an image, build the request as usual with otapi_open_request() and the
+  * otapi_put_...() functions, and then call otapi_compile_request() instead
+  * of otapi_close_request().  Fields that change between requests (a token,
+  * a timestamp) are marked as patch points while building, and are updated in
+  * the image with otapi_patch_request() before replaying it.
+  *
+  * The M2NP header is not part of the image.  otapi_replay_request() writes a
+  * new header for the top session, so the dialog ID, addressing, and source
+  * ID are always current.  Replaying a request is one header write and one
+  * copy of the image.
+  *
+  * The image size and patch count are set by M2_PARAM_REQIMAGE and
+  * M2_PARAM_REQPATCHES.  Request images are not available when
+  * M2_PARAM_REQIMAGE is 0 or undefined.
+  */
+#if (M2_PARAM(REQIMAGE) > 0)
+
+typedef struct {
+    ot_u8   offset;
+    ot_u8   length;
+} reqpatch_tmpl;
+
+typedef struct {
+    ot_u8           addressing;
+    ot_u8           cmd_code;
+    ot_u8           cmd_ext;
+    ot_u8           length;
+    ot_u8           patches;
+    ot_u8           rx_channels;
+    ot_long         rx_timeout;
+    reqpatch_tmpl   patch[M2_PARAM(REQPATCHES)];
+    ot_u8           data[M2_PARAM(REQIMAGE)];
+} reqimg_tmpl;
+
+
+
+/** @brief  Marks a patch point at the TX queue cursor of the request being built
+  * @param  status      (ot_u8*) returns a status code (0 = error)
+  * @param  skip        (ot_u8) bytes from the cursor to the start of the patch
+  * @param  length      (ot_u8) length of the patch in bytes
+  * @retval ot_u16      Index of the patch point
+  * @ingroup OTAPI_c
+  *
+  * Call it just before the otapi_put_...() function that writes the field.
+  * For example, the token of a query template is marked with skip = 2, to
+  * jump over the query length and code bytes.  Patch points are indexed in
+  * the order they are marked, starting from 0.
+  */
+ot_u16 otapi_mark_patch(ot_u8* status, ot_u8 skip, ot_u8 length);
+
+
+
+/** @brief  Compiles the request being built into a request image
+  * @param  status      (ot_u8*) returns a status code (0 = error)
+  * @param  image       (reqimg_tmpl*) image to compile into
+  * @retval ot_u16      Length of the image in bytes
+  * @ingroup OTAPI_c
+  *
+  * The image stores the transport payload (everything after the M2NP header)
+  * and the dialog settings made by the template functions.  The request in
+  * the TX queue is not closed: call otapi_close_request() to send it too, or
+  * discard it.  The status is 0 if the payload is larger than the image.
+  */
+ot_u16 otapi_compile_request(ot_u8* status, reqimg_tmpl* image);
+
+
+
+/** @brief  Writes new data into a patch point of a request image
+  * @param  image       (reqimg_tmpl*) compiled request image
+  * @param  index       (ot_u8) index of the patch point
+  * @param  value       (ot_u8*) new data, with the length of the patch point
+  * @retval ot_u16      0/1 on failure/success
+  * @ingroup OTAPI_c
+  */
+ot_u16 otapi_patch_request(reqimg_tmpl* image, ot_u8 index, const ot_u8* value);
+
+
+
+/** @brief  Builds a complete request in the top session from a request image
+  * @param  image       (reqimg_tmpl*) compiled request image
+  * @param  routing     (routing_tmpl*) routing template, as otapi_open_request()
+  * @retval ot_u16      0/1 on failure/success
+  * @ingroup OTAPI_c
+  *
+  * This replaces the otapi_open_request(), otapi_put_...(), and
+  * otapi_close_request() calls used to build the request originally.
+  */
+ot_u16 otapi_replay_request(reqimg_tmpl* image, routing_tmpl* routing);
+
+#endif
+
 #endif
 
 
@@ -51,6 +51,15 @@
 #include <otlib/crc16.h>
 
 
+/// Largest RS parity block that em2_rs_paritylength() can yield for a frame
+/// that fits in a single GF(256) codeword (255 bytes).
+#define M2_RS_NPARMAX   32
+
+/// Header bytes of a continuation frame in a multiframe packet: length, link
+/// control, TX EIRP, subnet, frame info and dialog ID.
+#define M2_MFP_HDRBYTES 6
+
+
 typedef struct {
     // Core Encoder State Variables
     ot_u8   lctl;
@@ -79,6 +88,35 @@ typedef struct {
         ot_u8   cost_matrix[2][8];
 #   endif
 
+    // Reed-Solomon codec state.  rs_reg is the parity LFSR while encoding
+    // and the syndrome accumulator while decoding (the radio is half-duplex).
+    // rs_gen holds the generator polynomial in log form (255 = zero term).
+#   if (M2_FEATURE(RSCODE) == ENABLED)
+        ot_u8*  rs_front;
+        ot_u8*  rs_cursor;
+        ot_int  rs_count;
+        ot_int  rs_length;
+        ot_int  rs_npar;
+        ot_u8   rs_reg[M2_RS_NPARMAX];
+        ot_u8   rs_gen[M2_RS_NPARMAX];
+#   endif
+
+    // Multiframe packet state.  mfp_cursor is the cut point of the current
+    // TX frame, or the RX reassembly point (NULL outside of an RX packet).
+    // The stash holds payload that a TX frame's CRC and parity cover.
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+        ot_u8*  mfp_front;
+        ot_u8*  mfp_end;
+        ot_u8*  mfp_cursor;
+        ot_u8*  mfp_hdrpos;
+        ot_int  mfp_frames;
+        ot_int  mfp_stashlen;
+        ot_u16  mfp_damage;
+        ot_u8   mfp_hdr[4];
+        ot_u8   mfp_save[M2_MFP_HDRBYTES];
+        ot_u8   mfp_stash[2 + M2_RS_NPARMAX];
+#   endif
+
 } em2_struct;
 
 extern em2_struct   em2;
@@ -221,14 +259,62 @@ ot_bool em2_complete();
 
 
 
+/** @brief  Prepares the RS decoder for a frame whose header is in the queue
+  * @param  q           (ot_queue*) queue whose front holds the frame
+  * @retval ot_int      number of RS parity bytes at the end of the frame
+  * @ingroup Encode
+  *
+  * The codeword covers the whole frame, including length byte and CRC16.
+  * Syndromes are accumulated as bytes are fed-in via em2_rs_decode().
+  */
 ot_int em2_rs_init_decode(ot_queue* q);
+
+/** @brief  Feeds the next n received bytes into the RS syndrome accumulator
+  * @param  n_bytes     (ot_int) number of bytes to feed
+  * @retval None
+  * @ingroup Encode
+  */
 void em2_rs_decode(ot_int n_bytes);
 
+/** @brief  Finishes syndrome accumulation and checks the received codeword
+  * @param  None
+  * @retval ot_int      0 if codeword is clean, >0 if errors, -1 if no RS
+  * @ingroup Encode
+  */
 ot_int em2_rs_check(void);
+
+/** @brief  Corrects the received frame in place, using the RS syndromes
+  * @param  None
+  * @retval ot_int      number of corrected bytes, or -1 if uncorrectable
+  * @ingroup Encode
+  */
 ot_int em2_rs_postprocess(void);
+
+/** @brief  Number of RS parity bytes used in a frame of given total length
+  * @param  msg_length  (ot_int) total frame bytes, including parity
+  * @retval ot_int      number of parity bytes
+  * @ingroup Encode
+  */
 ot_int em2_rs_paritylength(ot_int msg_length);
+
+/** @brief  Prepares the RS encoder for the frame in the queue
+  * @param  q           (ot_queue*) queue whose front holds the frame
+  * @retval ot_int      number of parity bytes to append (0 if frame too big)
+  * @ingroup Encode
+  *
+  * Call after the CRC16 length has been added to the frame length byte.  The
+  * caller must add the returned value to the length byte and the putcursor.
+  * Parity is written behind the CRC when the last message byte is encoded.
+  */
 ot_int em2_rs_init_encode(ot_queue* q);
+
+/** @brief  Feeds the next n outgoing bytes into the RS parity LFSR
+  * @param  n_bytes     (ot_int) number of bytes to feed
+  * @retval None
+  * @ingroup Encode
+  */
 void em2_rs_encode(ot_int n_bytes);
+
 void em2_rs_interleave(ot_u8* start, ot_int numbytes);
 
 
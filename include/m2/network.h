@@ -302,6 +302,67 @@ ot_bool m2np_idcmp(ot_int length, ot_u8* id);
 
 
 
+/** @brief  Searches a list of Device IDs for this Device's ID
+  * @param  length      (ot_int) use 2 or 8 to select VID or UID comparison
+  * @param  count       (ot_int) number of IDs in the list
+  * @param  list        (ot_u8*) pointer to the first ID in the list
+  * @retval ot_bool     True if this Device's ID is in the list
+  * @ingroup Network
+  * @sa m2np_idcmp()
+  *
+  * This is used for A2P ack lists.  Each list entry is prefiltered with a
+  * single 16 bit compare on the tail of the ID (which, for UIDs, is the part
+  * that varies between devices of a given vendor), and only the entries that
+  * pass go on to a full m2np_idcmp().
+  */
+ot_bool m2np_idlist_search(ot_int length, ot_int count, ot_u8* list);
+
+
+
+/** Bloom-filter Ack Lists
+  * A2P ack lists normally take the form [N][ID 0]...[ID N-1].  When the first
+  * byte is M2_ACKLIST_BLOOM, the list is instead a Bloom filter of the acked
+  * IDs, with the form [M2_ACKLIST_BLOOM][filter bytes][seed][filter].  Filter
+  * bytes must be a power of two, up to 32.  Each ID sets M2_ACKBLOOM_K bits.
+  *
+  * A false positive keeps a not-yet-acked device quiet for one request, so
+  * the requester should change the seed on each round of a collection.
+  */
+#define M2_ACKLIST_BLOOM        255
+#define M2_ACKBLOOM_K           3
+#define M2_ACKBLOOM_MAXBYTES    32
+
+#if (M2_FEATURE(ACKBLOOM))
+
+/** @brief  Tests if this Device's ID is in a Bloom-filter ack list
+  * @param  length      (ot_int) use 2 or 8 to select VID or UID test
+  * @param  filter_bytes (ot_int) size of the filter, in bytes
+  * @param  seed        (ot_u8) hash seed from the ack list
+  * @param  filter      (ot_u8*) pointer to the filter
+  * @retval ot_bool     True if this Device's ID is (probably) in the filter
+  * @ingroup Network
+  */
+ot_bool m2np_ackbloom_test(ot_int length, ot_int filter_bytes, ot_u8 seed, ot_u8* filter);
+
+
+/** @brief  Writes a Bloom-filter ack list onto the TX queue
+  * @param  length      (ot_int) ID length, 2 or 8
+  * @param  count       (ot_int) number of IDs in list
+  * @param  list        (ot_u8*) IDs to put into the filter
+  * @param  filter_bytes (ot_int) size of the filter, in bytes (power of two)
+  * @param  seed        (ot_u8) hash seed for this round
+  * @retval ot_int      Number of bytes written, or 0 on bad input/no space
+  * @ingroup Network
+  *
+  * This is the requester side of m2np_ackbloom_test().  It writes the full
+  * [M2_ACKLIST_BLOOM][filter bytes][seed][filter] ack list.
+  */
+ot_int m2np_put_ackbloom(ot_int length, ot_int count, ot_u8* list, ot_int filter_bytes, ot_u8 seed);
+
+#endif
+
+
+
 
 
 
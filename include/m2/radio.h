@@ -348,6 +348,9 @@ ot_bool rm2_mac_filter(void);
   * @retval None
   * @ingroup Radio
   * @sa rm2_test_chanlist
+  *
+  * This also invalidates the compiled channel table.  Builds without the
+  * VLACTIONS feature should call it after writing the channel-config file.
   */
 void rm2_channel_refresh(void);
 
@@ -399,7 +402,7 @@ ot_bool rm2_channel_fastcheck(ot_u8 chan_id);
 /** @brief  Searches Mode 2 Channel Configuration File and configures hardware
   *             to use a requested channel
   * @param  chan_id     (ot_u8) Mode 2 Channel ID to lookup and configure
-  * @param  fp          (vlFILE*) file pointer to compliant Mode 2 channel-config file
+  * @param  fp          (vlFILE*) file pointer to compliant Mode 2 channel-config file, or NULL
   * @retval ot_bool     True/False on channel found and configured
   * @ingroup Radio
   * @sa rm2_test_channel
@@ -408,6 +411,9 @@ ot_bool rm2_channel_fastcheck(ot_u8 chan_id);
   * Preferred usage is instead to call rm2_test_channel or rm2_chanscan, which
   * both call this function internally.
   *
+  * Lookup is done on a compiled channel table in RAM.  fp is only read when
+  * the table must be rebuilt, and when fp is NULL the channel-config file is
+  * opened internally for that purpose.
   */
 ot_bool rm2_channel_lookup(ot_u8 chan_id, vlFILE *fp);
 
@@ -1009,6 +1015,35 @@ void radio_getfourbytes(ot_u8* data);
 
 
 
+/** @brief Puts a block of bytes to the TX radio buffer
+  * @param data         (ot_u8*) bytes to put on TX
+  * @param limit        (ot_int) maximum number of bytes to put
+  * @retval ot_int      number of bytes put, which is limit or the free space
+  *                     in the TX buffer, whichever is less
+  * @ingroup Radio
+  *
+  * This is the block version of radio_putbyte(), for use by the encoder.  On
+  * radios with a FIFO on a bus, it fills the FIFO in as few bus transactions
+  * as possible, so a FIFO interrupt costs one transaction instead of one per
+  * byte.  The radio may borrow the two bytes ahead of data for a bus header,
+  * so data must not be the first byte of its buffer.  The borrowed bytes are
+  * restored before returning.
+  */
+ot_int radio_putburst(ot_u8* data, ot_int limit);
+
+/** @brief Gets a block of bytes from the RX radio buffer
+  * @param data         (ot_u8*) array to load into
+  * @param limit        (ot_int) maximum number of bytes to get
+  * @retval ot_int      number of bytes gotten, which is limit or the number
+  *                     of bytes in the RX buffer, whichever is less
+  * @ingroup Radio
+  *
+  * This is the block version of radio_getbyte(), for use by the decoder.
+  */
+ot_int radio_getburst(ot_u8* data, ot_int limit);
+
+
+
 /** @brief Checks the RX buffer to see if there is at least 1 more byte in it
   * @param none
   * @retval ot_bool     True if at least 1 more byte in buffer
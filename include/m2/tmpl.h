@@ -217,6 +217,8 @@ typedef enum {
     CMD_collect_series_on_file   = 7,
     CMD_collect_file_on_series   = 8,
     CMD_collect_series_on_series = 9,
+    CMD_aggregate_on_file        = 10,
+    CMD_aggregate_on_series      = 11,
     CMD_request_datastream       = 12,
     CMD_propose_datastream       = 13,
     CMD_ack_datastream           = 14,
@@ -279,6 +281,17 @@ typedef struct {
 } isfcall_tmpl;
 
 
+#define __SIZEOF_isfagg_tmpl (1+1+1+1+2+2)
+typedef struct {
+    ot_u8   reducers;
+    ot_u8   format;
+    ot_u8   last;
+    ot_u8   isf_id;
+    ot_s16  offset;
+    ot_s16  window;
+} isfagg_tmpl;
+
+
 #define __SIZEOF_isfcomp_tmpl (1+1+2)
 typedef struct {
     ot_u8   is_series;
@@ -84,7 +84,9 @@
 #define M2OP_COL_SF             0x07        //Collection: Series/File
 #define M2OP_COL_FS             0x08        //Collection: File/Series
 #define M2OP_COL_SS             0x09        //Collection: Series/Series
-// reserved: 0x0A through 0x0E
+#define M2OP_AGG_F              0x0A        //Aggregation: query on File
+#define M2OP_AGG_S              0x0B        //Aggregation: query on Series
+// reserved: 0x0C through 0x0E
 #define M2OP_RFU                0x0F        //Reserved
 
 
@@ -99,6 +101,18 @@
 #define M2CE_SCRAP              (1 << 6)
 #define M2CE_NOACK              (1 << 7)
 
+// M2QP Aggregate Call Template: reducers (the count is always returned)
+#define M2AG_MIN                (1 << 0)
+#define M2AG_MAX                (1 << 1)
+#define M2AG_SUM                (1 << 2)
+#define M2AG_LAST               (1 << 3)
+#define M2AG_SERIES             (1 << 7)    // aggregated dataset is a series
+
+// M2QP Aggregate Call Template: element format
+#define M2AG_FMT_SIZEMASK       (3 << 0)    // element is 1<<n bytes (1, 2, 4)
+#define M2AG_FMT_SIGNED         (1 << 2)
+#define M2AG_FMT_LE             (1 << 3)    // little endian elements
+
 // Mode 2 Query Comparisons
 #define M2QC_MASKED             (0x80)
 #define M2QC_VAL_EXISTS         (0x00)
@@ -111,6 +125,7 @@
 #define M2QC_ALU_GTE            (0x25)
 #define M2QC_COR_SEARCH         (0x40)
 #define M2QC_COR_THRMASK        (0x1F)
+#define M2QC_COR_MAXTOKEN       16          // Longest supported search token
 #define M2QC_ERROR              (0xFF)
 
 
@@ -414,11 +429,31 @@ ot_bool m2qp_sig_a2p(   ot_u8 code,     ot_u8 subcode,  id_tmpl* user_id    );
   * these types of comparisons, a threshold value is specified in the comparison
   * input data.  If the score is below threshold, it will be returned as 0.  If
   * it is equal or higher, the actual score will be returned.
+  *
+  * @note Query result cache
+  * When M2_FEATURE_QUERYCACHE is enabled, the last M2_PARAM_QUERYCACHE results
+  * are memoized.  A query with the same template, comparison file & offset,
+  * and user ID as a cached one returns the cached score without accessing the
+  * file system.  The cache is invalidated by any veelite file modification.
+  * Queries with tokens longer than M2QC_COR_MAXTOKEN are not cached.
   */
 ot_int m2qp_isf_comp(ot_u8 is_series, id_tmpl* user_id);
 
 
 
+/** @brief Flushes the M2QP query result cache
+  * @param None
+  * @retval None
+  * @ingroup M2QP
+  *
+  * File modifications flush the cache automatically.  Call this function when
+  * query results may change for other reasons, such as changes to the user
+  * authentication table.
+  */
+void m2qp_flush_querycache(void);
+
+
+
 
 /** @brief Breaks down ISF Call Template, and queues the ISF Return Template
   * @param is_series    (ot_u8) 0 is for ISF Call, non-zero for ISS Call
@@ -447,12 +482,56 @@ ot_int m2qp_isf_call(ot_u8 is_series, ot_queue* input_q, id_tmpl* user_id);
 
 
 
+/** @brief Breaks down ISF Aggregate Call Template, and queues the aggregate
+  * @param input_q      (ot_queue*) data queue containing aggregate call template
+  * @param user_id      (id_tmpl*) user identifier of this call
+  * @retval ot_int      Number of elements aggregated, or negative on error
+  * @ingroup Protocol_Special
+  *
+  * The aggregate call is the reply payload of the Aggregation commands.  It is
+  * like an ISF call, except the called dataset is reduced on the node, so the
+  * response carries a few bytes instead of the dataset.
+  *
+  * Aggregate Call Template:
+  * - [reducers:1]      M2AG_MIN | M2AG_MAX | M2AG_SUM | M2AG_LAST | M2AG_SERIES
+  * - [format:1]        element size and format, M2AG_FMT_...
+  * - [last:1]          number of elements to return for M2AG_LAST
+  * - [isf_id:1]        ISF File, or ISF Series if M2AG_SERIES
+  * - [offset:1 or 2]   byte offset of the window (2 bytes for a series)
+  * - [window:2]        byte length of the window, or 0 for the rest of the data
+  *
+  * Aggregate Return Template:
+  * - [reducers:1] [format:1] [isf_id:1] [count:2]
+  * - [min:4] [max:4] [sum:4]    each if selected, as 32 bit big endian
+  * - [n:1] [n elements]         if M2AG_LAST selected, oldest first, as stored
+  *
+  * The sum is modulo 2^32.  The number of elements returned for M2AG_LAST is
+  * limited to M2_PARAM_AGG_LASTN.  A partial element at the end of the window
+  * is ignored.
+  *
+  * Errors are negative, and they are sent as the NACK code the same way as
+  * for collections: -2 (0xFE) if the data is not accessible, and -1 (0xFF) if
+  * the template is invalid or the return template does not fit in the frame.
+  */
+ot_int m2qp_isf_aggregate(ot_queue* input_q, id_tmpl* user_id);
+
+
+
+
+/** @typedef m2qp_loadfn
+  * Span processing function for m2qp_load_isf().  It is given a cursor, which
+  * it must advance by the number of bytes it consumes, and a contiguous span
+  * of ISF data.  It returns a score for the span.
+  */
+typedef ot_int (*m2qp_loadfn)(ot_int*, const ot_u8*, ot_int);
+
+
 /** @brief Toolkit function for accessing ISF data, processing it, and returning a value
   * @param  is_series     (ot_u8)   0 is for ISF File, non-zero for ISF List
   * @param  isf_id        (ot_int)  ID for the ISF File or List
   * @param  offset        (ot_int)  Byte offset into the ISF dataset
   * @param  window_bytes  (ot_int)  Number of bytes, following offset, to process
-  * @param  load_function (ot_int (*)(ot_int*, ot_u8) ) Processing function
+  * @param  load_function (m2qp_loadfn) Processing function
   * @retval ot_int        A running sum of returns from the processing function
   * @ingroup Protocol_Special
   * @sa pm2_isf_comp()
@@ -466,16 +545,18 @@ ot_int m2qp_isf_call(ot_u8 is_series, ot_queue* input_q, id_tmpl* user_id);
   * It is one of the cooler and more useful functions in OpenTag.
   *
   * The processing function is a subroutine that takes in an index pointer (this
-  * is issued by pm2_load_isf() ) and a byte of data.  It can do whatever it
-  * wants to the data, and return whatever it wants.  There are currently three
-  * subroutines used as processing functions for different tasks:
-  * sub_load_charcorrelation(), sub_load_comparison(), sub_load_return()
+  * is issued by pm2_load_isf() ) and a span of data.  It can do whatever it
+  * wants to the data, and return whatever it wants.  Spans are as long as the
+  * underlying file data allows, so the dataset is processed in a single pass.
+  * There are currently three subroutines used as processing functions for
+  * different tasks: sub_load_charcorrelation(), sub_load_comparison(), 
+  * sub_load_return()
   */
 ot_int m2qp_load_isf(   ot_u8       is_series,
                         ot_u8       isf_id,
                         ot_int      offset,
                         ot_int      window_bytes,
-                        ot_int      (*load_function)(ot_int*, ot_u8),
+                        m2qp_loadfn load_function,
                         id_tmpl*    user_id );
 
 
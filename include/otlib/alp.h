@@ -169,21 +169,66 @@ void alp_init(alp_tmpl* alp, ot_queue* inq, ot_queue* outq);
 
 
 
+/** @brief  Registers a handler for an ALP ID in the ALP dispatch table
+ * @param  alp_id      (ot_u8) ALP ID to register
+ * @param  callback    (alp_fn) Processor called when a message for this ID ends
+ * @param  appq        (ot_queue*) Optional application queue.  May be NULL.
+ * @param  runtime     (ot_u8) Estimated processing time, in kernel ticks.  
+ *                     Use 0 for the default estimate.
+ * @retval ot_int      0 on success, negative if there are no free handler slots
+ * @ingroup ALP
+ * @sa alp_unregister
+ * @sa alp_get_runtime
+ *
+ * Any ALP ID may be registered, including built-in IDs, which overrides the
+ * built-in processor.  The number of handlers that may be registered at the 
+ * same time is set by OT_PARAM(ALP_HANDLERS), in the app config.
+ *
+ * If appq is not NULL, record payloads for this ID are copied into it as they
+ * arrive, and it is emptied on Message-Begin.
+ */
+ot_int alp_register(ot_u8 alp_id, alp_fn callback, ot_queue* appq, ot_u8 runtime);
+
+
+/** @brief  Removes a handler from the ALP dispatch table
+ * @param  alp_id      (ot_u8) ALP ID to unregister
+ * @retval None
+ * @ingroup ALP
+ * @sa alp_register
+ *
+ * The ALP ID goes back to the default processor (ALP extension if enabled, 
+ * else the null processor).
+ */
+void alp_unregister(ot_u8 alp_id);
+
+
+/** @brief  Returns the runtime estimate for an ALP ID
+ * @param  alp_id      (ot_u8) ALP ID
+ * @retval ot_u8       Runtime estimate, in kernel ticks
+ * @ingroup ALP
+ * @sa alp_register
+ *
+ * I/O tasks use this to set the reserve of the task that will process an ALP
+ * message they have received.
+ */
+ot_u8 alp_get_runtime(ot_u8 alp_id);
+
+
 ///@todo experimental
 /** @brief  Setup a new Application queue from the main alp input queue
  * @param  alp         (alp_tmpl*) ALP I/O control structure
+ * @param  alp_id      (ot_u8) ALP ID used by the Application
+ * @param  callback    (alp_fn) Processor for the Application
  * @param  appq        (ot_queue*) subordinate queue used by Application
  * @retval None
  * @ingroup ALP
- * @sa alp_append_appq
- * @sa alp_goto_next
+ * @sa alp_register
  *
  * Non-atomic applications that run from a shared ALP usually need to maintain
- * an independent application queue.  The functions alp_goto_next() and
- * alp_retrieve_cmd() will will draw records from said queue, but before you
- * can use these, you must setup an Application queue in the first place.
+ * an independent application queue.  This is a wrapper of alp_register(), 
+ * using the default runtime estimate.
  */
-void alp_add_app(alp_tmpl* alp, ot_u8 alp_id, alp_fn callback, ot_queue appq);
+void alp_add_app(alp_tmpl* alp, ot_u8 alp_id, alp_fn callback, ot_queue* appq);
 
 
 ///@todo experimental
@@ -330,9 +375,6 @@ ot_bool alp_proc_sensor(alp_tmpl* alp, const id_tmpl* user_id);
 
 
 #if (OT_FEATURE(DASHFORTH) == ENABLED)
-#   if (OT_FEATURE(CAPI) != ENABLED)
-#       error For DASHForth to work, C-API must be ENABLED (it is not: check OT_config.h).
-#   endif
 /** @brief  Process a received DASHFORTH ALP record
   * @param  alp         (alp_tmpl*) ALP I/O control structure
   * @param  user_id     (id_tmpl*) user id for performing the record
@@ -67,6 +67,22 @@ typedef enum {
 } keytype_t;
 
 
+/** @typedef authseg_t
+  * A segment of data for scatter-gather cryptography.  The segment is a base
+  * address plus an octet offset, so a segment can start at any alignment, and
+  * it may point directly into a queue or frame buffer (e.g. base = q->front).
+  *
+  * void* base      Base address of the buffer containing the segment
+  * ot_uint offset  Offset, in octets, from base to the start of the segment
+  * ot_uint length  Length of segment in octets
+  */
+typedef struct {
+    void*   base;
+    ot_uint offset;
+    ot_uint length;
+} authseg_t;
+
+
 
 
 /** High Level Cryptographic Interface Functions <BR>
@@ -212,6 +228,49 @@ ot_int auth_decrypt_q(ot_queue* q, ot_uint key_index);
 
 
 
+/** @brief Encrypts scatter-gather segments, in-place
+  * @param nonce        (authseg_t*) 7 byte nonce (length is ignored)
+  * @param header       (authseg_t*) Authenticated, unencrypted header.  May be NULL.
+  * @param payload      (authseg_t*) Array of payload segments to encrypt in-place
+  * @param segments     (ot_uint) Number of segments in the payload array
+  * @param tag          (authseg_t*) Destination of 4 byte tag (length is ignored)
+  * @param key_index    (ot_uint) Key Index to use for encryption
+  * @retval ot_int      number of tag bytes written (4), or negative on error.
+  * @ingroup auth
+  * @sa auth_decrypt_sg
+  * @sa auth_encrypt
+  *
+  * The payload is processed in the order of the array, as if it were one 
+  * contiguous stream.  A single payload segment that is followed directly by
+  * the tag segment is encrypted in place, with no copying, which is the case
+  * for a frame buffer.  Otherwise, the segments are gathered into an internal
+  * buffer (up to 256 bytes) and scattered back.  The EAX driver has no input
+  * for associated data, so header must be NULL or have length 0.
+  */
+ot_int auth_encrypt_sg(authseg_t* nonce, authseg_t* header, authseg_t* payload, 
+                        ot_uint segments, authseg_t* tag, ot_uint key_index);
+
+
+/** @brief Decrypts scatter-gather segments, in-place
+  * @param nonce        (authseg_t*) 7 byte nonce (length is ignored)
+  * @param header       (authseg_t*) Authenticated, unencrypted header.  May be NULL.
+  * @param payload      (authseg_t*) Array of payload segments to decrypt in-place
+  * @param segments     (ot_uint) Number of segments in the payload array
+  * @param tag          (authseg_t*) 4 byte tag to validate (length is ignored)
+  * @param key_index    (ot_uint) Key Index to use for decryption
+  * @retval ot_int      number of tag bytes validated (4), or negative on error.
+  * @ingroup auth
+  * @sa auth_encrypt_sg
+  * @sa auth_decrypt
+  *
+  * Segments are handled as in auth_encrypt_sg().  Returns -2 if the tag does
+  * not validate, in which case the payload should be discarded.
+  */
+ot_int auth_decrypt_sg(authseg_t* nonce, authseg_t* header, authseg_t* payload, 
+                        ot_uint segments, authseg_t* tag, ot_uint key_index);
+
+
+
 /** @brief Returns Decryption-Key DATA of a given key index, but no Auth/Sec metadata
   * @param key      (void**) Is loaded with pointer to expanded key.  Always word-aligned.
   * @param index    (ot_uint) Key Index input
@@ -0,0 +1,327 @@
+/* Copyright 2016 JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+/**
+  * @file       /include/otlib/dashforth.h
+  * @author     JP Norair
+  * @version    R100
+  * @date       20 Oct 2016
+  * @brief      DASHForth applet VM
+  * @defgroup   DASHForth
+  * @ingroup    otlib
+  *
+  * DASHForth applets are small, Forth-like bytecode programs.  They are meant
+  * for filtering and aggregating data on the node: e.g. reducing a log file to
+  * min/max/mean before it is sent, or deciding if a sensor value is worth
+  * reporting at all.
+  *
+  * The VM is a stack machine with 32 bit cells, a data stack, a return stack
+  * (which also serves >R and FOR/NEXT loops), a small variable array, and
+  * byte buffers for the applet input and output.  All of it is statically
+  * sized by OT_PARAM_DASHFORTH_* settings.
+  *
+  * Applets are verified when they are loaded: every opcode must be valid,
+  * every instruction must fit in the code, and every branch must land on an
+  * instruction.  At runtime, the stacks, buffers and variables are bounds
+  * checked, and every applet has a fuel limit of OT_PARAM_DASHFORTH_MAXOPS
+  * instructions.  So an applet can fail, but it cannot corrupt memory or run
+  * forever.
+  *
+  * df_run() executes a given number of instructions and then returns, with
+  * all state in the df_vm.  The DASHForth kernel task (TASK_dashforth) uses
+  * this to run applets in slices sized by the task's reserve, so the kernel
+  * may schedule higher priority tasks between slices.
+  *
+  * Applets stored in files begin with the byte DF_MAGIC, which is how
+  * vl_execute() tells them apart from ordinary executable files.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __OTLIB_DASHFORTH_H
+#define __OTLIB_DASHFORTH_H
+
+#include <otstd.h>
+
+#if (OT_FEATURE(DASHFORTH) == ENABLED)
+
+#include <otsys/types.h>
+#include <otsys/syskern.h>
+#include <otsys/veelite.h>
+#include <m2/tmpl.h>
+
+
+typedef ot_s32  df_cell;
+
+
+/// First byte of an applet stored in a file
+#define DF_MAGIC            0xDF
+
+
+/** @typedef DF_Opcode
+  * DASHForth instruction set.  Stack effects are shown in Forth notation.
+  * Immediate operands follow the opcode, multi-byte ones in big endian.  Jump
+  * targets are absolute code offsets.  Flags are -1 for true and 0 for false.
+  */
+typedef enum {
+    DF_HALT     = 0x00,     ///< ( -- )             end applet
+    DF_LIT8     = 0x01,     ///< ( -- n )           [s8]
+    DF_LIT16    = 0x02,     ///< ( -- n )           [s16]
+    DF_LIT32    = 0x03,     ///< ( -- n )           [s32]
+    DF_YIELD    = 0x04,     ///< ( -- )             end the slice here
+    DF_DUP      = 0x08,     ///< ( a -- a a )
+    DF_DROP     = 0x09,     ///< ( a -- )
+    DF_SWAP     = 0x0A,     ///< ( a b -- b a )
+    DF_OVER     = 0x0B,     ///< ( a b -- a b a )
+    DF_ROT      = 0x0C,     ///< ( a b c -- b c a )
+    DF_TOR      = 0x0D,     ///< ( a -- ) (R: -- a)
+    DF_FROMR    = 0x0E,     ///< ( -- a ) (R: a -- )
+    DF_RFETCH   = 0x0F,     ///< ( -- a ) (R: a -- a)
+    DF_ADD      = 0x10,     ///< ( a b -- a+b )
+    DF_SUB      = 0x11,     ///< ( a b -- a-b )
+    DF_MUL      = 0x12,     ///< ( a b -- a*b )
+    DF_DIV      = 0x13,     ///< ( a b -- a/b )     b=0 is an error
+    DF_MOD      = 0x14,     ///< ( a b -- a%b )     b=0 is an error
+    DF_NEG      = 0x15,     ///< ( a -- -a )
+    DF_ABS      = 0x16,     ///< ( a -- |a| )
+    DF_MIN      = 0x17,     ///< ( a b -- min )
+    DF_MAX      = 0x18,     ///< ( a b -- max )
+    DF_AND      = 0x19,     ///< ( a b -- a&b )
+    DF_OR       = 0x1A,     ///< ( a b -- a|b )
+    DF_XOR      = 0x1B,     ///< ( a b -- a^b )
+    DF_INV      = 0x1C,     ///< ( a -- ~a )
+    DF_SHL      = 0x1D,     ///< ( a n -- a<<n )
+    DF_SHR      = 0x1E,     ///< ( a n -- a>>n )    arithmetic shift
+    DF_EQ       = 0x20,     ///< ( a b -- a=b )
+    DF_LT       = 0x21,     ///< ( a b -- a<b )
+    DF_GT       = 0x22,     ///< ( a b -- a>b )
+    DF_ZEQ      = 0x23,     ///< ( a -- a=0 )
+    DF_JMP      = 0x28,     ///< ( -- )             [addr:2]
+    DF_JZ       = 0x29,     ///< ( f -- )           [addr:2] jump if f=0
+    DF_CALL     = 0x2A,     ///< ( -- ) (R: -- ret) [addr:2]
+    DF_RET      = 0x2B,     ///< ( -- ) (R: ret -- )
+    DF_NEXT     = 0x2C,     ///< (R: n -- n-1 | )   [addr:2] jump while n-1 != 0
+    DF_VFETCH   = 0x30,     ///< ( -- x )           [var]
+    DF_VSTORE   = 0x31,     ///< ( x -- )           [var]
+    DF_INLEN    = 0x38,     ///< ( -- n )           input length
+    DF_INFETCH  = 0x39,     ///< ( i -- b )         input byte i
+    DF_OUT8     = 0x3A,     ///< ( x -- )           append 1 byte to output
+    DF_OUT16    = 0x3B,     ///< ( x -- )           append 2 bytes to output
+    DF_OUT32    = 0x3C,     ///< ( x -- )           append 4 bytes to output
+    DF_FLEN     = 0x40,     ///< ( isf -- n )       length of ISF file
+    DF_FREAD8   = 0x41,     ///< ( isf i -- b )     byte i of ISF file
+    DF_FREAD16  = 0x42,     ///< ( isf i -- n )     bytes i, i+1 of ISF file
+    DF_OPCODES
+} DF_Opcode;
+
+
+/** @typedef DF_Status
+  * Return values of df_run() and the DASHForth system functions.  Errors are
+  * negative.
+  */
+typedef enum {
+    DF_DONE         = 0,    ///< Applet ran to HALT (or off the end)
+    DF_YIELD_SLICE  = 1,    ///< Slice budget used up, or YIELD: call again
+    DF_ERR_VERIFY   = -1,   ///< Applet failed verification
+    DF_ERR_STACK    = -2,   ///< Data stack under/overflow
+    DF_ERR_RSTACK   = -3,   ///< Return stack under/overflow
+    DF_ERR_MATH     = -4,   ///< Division by zero
+    DF_ERR_BOUNDS   = -5,   ///< Input, output, or file index out of range
+    DF_ERR_ACCESS   = -6,   ///< File does not exist or is not accessible
+    DF_ERR_FUEL     = -7,   ///< Ran more than OT_PARAM_DASHFORTH_MAXOPS ops
+    DF_ERR_BUSY     = -8,   ///< An applet is already running
+    DF_ERR_KILLED   = -9    ///< Applet was stopped by dashforth_kill()
+} DF_Status;
+
+
+/** @typedef df_vm
+  * VM state.  sp and rp are the number of cells on each stack.  status is
+  * the result of the last df_run().  user_id is AUTH_ROOT, AUTH_USER or
+  * AUTH_GUEST, by the class of the user that started the applet, so that it
+  * stays valid while the applet runs on the task.  owner is a copy of the ID
+  * of that user, for checking who may read the results.  opmap has a bit set
+  * for each address where an instruction starts, and for the end of the code.
+  */
+#define DF_OWNERSIZE    8
+
+typedef struct {
+    const id_tmpl*  user_id;
+    ot_u8           owner_len;
+    ot_u8           owner[DF_OWNERSIZE];
+    ot_u32          fuel;
+    ot_u16          pc;
+    ot_u16          codelen;
+    ot_int          status;
+    ot_u8           sp;
+    ot_u8           rp;
+    ot_u8           inlen;
+    ot_u8           outlen;
+    df_cell         ds[OT_PARAM(DASHFORTH_DSTACK)];
+    df_cell         rs[OT_PARAM(DASHFORTH_RSTACK)];
+    df_cell         var[OT_PARAM(DASHFORTH_VARS)];
+    ot_u8           in[OT_PARAM(DASHFORTH_INSIZE)];
+    ot_u8           out[OT_PARAM(DASHFORTH_OUTSIZE)];
+    ot_u8           code[OT_PARAM(DASHFORTH_CODESIZE)+1];
+    ot_u8           opmap[(OT_PARAM(DASHFORTH_CODESIZE)/8)+1];
+} df_vm;
+
+
+
+
+/** VM functions <BR>
+  * ========================================================================<BR>
+  */
+
+/** @brief  Verifies applet bytecode
+  * @param  code        (const ot_u8*) bytecode
+  * @param  length      (ot_int) bytecode length
+  * @param  opmap       (ot_u8*) output bitmap of instruction starts, at least
+  *                     (length/8)+1 bytes
+  * @retval ot_int      DF_DONE if the code is valid, else DF_ERR_VERIFY
+  * @ingroup DASHForth
+  *
+  * Checks that all opcodes are valid, all immediates are in the code, all
+  * jump targets are the start of an instruction, and all variable indices
+  * are in range.  It does not run the code.  The opmap it builds is used by
+  * the VM to check return addresses in constant time.
+  */
+ot_int df_verify(const ot_u8* code, ot_int length, ot_u8* opmap);
+
+
+/** @brief  Verifies and loads applet bytecode into a VM
+  * @param  vm          (df_vm*) VM
+  * @param  code        (const ot_u8*) bytecode
+  * @param  length      (ot_int) bytecode length, up to OT_PARAM_DASHFORTH_CODESIZE
+  * @retval ot_int      DF_DONE on success, else DF_ERR_VERIFY
+  * @ingroup DASHForth
+  */
+ot_int df_load(df_vm* vm, const ot_u8* code, ot_int length);
+
+
+/** @brief  Loads an applet stored in a file into a VM
+  * @param  vm          (df_vm*) VM
+  * @param  fp          (vlFILE*) open file, starting with DF_MAGIC
+  * @retval ot_int      DF_DONE on success, else DF_ERR_VERIFY
+  * @ingroup DASHForth
+  *
+  * The caller is responsible for opening the file with VL_ACCESS_X, which is
+  * the permission check for running it.
+  */
+ot_int df_loadfile(df_vm* vm, vlFILE* fp);
+
+
+/** @brief  Readies a loaded applet to run from the start
+  * @param  vm          (df_vm*) VM
+  * @param  input       (const ot_u8*) input bytes, or NULL
+  * @param  inlen       (ot_int) number of input bytes
+  * @param  user_id     (const id_tmpl*) user running the applet, for file access
+  * @retval ot_int      DF_DONE on success, DF_ERR_BOUNDS if the input is too long
+  * @ingroup DASHForth
+  *
+  * Stacks, variables and output are cleared, and the fuel is refilled.  The
+  * applet reads files with the access of user_id's class (root, user, guest).
+  */
+ot_int df_start(df_vm* vm, const ot_u8* input, ot_int inlen, const id_tmpl* user_id);
+
+
+/** @brief  Checks if a user is the one that started the applet
+  * @param  vm          (const df_vm*) VM
+  * @param  user_id     (const id_tmpl*) user to check
+  * @retval ot_bool     True if user_id has the same ID as the applet owner
+  * @ingroup DASHForth
+  */
+ot_bool df_isowner(const df_vm* vm, const id_tmpl* user_id);
+
+
+/** @brief  Runs an applet for a number of instructions
+  * @param  vm          (df_vm*) VM
+  * @param  budget      (ot_uint) maximum instructions to run in this call
+  * @retval ot_int      DF_DONE, DF_YIELD_SLICE, or a negative DF_Status
+  * @ingroup DASHForth
+  *
+  * After DF_YIELD_SLICE, call df_run() again to continue.  After DF_DONE, the
+  * results are on the data stack and in the output buffer.
+  */
+ot_int df_run(df_vm* vm, ot_uint budget);
+
+
+
+
+/** DASHForth system functions <BR>
+  * ========================================================================<BR>
+  * The system has one VM, and runs it on TASK_dashforth.  An applet started by
+  * dashforth_exec() first runs synchronously for up to "ticks" worth of
+  * instructions.  If it is not done by then, the rest runs on the task.
+  */
+
+/** @brief  Initializes DASHForth.  Called by the kernel in sys_init().
+  * @param  None
+  * @retval None
+  * @ingroup DASHForth
+  */
+void dashforth_init(void);
+
+
+/** @brief  Stops any running applet
+  * @param  None
+  * @retval None
+  * @ingroup DASHForth
+  */
+void dashforth_kill(void);
+
+
+/** @brief  Starts an applet on the system VM
+  * @param  code        (const ot_u8*) bytecode, or NULL to load from fp
+  * @param  length      (ot_int) bytecode length (ignored if code is NULL)
+  * @param  fp          (vlFILE*) open file with the applet (if code is NULL)
+  * @param  input       (const ot_u8*) input bytes, or NULL
+  * @param  inlen       (ot_int) number of input bytes
+  * @param  user_id     (const id_tmpl*) user running the applet
+  * @param  ticks       (ot_uint) ticks of instructions to run synchronously
+  * @param  donefn      (ot_sig) called with the final status if the applet
+  *                     finishes on the task, or NULL
+  * @retval ot_int      DF_DONE if finished synchronously, DF_YIELD_SLICE if
+  *                     continued on the task, or a negative DF_Status
+  * @ingroup DASHForth
+  */
+ot_int dashforth_exec(const ot_u8* code, ot_int length, vlFILE* fp,
+                      const ot_u8* input, ot_int inlen, const id_tmpl* user_id,
+                      ot_uint ticks, ot_sig donefn);
+
+
+/** @brief  Returns the system VM, for reading results
+  * @param  None
+  * @retval df_vm*      The system VM.  vm->status is DF_YIELD_SLICE while an
+  *                     applet is running.
+  * @ingroup DASHForth
+  */
+df_vm* dashforth_vm(void);
+
+
+/** @brief  DASHForth kernel task
+  * @param  task        (ot_task) Task marker of TASK_dashforth
+  * @retval None
+  * @ingroup DASHForth
+  *
+  * Each run of the task is one slice of task->reserve ticks of instructions.
+  * Between slices, the task stays pending with nextevent=0, so the scheduler
+  * may run higher priority tasks, and it may hold this one off if a slice
+  * would not fit before another task is due.
+  */
+void dashforth_systask(ot_task task);
+
+
+#endif
+#endif
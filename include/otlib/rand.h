@@ -98,4 +98,66 @@ ot_u32 rand_prn32();
 void rand_prnseed(ot_u32);
 
 
+
+
+
+/** Context-based PRNG <BR>
+  * ========================================================================<BR>
+  * Optional, reentrant PRNG with per-context state.  This is implemented by 
+  * platforms that run many OpenTag instances in one process (i.e. POSIX C 
+  * network simulation), where each node needs its own reproducible sequence.
+  * The legacy functions above (rand_prn8/16/32, rand_stream, rand_prnseed) 
+  * operate on the context selected with rand_setctx().
+  */
+
+/** @typedef randctx_t
+  * State for the xoshiro128** generator.  It must not be all zero, which is 
+  * guaranteed if it is initialized with rand_ctxseed().
+  */
+typedef struct {
+    ot_u32 s[4];
+} randctx_t;
+
+
+/** @brief Seeds a PRNG context
+  * @param ctx          (randctx_t*) PRNG context to seed
+  * @param seed         (ot_u32) Seed value.  The same seed gives the same sequence.
+  * @retval none
+  * @ingroup Rand
+  */
+void rand_ctxseed(randctx_t* ctx, ot_u32 seed);
+
+
+/** @brief Returns a 32 bit pseudo-random value from a PRNG context
+  * @param ctx          (randctx_t*) PRNG context
+  * @retval ot_u32      32 bit pseudo random number
+  * @ingroup Rand
+  */
+ot_u32 rand_ctxprn32(randctx_t* ctx);
+
+
+/** @brief Bulk output of pseudo-random bytes from a PRNG context
+  * @param ctx          (randctx_t*) PRNG context
+  * @param rand_out     (ot_u8*) Pointer to the output random data
+  * @param bytes_out    (ot_int) Number of random bytes to output
+  * @retval none
+  * @ingroup Rand
+  *
+  * Generates four bytes per PRNG step.
+  */
+void rand_ctxstream(randctx_t* ctx, ot_u8* rand_out, ot_int bytes_out);
+
+
+/** @brief Selects the PRNG context used by the calling thread
+  * @param ctx          (randctx_t*) PRNG context, or NULL for the default context
+  * @retval randctx_t*  The context that was previously selected
+  * @ingroup Rand
+  *
+  * The selection is per-thread, so each simulated node (thread) can call this
+  * once at startup with its own context.  The default context is also kept
+  * per-thread, so it is never shared between threads.
+  */
+randctx_t* rand_setctx(randctx_t* ctx);
+
+
 #endif
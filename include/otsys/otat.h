@@ -0,0 +1,165 @@
+/* Copyright 2016 JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+/**
+  * @file       /otsys/otat.h
+  * @author     JP Norair
+  * @version    R102
+  * @date       20 Oct 2016
+  * @brief      OTAt timed-action service
+  * @defgroup   OTAt
+  * @ingroup    System
+  *
+  * OTAt is similar to UNIX "at" and "cron": an application registers actions
+  * by ID, and then schedules them to run once, or periodically, after some
+  * number of ticks.  All actions run from one kernel task (TASK_otat), so the
+  * application does not need to dedicate a task (and its nextevent) to each
+  * piece of periodic work.
+  *
+  * Scheduled actions are kept in a sysqueue as a delta-encoded list: each node
+  * stores the ticks from the node ahead of it.  Clocking the list is only an
+  * update of the top node, and the kernel sees only one pending event.  When
+  * the top action runs, any other actions due within OT_PARAM_OTAT_WINDOW
+  * ticks run in the same wakeup, so periodic sensor reads and reports with
+  * close schedules get batched together.
+  *
+  * OTAt may also be controlled over ALP (ID OT_PARAM_OTAT_ALPID), which lets a
+  * remote host list, schedule, and cancel the registered actions.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SYS_OTAT_H
+#define __SYS_OTAT_H
+
+#include <otstd.h>
+
+#if (OT_FEATURE(OTAT) == ENABLED)
+
+#include <otsys/syskern.h>
+#include <otlib/alp.h>
+
+
+/** @typedef ot_atstub
+  * Action called by OTAt.  The parameter is the ID of the action.
+  */
+typedef void (*ot_atstub)(ot_u8);
+
+
+/// ALP commands for OTAt (bit 7 of the command requests a response)
+/// <LI> LIST:     no payload.  Response: [ID][state][remaining:4][period:4] for
+///                each registered action.  state is 1 if scheduled. </LI>
+/// <LI> SCHEDULE: [ID][wait:4][period:4] for each action.  Response: [ID][err] </LI>
+/// <LI> CANCEL:   [ID] for each action.  Response: [ID][err] </LI>
+/// Times are in ticks, big endian.  err is 0 on success.
+#define OTAT_CMD_LIST       0
+#define OTAT_CMD_SCHEDULE   1
+#define OTAT_CMD_CANCEL     2
+
+
+
+/** @brief  Initializes OTAt, clearing all actions
+  * @param  None
+  * @retval None
+  * @ingroup OTAt
+  *
+  * Called by the kernel in sys_init().  It also registers the OTAt ALP
+  * processor, if ALP is enabled.
+  */
+void otat_init(void);
+
+
+/** @brief  Cancels all scheduled actions.  Registrations are kept.
+  * @param  None
+  * @retval None
+  * @ingroup OTAt
+  */
+void otat_kill(void);
+
+
+/** @brief  Registers an action under an ID
+  * @param  id          (ot_u8) Action ID, chosen by the application
+  * @param  action      (ot_atstub) Action callback
+  * @retval ot_int      0 on success, negative if there are no free slots
+  * @ingroup OTAt
+  *
+  * Registering an ID again replaces its action.  The number of actions is set
+  * by OT_PARAM_OTAT_SIZE.
+  */
+ot_int otat_register(ot_u8 id, ot_atstub action);
+
+
+/** @brief  Cancels and removes an action
+  * @param  id          (ot_u8) Action ID
+  * @retval None
+  * @ingroup OTAt
+  */
+void otat_unregister(ot_u8 id);
+
+
+/** @brief  Schedules a registered action
+  * @param  id          (ot_u8) Action ID
+  * @param  wait        (ot_u32) Ticks until the action runs
+  * @param  period      (ot_u32) Ticks between runs, or 0 to run once
+  * @retval ot_int      0 on success, negative if the ID is not registered
+  * @ingroup OTAt
+  *
+  * If the action is already scheduled, it is rescheduled.  Periodic actions
+  * are rescheduled from the time they were due, not from the time they ran,
+  * so they do not drift.  May be called from within an action.
+  */
+ot_int otat_schedule(ot_u8 id, ot_u32 wait, ot_u32 period);
+
+
+/** @brief  Cancels a scheduled action
+  * @param  id          (ot_u8) Action ID
+  * @retval ot_int      0 on success, negative if the action was not scheduled
+  * @ingroup OTAt
+  */
+ot_int otat_cancel(ot_u8 id);
+
+
+/** @brief  Returns the ticks until an action runs
+  * @param  id          (ot_u8) Action ID
+  * @retval ot_long     Ticks until the action runs, or negative if it is not
+  *                     scheduled
+  * @ingroup OTAt
+  */
+ot_long otat_remaining(ot_u8 id);
+
+
+/** @brief  OTAt kernel task
+  * @param  task        (ot_task) Task marker of TASK_otat
+  * @retval None
+  * @ingroup OTAt
+  */
+void otat_systask(ot_task task);
+
+
+#if (OT_FEATURE(ALP) == ENABLED)
+/** @brief  ALP processor for OTAt
+  * @param  alp         (alp_tmpl*) ALP I/O template
+  * @param  user_id     (id_tmpl*) user id of the requester
+  * @retval ot_bool     True if there is output
+  * @ingroup OTAt
+  *
+  * Listing requires user access, scheduling and cancelling require root.
+  */
+ot_bool alp_proc_otat(alp_tmpl* alp, const id_tmpl* user_id);
+#endif
+
+
+#endif
+#endif
@@ -122,9 +122,12 @@ typedef enum {
 #if (1)
     TASK_sleep,
 #endif
-//#if(OT_FEATURE(CRON))
-//    TASK_otcron,
-//#endif
+#if (OT_FEATURE(OTAT))
+    TASK_otat,
+#endif
+#if (OT_FEATURE(DASHFORTH))
+    TASK_dashforth,
+#endif
 ///@todo: rearrange user tasks with external, or simply remove external.
 #if (OT_PARAM(KERNELTASKS) > 0)
     OT_PARAM_KERNELTASK_IDS,
@@ -188,11 +188,23 @@ ot_sqnode* sq_extend_fromargs(ot_sq* sq, ot_sqcond condfn, void* handle, ot_u16
 
 
 
+/** sq_insert() and sq_remove() <BR>
+  * ======================================================================= <BR>
+  * Positional insert and remove, where index 0 is the top of the queue.  These
+  * are for queue managers that keep their own ordering, such as delta-encoded
+  * timer lists, where a binary search on the node data is not possible.
+  * sq_insert() returns NULL if the queue is full or the index is past the end.
+  */
+ot_sqnode* sq_insert(ot_sq* sq, ot_uint index, ot_sqnode* node);
+void sq_remove(ot_sq* sq, ot_uint index);
+
+
 /** sq data API functions <BR>
   * ======================================================================= <BR>
   */
 
 ot_sqnode* sq_pop(ot_sq* sq);
+void sq_clear(ot_sq* sq);
 
 void sq_flush(ot_sq* sq, ot_sqcond condfn);
 
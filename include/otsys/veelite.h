@@ -72,10 +72,33 @@ typedef struct {
     ot_u16      flags;
     vlread_fn   read;
     vlwrite_fn  write;
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    ot_u16      mod_lo;     // first byte written while open
+    ot_u16      mod_hi;     // byte after the last byte written while open
+#   endif
 } vlFILE;
 
 
 
+/** @typedef vl_event_t
+  * File change event, passed to file watcher callbacks (see vl_watch()).
+  *
+  * ot_u8   block_id:   vlBLOCK of the file that changed
+  * ot_u8   data_id:    ID of the file that changed
+  * ot_u16  flags:      VL_FLAG_... change flags
+  * ot_u16  offset:     first byte of file data that changed
+  * ot_u16  span:       number of bytes of file data that changed
+  */
+typedef struct {
+    ot_u8   block_id;
+    ot_u8   data_id;
+    ot_u16  flags;
+    ot_u16  offset;
+    ot_u16  span;
+} vl_event_t;
+
+
+
 /** @typedef vl_header_t
   * The generic form of the header used for OpenTag data files, used for
   * ISF, and GFB.  The mirror field should be set to NULL_vaddr if
@@ -147,10 +170,21 @@ typedef struct {
 #define VL_ACCESS_RW        (VL_ACCESS_R | VL_ACCESS_W)
 #define VL_ACCESS_CRYPTO    (ot_u8)b01000000
 
+/// Ring file marker: the X flag with no execute permission bits.  Ring files
+/// are never executable, see vl_ring_format().
+#define VL_MOD_RING         (ot_u8)b10000000
+#define VL_MOD_ISRING(MOD)  (((MOD) & VL_ACCESS_X) == VL_MOD_RING)
+
 /// File Action flags
 #define VL_FLAG_OPENED      (1<<0)
 #define VL_FLAG_MODDED      (1<<1)
 #define VL_FLAG_RESIZED     (1<<2)
+#define VL_FLAG_CREATED     (1<<3)
+#define VL_FLAG_DELETED     (1<<4)
+#define VL_FLAG_CHMODDED    (1<<5)
+
+/// File Watch condition flag: watch all files in the block
+#define VL_WATCH_ANYID      (1<<7)
 
 
 
@@ -202,6 +236,61 @@ typedef struct {
 ot_u8 vl_init(void);
 
 
+/** @brief  Attaches an action callback to a file
+  * @param  block_id    (vlBLOCK) Block ID of the file
+  * @param  data_id     (ot_u8) File ID
+  * @param  condition   (ot_u8) VL_FLAG_... mask that triggers action on close
+  * @retval ot_int      Action slot index, or negative on failure
+  * @ingroup Veelite
+  *
+  * The action is called from vl_close() when any of the condition flags are
+  * set on the file pointer (e.g. VL_FLAG_MODDED for writes).  Requires the
+  * VLACTIONS feature: otherwise this function always fails.
+  */
+ot_int vl_add_action(vlBLOCK block_id, ot_u8 data_id, ot_u8 condition, ot_procv action);
+
+
+/** @brief  Detaches the action callback from a file
+  * @param  block_id    (vlBLOCK) Block ID of the file
+  * @param  data_id     (ot_u8) File ID
+  * @retval None
+  * @ingroup Veelite
+  */
+void vl_remove_action(vlBLOCK block_id, ot_u8 data_id);
+
+
+/** @brief  Subscribes a callback to changes of a file
+  * @param  block_id    (vlBLOCK) Block ID of the file
+  * @param  data_id     (ot_u8) File ID (ignored with VL_WATCH_ANYID)
+  * @param  condition   (ot_u8) VL_FLAG_... mask of changes to watch, and
+  *                     optionally VL_WATCH_ANYID to watch the whole block
+  * @param  action      (ot_procv) Callback, which receives a vl_event_t*
+  * @retval ot_int      Watch handle, or negative on failure
+  * @ingroup Veelite
+  *
+  * Watchers are the way to keep caches of file data coherent.  Any number of
+  * watchers may watch the same file, and the event tells which part of the
+  * file was written, so a cache can invalidate only what it needs to.
+  *
+  * Events are sent from vl_close() for data changes (VL_FLAG_MODDED and
+  * VL_FLAG_RESIZED), and from vl_new(), vl_delete() and vl_chmod() for
+  * VL_FLAG_CREATED, VL_FLAG_DELETED and VL_FLAG_CHMODDED.  The callback runs
+  * inside these functions, so it should be short and it should not open files.
+  *
+  * Registering the same watch twice returns the same handle.  Requires the
+  * VLWATCH feature (OT_PARAM_VLWATCHERS watchers, maximum 16).
+  */
+ot_int vl_watch(vlBLOCK block_id, ot_u8 data_id, ot_u8 condition, ot_procv action);
+
+
+/** @brief  Removes a file watcher
+  * @param  handle      (ot_int) Watch handle from vl_watch()
+  * @retval None
+  * @ingroup Veelite
+  */
+void vl_unwatch(ot_int handle);
+
+
 
 
 // General File functions
@@ -440,6 +529,8 @@ ot_uint vl_load( vlFILE* fp, ot_uint length, ot_u8* data );
   * @param  data        (ot_u8*) byte buffer to write to file
   * @retval (ot_u8)     Non-zero on failure
   * @ingroup Veelite
+  *
+  * Ring files can't be stored to: use vl_ring_append().
   */
 ot_u8 vl_store( vlFILE* fp, ot_uint length, const ot_u8* data );
 
@@ -450,6 +541,136 @@ ot_u8 vl_append( vlFILE* fp, ot_uint length, const ot_u8* data );
 
 
 
+/** @brief  Loads a span of a file into a supplied byte-buffer
+  * @param  fp          (vlFILE*) file pointer of open file
+  * @param  offset      (ot_uint) byte offset of the span (may be odd)
+  * @param  length      (ot_uint) number of bytes to load
+  * @param  data        (ot_u8*) byte buffer to load into
+  * @retval (ot_uint)   Number of bytes loaded into byte-buffer
+  * @ingroup Veelite
+  *
+  * Like vl_load(), but from any offset.  The span is clipped to the length of
+  * the file.
+  */
+ot_uint vl_loadspan( vlFILE* fp, ot_uint offset, ot_uint length, ot_u8* data );
+
+
+
+/** @brief  Stores a byte-buffer into a span of a file
+  * @param  fp          (vlFILE*) file pointer of open file
+  * @param  offset      (ot_uint) byte offset of the span (may be odd)
+  * @param  length      (ot_uint) number of bytes to store
+  * @param  data        (ot_u8*) byte buffer to write to file
+  * @retval (ot_u8)     Non-zero on failure
+  * @ingroup Veelite
+  *
+  * Bytes outside of the span are preserved, and the file length is extended
+  * if the span goes past it.  Nothing is written if the span goes past the
+  * allocation of the file.
+  */
+ot_u8 vl_storespan( vlFILE* fp, ot_uint offset, ot_uint length, const ot_u8* data );
+
+
+
+
+/** @brief  Patches a file in place from a binary delta
+  * @param  fp          (vlFILE*) file pointer of file opened for writing
+  * @param  length      (ot_uint) length of the delta in bytes
+  * @param  delta       (ot_u8*) delta to apply
+  * @retval (ot_u8)     0 on success, 1 if the file is not the base of the
+  *                     delta, 2 if the patched file does not match the
+  *                     result CRC, 255 if the delta is invalid, a write
+  *                     failed, or the file is a ring file
+  * @ingroup Veelite
+  *
+  * The delta is [Base CRC:2][Result CRC:2][Op]...  The base CRC is the CRC16
+  * of the file contents that the delta was made against, and the result CRC
+  * is the CRC16 of the contents it produces.  Each op walks a cursor forward
+  * through the file.  The op byte has the opcode in b7-5 and a length of
+  * 1-31 in b4-0.  A length of 0 means the length is in the next two bytes.
+  * <LI> COPY:   keep the next N bytes of the file as they are </LI>
+  * <LI> SET:    overwrite the next N bytes with N bytes from the delta, which
+  *              may extend the file (up to its allocation) </LI>
+  * <LI> INSERT: insert N bytes from the delta at the cursor </LI>
+  * <LI> DELETE: remove the next N bytes from the file </LI>
+  * <LI> TRUNC:  end the file at the cursor (no length, must be the last op)
+  *              </LI>
+  * File data after the last op is kept.  The whole delta is checked against
+  * the file before anything is written, so an invalid delta leaves the file
+  * untouched.  A result CRC mismatch (2) means the file has been changed, and
+  * it must be rewritten in full.  Requires OT_FEATURE_VLRESTORE.
+  */
+#define VL_DELTA_COPY       0x00
+#define VL_DELTA_SET        0x20
+#define VL_DELTA_INSERT     0x40
+#define VL_DELTA_DELETE     0x60
+#define VL_DELTA_TRUNC      0x80
+
+ot_u8 vl_patch( vlFILE* fp, ot_uint length, const ot_u8* delta );
+
+
+
+/** @note Ring Files
+  * A ring file is a circular log with a fixed allocation, intended for sensor
+  * samples and other time series.  A file is a ring when its mod has the
+  * VL_MOD_RING marker, which vl_ring_format() sets.  The file data starts with
+  * a 4 byte preamble, [head:2][fill:2], followed by the ring itself.  The
+  * file length is always equal to the allocation, so appending has constant
+  * cost: it writes the new bytes and two preamble words, and it never resizes
+  * the file or changes the file header.  Once the ring is full, each append
+  * overwrites the oldest bytes.
+  *
+  * Ring data is addressed by logical offset, where 0 is the oldest byte in
+  * the ring.  The File Data ALP, M2QP file loads and DASHForth file reads all
+  * use logical offsets when reading a ring file.
+  * The ring functions require OT_FEATURE_VLRING.
+  */
+#define VL_RING_PREAMBLE    4
+
+/** @brief  Formats an open file as an empty ring file
+  * @param  fp          (vlFILE*) file pointer of file opened for writing
+  * @retval (ot_u8)     Non-zero on failure
+  * @ingroup Veelite
+  *
+  * The allocation must be at least VL_RING_PREAMBLE+2 bytes.  The ring holds
+  * (alloc - VL_RING_PREAMBLE) bytes, rounded down to an even number.  The file
+  * mod is changed to carry VL_MOD_RING, which removes any execute rights.
+  */
+ot_u8 vl_ring_format( vlFILE* fp );
+
+/** @brief  Returns the number of bytes stored in a ring file
+  * @param  fp          (vlFILE*) file pointer of open file
+  * @retval (ot_int)    Bytes in the ring, or -1 if the file is not a ring
+  * @ingroup Veelite
+  */
+ot_int vl_ring_fill( vlFILE* fp );
+
+/** @brief  Appends data to a ring file, overwriting the oldest data if full
+  * @param  fp          (vlFILE*) file pointer of ring file opened for writing
+  * @param  length      (ot_uint) number of bytes to append
+  * @param  data        (ot_u8*) data to append
+  * @retval (ot_u8)     Non-zero on failure
+  * @ingroup Veelite
+  *
+  * If length is larger than the ring, only the last bytes of data are kept.
+  */
+ot_u8 vl_ring_append( vlFILE* fp, ot_uint length, const ot_u8* data );
+
+/** @brief  Reads a window of data from a ring file
+  * @param  fp          (vlFILE*) file pointer of open ring file
+  * @param  offset      (ot_uint) logical offset, where 0 is the oldest byte
+  * @param  length      (ot_uint) maximum number of bytes to read
+  * @param  data        (ot_u8*) byte buffer to load into
+  * @retval (ot_uint)   Number of bytes loaded, 0 if the file is not a ring
+  * @ingroup Veelite
+  *
+  * Reads unwrap the ring: data is always loaded from oldest to newest.
+  */
+ot_uint vl_ring_read( vlFILE* fp, ot_uint offset, ot_uint length, ot_u8* data );
+
+
+
+
 /** @brief  Crops (or erases) a file contents without deleting the file
   * @param  fp          (vlFILE*) file pointer of open file
   * @param  offset      (ot_uint) file data offset to crop after
@@ -467,6 +688,19 @@ ot_u8 vl_erase(vlFILE* fp);
 */
 
 
+/** @brief Executes an open file with some input
+  * @param  fp              (vlFILE*) file pointer of open file
+  * @param  input_size      (ot_uint) number of input bytes
+  * @param  input_stream    (ot_u8*) input bytes
+  * @param  user_id         (const id_tmpl*) user requesting the execution
+  * @retval (ot_u8)         Non-zero on failure
+  * @ingroup Veelite
+  *
+  * DASHForth applet files are run with the input, with the access rights of
+  * user_id.  Other files store the input and call their veelite action.
+  */
+ot_u8 vl_execute( vlFILE* fp, ot_uint input_size, ot_u8* input_stream, const id_tmpl* user_id );
+
 /** @brief Closes the data read/write session of the open file
   * @param none
   * @retval (ot_u8) : Non-zero on failure
@@ -481,6 +715,46 @@ ot_u8 vl_close( vlFILE* fp );
   */
 ot_uint vl_checklength( vlFILE* fp );
 
+/** @brief Returns a pointer to the file data, when it is contiguous in RAM
+  * @param fp       (vlFILE*) open file pointer
+  * @retval ot_u8*  pointer to first byte of file data, or NULL
+  * @ingroup Veelite
+  *
+  * On builds with DATAFLASH, only mirrored files can return a pointer.
+  * Otherwise, use vl_read() or vl_load().
+  */
+ot_u8* vl_memptr( vlFILE* fp );
+
+/** @brief Returns the filesystem modification count
+  * @param none
+  * @retval (ot_u32) : modification count
+  * @ingroup Veelite
+  *
+  * The count increments on each vl_close() of a modified or resized file, and
+  * on each file create, delete, or chmod.  Caches of file data may compare it
+  * against a saved count to see if they are stale.  It is 32 bits so that it
+  * does not wrap back onto a saved count in any practical uptime.
+  */
+ot_u32 vl_get_modcount(void);
+
+/** @brief Writes cached file header updates back to the filesystem
+  * @param none
+  * @retval none
+  * @ingroup Veelite
+  *
+  * With the VLHDRCACHE feature, vl_close() does not write the file length,
+  * access time and modification time to the file header right away.  Only the
+  * fields that change are kept in a small RAM cache, and written back together
+  * when the cache entry is evicted or when vl_flush() is called.  The kernel
+  * calls vl_flush() before going into its deepest sleep, and ISF_syncmirror()
+  * calls it on power-down.  Without VLHDRCACHE this function does nothing.
+  *
+  * Cached updates that are not flushed are lost on a power failure, so the
+  * file keeps its previous length.  VLHDRCACHE is disabled by default, and it
+  * should only be enabled on platforms that are sure to flush on power-down.
+  */
+void vl_flush(void);
+
 /** @brief Returns the length of the open file (GFB, ISF, ISS)
   * @param none
   * @retval (ot_uint) : length in bytes
@@ -41,6 +41,7 @@
 #include <otsys/types.h>
 #include <otsys/config.h>
 #include <otlib/utils.h>
+#include <otlib/memcpy.h>
 
 #include <m2/radio.h>
 #include "radio_NULL.h"
@@ -381,6 +382,37 @@ OT_WEAK void radio_getfourbytes(ot_u8* data) {
 #endif
 
 
+#ifndef EXTF_radio_putburst
+OT_WEAK ot_int radio_putburst(ot_u8* data, ot_int limit) {
+    ot_int space;
+
+    space = rfctl.txlimit - fake_put;
+    if (space > ((ot_int)sizeof(fake_data) - fake_put)) {
+        space = (ot_int)sizeof(fake_data) - fake_put;
+    }
+    if (limit > space)  limit = space;
+    if (limit <= 0)     return 0;
+
+    memcpy(&fake_data[fake_put], data, limit);
+    fake_put += limit;
+    return limit;
+}
+#endif
+
+
+#ifndef EXTF_radio_getburst
+OT_WEAK ot_int radio_getburst(ot_u8* data, ot_int limit) {
+    if (limit > fake_put)   limit = fake_put;
+    if (limit <= 0)         return 0;
+
+    memcpy(data, &fake_data[fake_get], limit);
+    fake_put -= limit;
+    fake_get += limit;
+    return limit;
+}
+#endif
+
+
 #ifndef EXTF_radio_flush_rx
 OT_WEAK void radio_flush_rx() {
     fake_get = 0;
@@ -588,6 +620,9 @@ void rm2_rxsync_isr() {
 /// Prepare driver for data reception, update high-level module state, and have
 /// supervisor task (DLL) go into high-priority mode.
     q_empty(&rxq);
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    em2_decode_newpacket();     // Sync always starts the first frame
+#   endif
     radio.state = RADIO_DataRX;
     ///@todo when kernel is properly emulated: dll_block();
 }
@@ -649,11 +684,17 @@ void rm2_rxdata_isr() {
 
         /// RX State 1: Paging Mode
         /// Paging Mode is used for Foreground packet reception.  Multiframe packets
-        /// use it for the final frame.
+        /// use it for each frame, and switch to RX State 3 near the end of every
+        /// frame except the last one.
         case (RADIO_STATE_RXPAGE >> RADIO_STATE_RXSHIFT): {
             ot_int chipoctets_left;
 
             if (em2.bytes <= 0) {
+#               if (M2_FEATURE(MULTIFRAME) == ENABLED)
+                if (em2_remaining_frames() != 0) {
+                    goto rm2_rxdata_isr_NEXTFRAME;
+                }
+#               endif
                 goto rm2_rxdata_isr_DONE;
             }
 
@@ -661,6 +702,11 @@ void rm2_rxdata_isr() {
             if (chipoctets_left  <= 96) {
                 rfctl.rxlimit   = chipoctets_left;
                 rfctl.state     = RADIO_STATE_RXDONE;
+#               if (M2_FEATURE(MULTIFRAME) == ENABLED)
+                if (em2_remaining_frames() != 0) {
+                    rfctl.state = RADIO_STATE_RXMFP;
+                }
+#               endif
                 break;
             }
 
@@ -670,27 +716,23 @@ void rm2_rxdata_isr() {
             break;
         }
 
-        /// RX State 2 & 3:
-        /// Multiframe packets (only compiled when MFPs are supported)
-        ///@todo Experimental, not presently supported
+        /// RX State 3: Multiframe packet, non-final frame is ending.
+        /// When the frame is complete, it is closed-out (which reassembles it
+        /// into the packet), the next frame is set up, and decoding continues
+        /// with the data already in the FIFO.
 #       if (M2_FEATURE(MULTIFRAME) == ENABLED)
-#       error "Multiframe Not presently supported"
-        case (RADIO_STATE_RXMFP >> RADIO_STATE_RXSLOT):
         case (RADIO_STATE_RXMFP >> RADIO_STATE_RXSHIFT): {
-            ot_int  frames_left = em2_remaining_frames();
-            if (em2.bytes == 0) {
-                if (frames_left == 0) {
-                    goto rm2_rxdata_isr_DONE;
-                }
-                radio.evtdone(frames_left, em2_decode_endframe());
-                q_rebase(&rxq, rxq.putcursor);
-                em2_decode_newframe();
-                rfctl.flags |= RADIO_FLAG_CRC5;
-                goto rm2_rxdata_isr_DECODE;
-            }
-            else if (frames_left == 0) {
+            if (em2.bytes > 0) {
+                break;
             }
-        } break;
+            rm2_rxdata_isr_NEXTFRAME:
+            radio.evtdone(1, em2_decode_endframe());
+            em2_decode_newframe();
+            rfctl.state     = RADIO_STATE_RXPAGE;
+            rfctl.rxlimit   = _RXMINTHR;
+            rfctl.flags    |= RADIO_FLAG_CRC5;
+            goto rm2_rxdata_isr_DECODE;
+        }
 #       endif
 
         /// Bug Trap
@@ -725,9 +767,6 @@ void rm2_txinit(ot_u8 psettings, ot_sig2 callback) {
                           | RADIO_FLAG_CRC5     );
 #   if (SYS_FLOOD == ENABLED)
     rfctl.flags    |= (psettings != 0);   //sets RADIO_FLAG_BG
-#   endif
-#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
-    rfctl.flags    |= ((session_netstate() & M2_NETSTATE_DSDIALOG) >> 1); //sets RADIO_FLAG_FRCONT
 #   endif
     radio.evtdone   = callback;
     radio.state     = RADIO_Csma;
@@ -954,23 +993,21 @@ void rm2_txdata_isr() {
     rm2_txpkt_TXDATA:
     em2_encode_data();
     if (em2_remaining_bytes() == 0) {
-        rfctl.state = RADIO_STATE_TXDONE;
-        //spirit1_int_txdone();
-    }
-#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
-    else {
+#       if (M2_FEATURE(MULTIFRAME) == ENABLED)
         /// If the frame is done, but more need to be sent (e.g. MFP's)
-        /// queue it up.  The additional encode stage is there to fill up
-        /// what's left of the buffer.
+        /// queue it up.  The encoder frames the next part of txq in place.
+        /// The additional encode stage is there to fill up what's left of
+        /// the buffer.
         if (em2_remaining_frames() != 0) {
-            q_rebase(&txq, txq.getcursor);
             radio.evtdone(1, 0);        //callback action for next frame
             em2_encode_newframe();
             txq.front[2] = (phymac[0].tx_eirp & 0x7f);
             goto rm2_txpkt_TXDATA;
         }
+#       endif
+        rfctl.state = RADIO_STATE_TXDONE;
+        //spirit1_int_txdone();
     }
-#   endif
 }
 #endif
 
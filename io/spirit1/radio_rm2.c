@@ -64,6 +64,8 @@
 #include <otlib/buffers.h>
 #include <otlib/crc16.h>
 #include <otlib/utils.h>
+#include <otlib/memcpy.h>
+#include <otsys/veelite.h>
 
 // Local header for subroutines and implementation constants (supports patching)
 #include "radio_rm2.h"
@@ -91,6 +93,41 @@
 rfctl_struct rfctl;
 
 
+/** RX FIFO threshold adaptation
+  * The RX FIFO interrupt comes when the FIFO holds a threshold of bytes.  By
+  * the time the ISR reads the FIFO, more bytes have come in.  That excess is
+  * the ISR latency, measured in bytes at the data rate of the channel.  The
+  * driver tracks it per channel class (class bits and FEC bit of the channel
+  * ID), and sets the threshold as high as it can while leaving room for twice
+  * the worst recent latency.  Fast channels take fewer interrupts, and slow
+  * channels under CPU load still do not overrun.
+  *
+  * The estimates live in RAM.  They are published to the radio_fifo_stats ISF
+  * at most once every _RXSAVEGAP RX inits, because each ISF write counts as a
+  * filesystem modification (query cache flush, watcher notification).
+  */
+#if (RF_FEATURE(FIFOADAPT) == ENABLED)
+#   define _RXCLASSES       8
+#   define _RXMARGIN        8
+#   define _RXCEILING       (96 - _RXMARGIN)
+#   define _RXSAVEGAP       64
+#   define __RXFIFO_THR()   rxfifo.thr[rxfifo.cls]
+
+typedef struct {
+    ot_bool dirty;
+    ot_u8   holdoff;
+    ot_u8   cls;
+    ot_u8   thr[_RXCLASSES];
+    ot_u8   lag[_RXCLASSES];
+} rxfifo_struct;
+
+static rxfifo_struct rxfifo;
+
+#else
+#   define __RXFIFO_THR()   _RXMAXTHR
+#endif
+
+
 
 
 /** Local Subroutine Prototypes  <BR>
@@ -183,6 +220,9 @@ OT_WEAK void radio_init( ) {
     spirit1_write(RFREG(TEST_SELECT), 0x04);
     spirit1_write(RFREG(TEST_SELECT), 0x00);
 
+    /// Start RX FIFO thresholds at the fixed defaults
+    spirit1drv_rxfifo_init();
+
     /// Done with the radio init
     //spirit1drv_smart_standby();
     radio_sleep();
@@ -455,6 +495,11 @@ OT_WEAK void rm2_rxinit(ot_u8 channel, ot_u8 psettings, ot_sig2 callback) {
             return;
         }
 
+        /// 2b. Publish threshold changes, rate-limited (this is not in
+        ///     interrupt context), then select the thresholds for the channel
+        spirit1drv_rxfifo_save();
+        spirit1drv_rxfifo_select();
+
         /// 3. Prepare modem state-machine to do RX-Idle or RX-RX
         ///    RX-RX happens during Response listening, unless FIRSTRX is high
         //netstate &= (M2_NETFLAG_FIRSTRX | M2_NETSTATE_RESP);
@@ -545,6 +590,7 @@ OT_WEAK void rm2_reenter_rx(ot_sig2 callback) {
     rfctl.state     = rxstates[(rfctl.flags & RADIO_FLAG_BG)];
     rfctl.flags    |= rxstates[2 + (rfctl.flags & RADIO_FLAG_BG)];
     rfctl.rxlimit   = (96-_RXMINTHR);
+    rfctl.rxpeak    = 0;
     spirit1_write(RFREG(FIFO_CONFIG3), (ot_u8)rfctl.rxlimit );
 
     radio_gag();                    // This shouldn't be necessary, but there's a bug in the rxend function.
@@ -615,6 +661,8 @@ OT_WEAK void rm2_rxdata_isr() {
     /// 2. load data
     rm2_rxdata_isr_DECODE:
     em2_decode_data();      // Contains logic to prevent over-run
+    spirit1drv_rxfifo_adapt(rfctl.rxpeak);
+    rfctl.rxpeak = 0;
 
     /// 3. Software-based FIFO resizing and CRC5 filtering
     if (rfctl.flags & RADIO_FLAG_CRC5) {
@@ -660,8 +708,8 @@ OT_WEAK void rm2_rxdata_isr() {
                 rfctl.state     = RADIO_STATE_RXDONE;
                 goto rm2_rxdata_isr_RESIZE;
             }
-            if (rfctl.rxlimit != (96-_RXMAXTHR)) {
-                rfctl.rxlimit   = (96-_RXMAXTHR);
+            if (rfctl.rxlimit != (96-__RXFIFO_THR())) {
+                rfctl.rxlimit   = (96-__RXFIFO_THR());
                 goto rm2_rxdata_isr_RESIZE;
             }
             break;
@@ -1170,6 +1218,84 @@ void spirit1drv_save_linkinfo() {
 }
 
 
+void spirit1drv_rxfifo_init() {
+#if (RF_FEATURE(FIFOADAPT) == ENABLED)
+    memset(rxfifo.thr, _RXMAXTHR, _RXCLASSES);
+    memset(rxfifo.lag, 0, _RXCLASSES);
+    rxfifo.cls      = 0;
+    rxfifo.holdoff  = 0;
+    rxfifo.dirty    = True;
+#endif
+}
+
+
+void spirit1drv_rxfifo_select() {
+#if (RF_FEATURE(FIFOADAPT) == ENABLED)
+    rxfifo.cls = ((phymac[0].channel >> 4) & 3) | ((phymac[0].channel & 0x80) >> 5);
+#endif
+}
+
+
+void spirit1drv_rxfifo_adapt(ot_int level) {
+/// level is the FIFO fill found by the ISR, which came at the threshold set by
+/// rfctl.rxlimit.  Lag goes up at once, and decays by 1/8 of the difference per
+/// sample.  A full FIFO may have overrun, so it counts as extra lag.
+#if (RF_FEATURE(FIFOADAPT) == ENABLED)
+    ot_int  sample;
+    ot_int  lag;
+    ot_int  thr;
+
+    if (level <= 0) {
+        return;
+    }
+    sample  = level - (96 - rfctl.rxlimit);
+    sample += (level >= 96) ? _RXMARGIN : 0;
+    lag     = rxfifo.lag[rxfifo.cls];
+
+    if (sample >= lag)  lag = sample;
+    else                lag-= (lag - sample + 7) >> 3;
+
+    thr = _RXCEILING - (lag << 1);
+    if (thr < _RXMINTHR) {
+        thr = _RXMINTHR;
+    }
+
+    if ((rxfifo.thr[rxfifo.cls] != thr) || (rxfifo.lag[rxfifo.cls] != lag)) {
+        rxfifo.thr[rxfifo.cls]  = (ot_u8)thr;
+        rxfifo.lag[rxfifo.cls]  = (ot_u8)lag;
+        rxfifo.dirty            = True;
+    }
+#endif
+}
+
+
+void spirit1drv_rxfifo_save() {
+/// The ISF holds the 8 class thresholds, then the 8 class lags, in bytes.
+/// Class index is: (channel[5:4]) | (channel[7] << 2)
+/// Changes are held in RAM until the holdoff has run out, so the ISF is not
+/// rewritten on every RX.
+#if ((RF_FEATURE(FIFOADAPT) == ENABLED) && defined(ISF_ID_radio_fifo_stats))
+    vlFILE* fp;
+    ot_u8   stats[2*_RXCLASSES];
+
+    if (rxfifo.holdoff != 0) {
+        rxfifo.holdoff--;
+    }
+    else if (rxfifo.dirty) {
+        fp = ISF_open_su(ISF_ID(radio_fifo_stats));
+        if (fp != NULL) {
+            memcpy(&stats[0], rxfifo.thr, _RXCLASSES);
+            memcpy(&stats[_RXCLASSES], rxfifo.lag, _RXCLASSES);
+            vl_store(fp, (2*_RXCLASSES), stats);
+            vl_close(fp);
+        }
+        rxfifo.dirty    = False;
+        rxfifo.holdoff  = _RXSAVEGAP;
+    }
+#endif
+}
+
+
 void spirit1drv_force_ready() {
 /// Goes to READY without modifying states.  Use with caution.
 ///@note alternate version uses Ready-line test instead of flag test.
@@ -1346,6 +1472,71 @@ OT_WEAK void radio_getfourbytes(ot_u8* data) {
 }
 #endif
 
+#ifndef EXTF_radio_putburst
+OT_WEAK ot_int radio_putburst(ot_u8* data, ot_int limit) {
+/// The two bytes ahead of data are borrowed for the SPI write header, so the
+/// data goes out from where it is, without a copy.  The FIFO address does not
+/// auto-increment, so the whole block goes into the FIFO.
+    ot_int  fill;
+    ot_int  total;
+    ot_u8   save[2];
+    ot_u8*  cmd;
+
+    total = rfctl.txlimit - spirit1_txbytes();
+    if (limit < total) {
+        total = limit;
+    }
+
+    for (limit=0; limit<total; limit+=fill) {
+        fill = total - limit;
+        if (fill > RF_PARAM(BURST_BYTES)) {
+            fill = RF_PARAM(BURST_BYTES);
+        }
+        cmd     = &data[limit];
+        save[0] = *(--cmd);
+        *cmd    = RFREG(FIFO);
+        save[1] = *(--cmd);
+        *cmd    = 0x00;
+        spirit1_spibus_io(fill+2, 0, cmd);
+        *cmd++  = save[1];
+        *cmd    = save[0];
+    }
+
+    /// dummy SPI access to complete fill
+    *(ot_u16*)save  = PLATFORM_ENDIAN16_C(0x8000);
+    spirit1_spibus_io(2, 0, save);
+
+    return (total > 0) ? total : 0;
+}
+#endif
+
+#ifndef EXTF_radio_getburst
+OT_WEAK ot_int radio_getburst(ot_u8* data, ot_int limit) {
+    static const ot_u8 cmd[] = { 0x01, RFREG(FIFO) };
+    ot_int  grab;
+    ot_int  total;
+
+    total = spirit1_rxbytes();
+    if (total > rfctl.rxpeak) {
+        rfctl.rxpeak = total;
+    }
+    if (limit < total) {
+        total = limit;
+    }
+
+    for (limit=0; limit<total; limit+=grab) {
+        grab = total - limit;
+        if (grab > RF_PARAM(BURST_BYTES)) {
+            grab = RF_PARAM(BURST_BYTES);
+        }
+        spirit1_spibus_io(2, grab, (ot_u8*)cmd);
+        memcpy(&data[limit], spirit1.busrx, grab);
+    }
+
+    return (total > 0) ? total : 0;
+}
+#endif
+
 
 ///@note this IRQ flushing is needed if you are using a driver interrupt based
 ///      on the SPIRIT1 IRQ system.  Presently, all driver interrupts are using
@@ -84,6 +84,7 @@
   * flags       A local store for usage flags
   * txlimit     An interrupt/event comes when tx buffer gets below this number of bytes
   * rxlimit     An interrupt/event comes when rx buffer gets above this number of bytes
+  * rxpeak      Highest rx buffer level seen by radio_getburst(), since last cleared
   */
 typedef struct {
     ot_u8   state;
@@ -91,6 +92,7 @@ typedef struct {
     ot_int  nextcal;
     ot_int  txlimit;
     ot_int  rxlimit;
+    ot_int  rxpeak;
 } rfctl_struct;
 
 extern rfctl_struct rfctl;
@@ -112,6 +114,11 @@ void spirit1drv_txend_isr();
 void spirit1drv_buffer_config(MODE_enum mode, ot_u16 param);
 void spirit1drv_save_linkinfo();
 
+void spirit1drv_rxfifo_init(void);
+void spirit1drv_rxfifo_select(void);
+void spirit1drv_rxfifo_adapt(ot_int level);
+void spirit1drv_rxfifo_save(void);
+
 
 
 
@@ -97,62 +97,34 @@ void em2_decode_newframe() {
 
 #ifndef _DSSS
 void em2_encode_data(void) {
-    ot_int  fill;
-    ot_int  load;
-    ot_u8   save[2];
-    ot_u8*  cmd;
+/// CRC and RS are calculated ahead of the FIFO, over all the remaining data,
+/// so they are done by the time their output bytes are loaded.  Doing them in
+/// one go also keeps them out of the later FIFO refill interrupts.
+    ot_int fill;
 
-    // Loop unrolling for FIFO loading
-    load = (rfctl.txlimit - spirit1_txbytes());
-
-    while (1) {
-        fill = (load < em2.bytes) ? load : em2.bytes;
-        if (fill <= 0) break;
-
-        if (fill > 24) fill = 24;
-        load       -= fill;
-        em2.bytes  -= fill;
-
-        if (txq.options.ubyte[UPPER] != 0) {
-            crc_calc_nstream(&em2.crc, fill);
-#           if (M2_FEATURE(RSCODE))
-            if (em2.lctl & 0x40) {
-                em2_rs_encode(fill);
-            }
-#           endif
+    if (txq.options.ubyte[UPPER] != 0) {
+        crc_calc_nstream(&em2.crc, em2.bytes);
+#       if (M2_FEATURE(RSCODE))
+        if (em2.lctl & 0x40) {
+            em2_rs_encode(em2.bytes);
         }
-
-        cmd     = txq.getcursor;
-        save[0] = *(--cmd);
-        *cmd    = 0xff;
-        save[1] = *(--cmd);
-        *cmd    = 0x00;
-
-        txq.getcursor += fill;
-        spirit1_spibus_io(fill+2, 0, cmd);
-        *cmd++  = save[1];
-        *cmd    = save[0];
+#       endif
     }
 
-    /// dummy SPI access to complete fill
-    //spirit1_read(RFREG(IRQ_STATUS0));
-    *(ot_u16*)save  = PLATFORM_ENDIAN16_C(0x8000);
-    spirit1_spibus_io(2, 0, save);
+    fill            = radio_putburst(txq.getcursor, em2.bytes);
+    txq.getcursor  += fill;
+    em2.bytes      -= fill;
 }
 
 
 void em2_decode_data(void) {
-    static const ot_u8 cmd[] = { 0x01, 0xFF };
-    ot_u16 grab;
+    ot_int grab;
 
     em2_decode_data_TOP:
 
-    grab = spirit1_rxbytes();
+    grab = radio_getburst(rxq.putcursor, q_writespace(&rxq));
     if (grab != 0) {
-        if (grab > 24)  grab = 24;
-
-        spirit1_spibus_io(2, grab, (ot_u8*)cmd);
-        q_writestring(&rxq, spirit1.busrx, grab);
+        rxq.putcursor += grab;
 
         if (em2.state == 0) {
             ot_int ext_bytes;
@@ -40,6 +40,19 @@
 #define OTAPI_Q     rxq
 
 
+#if (M2_PARAM(REQIMAGE) > 0)
+/// Request image compiler state: set by otapi_open_request()
+typedef struct {
+    ot_qcur         body;
+    ot_u8           addressing;
+    ot_u8           patches;
+    reqpatch_tmpl   patch[M2_PARAM(REQPATCHES)];
+} capi_struct;
+
+static capi_struct capi;
+#endif
+
+
 ot_u16 sub_session_handle(m2session* active) {
     return (active == NULL) ? 0 : *((ot_u16*)&active->channel);
 }
@@ -139,6 +152,12 @@ ot_u16 otapi_open_request(addr_type addr, routing_tmpl* routing) {
 
         // Load the header
         m2np_header(s_active, (ot_u8)addr, M2FI_FRDIALOG);
+
+#       if (M2_PARAM(REQIMAGE) > 0)
+        capi.body       = txq.putcursor;
+        capi.addressing = (ot_u8)addr;
+        capi.patches    = 0;
+#       endif
         return 1;
     }
     return 0;
@@ -349,6 +368,21 @@ ot_u16 otapi_put_isf_call(ot_u8* status, isfcall_tmpl* isfcall) {
 #endif
 
 
+#ifndef EXTF_otapi_put_isf_agg
+ot_u16 otapi_put_isf_agg(ot_u8* status, isfagg_tmpl* isfagg) {
+    q_writebyte(&txq, isfagg->reducers);
+    q_writebyte(&txq, isfagg->format);
+    q_writebyte(&txq, isfagg->last);
+    q_writebyte(&txq, isfagg->isf_id);
+    sub_put_isf_offset((isfagg->reducers & M2AG_SERIES), isfagg->offset);
+    q_writeshort(&txq, isfagg->window);
+
+    *status = 1;
+    return q_length(&txq);
+}
+#endif
+
+
 #ifndef EXTF_otapi_put_isf_return
 ot_u16 otapi_put_isf_return(ot_u8* status, isfcall_tmpl* isfcall) {
     ot_queue    local_q;
@@ -376,41 +410,36 @@ ot_u16 otapi_put_udp_tmpl(ot_u8* status, udp_tmpl* udp) {
     
     space = q_writespace(&txq);
     
-#   if (M2_FEATURE(MULTIFRAME))
-    ///@todo Multiframe support: it will still return error when the UDP data
-    ///      length is bigger than the max packet payload size, but it will
-    ///      detect boundaries across the packet rather than simply across the
-    ///      frame.  It will probably require a network-layer function to 
-    ///      determine the overhead when supplied payload length.
-#   else
+    ///@note With multiframe support, txq spans the whole packet, so the space
+    ///      check covers packet boundaries rather than frame boundaries.  The
+    ///      encoder cuts the packet into frames.  The UDP record length is
+    ///      still a single byte.
+    if (udp->data == NULL) {
+    	///@todo add a user to UDP type for access control
+    	fp              = ISF_open(udp->src_port, VL_ACCESS_R, AUTH_GUEST );
+    	udp->data_length= (fp != NULL) ? fp->length : 0;
+    }
+
+    space -= 4;
+    if ((space < udp->data_length) || (udp->data_length > 255)) {
+        *status = 0;
+    }
+    else {
+        *status = 1;
+        q_writebyte(&txq, (ALP_FLAG_MB | ALP_FLAG_ME));
+        q_writebyte(&txq, (ot_u8)udp->data_length);
+        q_writebyte(&txq, udp->dst_port);
+        q_writebyte(&txq, udp->src_port);
         
         if (udp->data == NULL) {
-        	///@todo add a user to UDP type for access control
-        	fp              = ISF_open(udp->src_port, VL_ACCESS_R, AUTH_GUEST );
-        	udp->data_length= (fp != NULL) ? fp->length : 0;
-        }
-        
-        space -= 4;
-        if (space < udp->data_length) {
-            *status = 0;
+            txq.putcursor += vl_load(fp, udp->data_length, txq.putcursor);
         }
         else {
-            *status = 1;
-            q_writebyte(&txq, (ALP_FLAG_MB | ALP_FLAG_ME));
-            q_writebyte(&txq, (ot_u8)udp->data_length);
-            q_writebyte(&txq, udp->dst_port);
-            q_writebyte(&txq, udp->src_port);
-            
-            if (udp->data == NULL) {
-                txq.putcursor += vl_load(fp, udp->data_length, txq.putcursor);
-            }
-            else {
-            	q_writestring(&txq, udp->data, udp->data_length);
-            }
+        	q_writestring(&txq, udp->data, udp->data_length);
         }
-        
-        vl_close(fp);
-#   endif
+    }
+
+    vl_close(fp);
 
     return q_length(&txq);
 }
@@ -449,6 +478,100 @@ ot_u16 otapi_put_propds(ot_u8* status, ot_queue* dsq) {
 
 
 
+#if (M2_PARAM(REQIMAGE) > 0)
+#ifndef EXTF_otapi_mark_patch
+ot_u16 otapi_mark_patch(ot_u8* status, ot_u8 skip, ot_u8 length) {
+    ot_int offset = (ot_int)(txq.putcursor - capi.body) + skip;
+
+    if ((capi.patches >= M2_PARAM(REQPATCHES)) \
+    || ((offset + length) > M2_PARAM(REQIMAGE))) {
+        *status = 0;
+        return 0;
+    }
+
+    capi.patch[capi.patches].offset = (ot_u8)offset;
+    capi.patch[capi.patches].length = length;
+    *status = 1;
+    return capi.patches++;
+}
+#endif
+
+
+#ifndef EXTF_otapi_compile_request
+ot_u16 otapi_compile_request(ot_u8* status, reqimg_tmpl* image) {
+    ot_int length = (ot_int)(txq.putcursor - capi.body);
+
+    if ((length <= 0) || (length > M2_PARAM(REQIMAGE))) {
+        *status = 0;
+        return 0;
+    }
+
+    image->addressing   = capi.addressing;
+    image->cmd_code     = m2qp.cmd.code;
+    image->cmd_ext      = m2qp.cmd.ext;
+    image->length       = (ot_u8)length;
+    image->patches      = capi.patches;
+    image->rx_channels  = dll.comm.rx_channels;
+    image->rx_timeout   = dll.comm.rx_timeout;
+    ot_memcpy((ot_u8*)image->patch, (ot_u8*)capi.patch, capi.patches*sizeof(reqpatch_tmpl));
+    ot_memcpy(image->data, capi.body, length);
+
+    *status = 1;
+    return (ot_u16)length;
+}
+#endif
+
+
+#ifndef EXTF_otapi_patch_request
+ot_u16 otapi_patch_request(reqimg_tmpl* image, ot_u8 index, const ot_u8* value) {
+    if (index >= image->patches) {
+        return 0;
+    }
+    ot_memcpy(&image->data[image->patch[index].offset], (ot_u8*)value, image->patch[index].length);
+    return 1;
+}
+#endif
+
+
+#ifndef EXTF_otapi_replay_request
+ot_u16 otapi_replay_request(reqimg_tmpl* image, routing_tmpl* routing) {
+    ot_u8 dialog;
+
+    if (otapi_open_request((addr_type)image->addressing, routing) == 0) {
+        return 0;
+    }
+    if (q_writespace(&txq) < image->length) {
+        /// The header is already in the TX queue, so the session can't be
+        /// left as it is: scrap it, as a failed applet does.
+        session_top()->netstate |= M2_NETSTATE_SCRAP;
+        return 0;
+    }
+
+    /// Restore the settings made by the command and dialog templates.  The
+    /// response channel list is only restored if the dialog template has one
+    /// (bit 7 of the dialog byte, which follows the command code & extension).
+    /// The list itself follows the dialog byte, in the copy in the TX queue.
+    dll.comm.csmaca_params |= image->cmd_code & M2_CSMACA_A2P;
+    dll.comm.rx_timeout     = image->rx_timeout;
+    m2qp.cmd.code           = image->cmd_code;
+    m2qp.cmd.ext            = image->cmd_ext;
+    dialog                  = (image->cmd_code >> 7) + 1;
+    if (image->data[dialog] & 0x80) {
+        dll.comm.rx_channels = image->rx_channels;
+        dll.comm.rx_chanlist = txq.putcursor + dialog + 1;
+    }
+
+    ot_memcpy(txq.putcursor, image->data, image->length);
+    txq.putcursor += image->length;
+
+    return otapi_close_request();
+}
+#endif
+#endif
+
+
+
+
 
 
 
@@ -93,6 +93,70 @@ static void sub_dll_flush(void);
 
 
 
+/** Compiled Scan & Beacon Schedules
+  * ============================================================================
+  * The hold-scan, sleep-scan, and beacon-transmit sequence ISFs are decoded
+  * into RAM the first time a wakeup needs them, with the timeout codes already
+  * converted to ticks.  Each wakeup is then an array index rather than an ISF
+  * open/read/close.  The schedules are dropped by a veelite action when one of
+  * these files is written, and by dll_refresh().  Without VLWATCH there are no
+  * veelite actions, so a schedule is also dropped after any filesystem change
+  * (vl_get_modcount()).
+  */
+
+#define _SCAN_ENTRIES       (ISF_MAX(sleep_scan_sequence)/4)
+#define _BEACON_ENTRIES     (ISF_MAX(beacon_transmit_sequence)/8)
+#define _SCAN_RETRY         1024        // ticks until an empty schedule is rechecked
+
+typedef struct {
+    ot_u32  timeout;
+    ot_u8   type;
+    ot_u8   channel;
+    ot_u8   code;
+} scanentry_t;
+
+typedef struct {
+    ot_u8       isf_id;         // 0 when not compiled
+    ot_u8       length;         // sequence length in bytes, as in the ISF
+    scanentry_t entry[_SCAN_ENTRIES];
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    ot_u32      modcount;
+#   endif
+} scansched_t;
+
+static scansched_t scansched[2];
+
+#if (M2_FEATURE(BEACONS) == ENABLED)
+typedef struct {
+    ot_u32  timeout;
+    ot_u8   btemp[8];
+} beaconentry_t;
+
+typedef struct {
+    ot_bool         valid;
+    ot_u8           length;     // sequence length in bytes, as in the ISF
+    beaconentry_t   entry[_BEACON_ENTRIES];
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    ot_u32          modcount;
+#   endif
+} beaconsched_t;
+
+static beaconsched_t beaconsched;
+#endif
+
+
+static ot_int sub_sched_invalidate(void* fp);
+#if !defined(__KERNEL_NONE__)
+static scansched_t* sub_scansched_get(ot_u8 isf_id);
+#   if (M2_FEATURE(BEACONS) == ENABLED)
+static beaconsched_t* sub_beaconsched_get(void);
+#   endif
+#endif
+
+
+
+
+
 /** Flow & Congestion Control Subroutines
   * ============================================================================
   */
@@ -241,6 +305,15 @@ OT_WEAK void dll_init(void) {
     m2qp_init();
     auth_init();
 
+    /// Drop the compiled scan & beacon schedules when their ISFs are written
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    vl_watch(VL_ISF_BLOCKID, ISF_ID(hold_scan_sequence), (VL_FLAG_MODDED | VL_FLAG_RESIZED), &sub_sched_invalidate);
+    vl_watch(VL_ISF_BLOCKID, ISF_ID(sleep_scan_sequence), (VL_FLAG_MODDED | VL_FLAG_RESIZED), &sub_sched_invalidate);
+#   if (M2_FEATURE(BEACONS) == ENABLED)
+    vl_watch(VL_ISF_BLOCKID, ISF_ID(beacon_transmit_sequence), (VL_FLAG_MODDED | VL_FLAG_RESIZED), &sub_sched_invalidate);
+#   endif
+#   endif
+
     /// Load the Network settings from ISF 0 to the dll.netconf buffer, reset
     /// the session, and send system to idle.
     dll_refresh();
@@ -268,7 +341,9 @@ OT_WEAK void dll_refresh(void) {
     vl_close(fp);
 
     // Reset the Scheduler (only does anything if scheduler is implemented)
+    // and force the scan/beacon schedules to be recompiled on next use.
     dll_refresh_rts();
+    sub_sched_invalidate(NULL);
     sub_dll_flush();
 }
 #endif
@@ -554,6 +629,19 @@ OT_WEAK void dll_beacon_applet(m2session* active) {
 
 
 
+static ot_int sub_sched_invalidate(void* event) {
+/// With an event, only the schedule of the file that changed is invalidated.
+/// With NULL, all schedules are.
+    ot_int data_id = (event == NULL) ? -1 : ((vl_event_t*)event)->data_id;
+
+    if ((data_id < 0) || (data_id == ISF_ID(hold_scan_sequence)))   scansched[ISF_ID(hold_scan_sequence) & 1].isf_id = 0;
+    if ((data_id < 0) || (data_id == ISF_ID(sleep_scan_sequence)))  scansched[ISF_ID(sleep_scan_sequence) & 1].isf_id = 0;
+#   if (M2_FEATURE(BEACONS) == ENABLED)
+    if ((data_id < 0) || (data_id == ISF_ID(beacon_transmit_sequence))) beaconsched.valid = False;
+#   endif
+    return 0;
+}
+
 
 
 
@@ -757,8 +845,8 @@ OT_WEAK void dll_systask_sleepscan(ot_task task) {
     ot_u8       s_code;
     ot_u8		s_type;
     ot_u8       netstate;
-    ot_uni16    scratch;
-    vlFILE*     fp;
+    scansched_t*        sched;
+    const scanentry_t*  scan;
     m2session*  s_new;
 
     /// event = 0 is the initializer, but there is no state-based operation
@@ -769,27 +857,32 @@ OT_WEAK void dll_systask_sleepscan(ot_task task) {
 
     ///@todo check against session availability.
 
-    fp = ISF_open_su( task->event );
-    ///@note fp doesn't really need to be asserted unless you are mucking
-    ///      with things in test builds.
-
-    /// Set the next idle event from the two-byte Next Scan field.
-    /// The DASH7 registry is big-endian.
-    scratch.ushort  = PLATFORM_ENDIAN16( vl_read(fp, task->cursor) );
-    s_type			= (scratch.ubyte[UPPER] & 0x80);
-    sys_task_setnext(task, (ot_u32)otutils_calc_longtimeout(scratch.ushort));
+    /// The scan sequence ISF ID is the task event.  Fetch its compiled
+    /// schedule, which only touches the ISF if the schedule is stale.
+    /// The cursor is restarted if the schedule has shrunk since last wakeup.
+    /// An empty schedule (ISF missing or zero length) has no scans to do: the
+    /// radio stays asleep and the schedule is checked again after a delay.
+    sched   = sub_scansched_get(task->event);
+    if (sched->length == 0) {
+        task->cursor = 0;
+        sys_task_setnext(task, _SCAN_RETRY);
+        return;
+    }
+    if (task->cursor >= sched->length) {
+        task->cursor = 0;
+    }
+    scan    = &sched->entry[task->cursor >> 2];
 
-    /// Pull channel ID and Scan flags
-    task->cursor   += 2;
-    scratch.ushort  = vl_read(fp, task->cursor);
-    s_channel       = scratch.ubyte[0];
-    s_code          = scratch.ubyte[1];
+    /// Set the next idle event from the precomputed Next Scan field, and pull
+    /// channel ID and Scan flags.
+    s_type      = scan->type;
+    s_channel   = scan->channel;
+    s_code      = scan->code;
+    sys_task_setnext(task, scan->timeout);
 
     /// Advance cursor to next datum, go back to 0 if end of sequence
-    /// (still works in special case where cursor = 254)
-    task->cursor   += 2;
-    task->cursor    = (task->cursor >= fp->length) ? 0 : task->cursor;
-    vl_close(fp);
+    task->cursor   += 4;
+    task->cursor    = (task->cursor >= sched->length) ? 0 : task->cursor;
 
     /// Choosing Background-Scan or Foreground-Scan is based on scan-code.
     /// If b7 is set, do a Background-Scan.  At the session level, the "Flood"
@@ -849,36 +942,35 @@ OT_WEAK void dll_systask_beacon(ot_task task) {
     /// Open BTS ISF Element and read the beacon sequence.  Make sure there is
     /// a beacon file of non-zero length and that beacons are presently enabled.
     if (dll.netconf.dd_flags == 0) {
-        ot_u16  scratch;
-        vlFILE* fp;
+        beaconsched_t*          sched;
+        const beaconentry_t*    beacon;
 
-        fp = ISF_open_su( ISF_ID(beacon_transmit_sequence) );
-        if (fp == NULL) {
-            //nextbeacon = 10;               // try again after this delay
+        /// The compiled beacon schedule is empty if the BTS ISF is missing or
+        /// has zero length: try again after the retry delay.
+        sched = sub_beaconsched_get();
+        if (sched->length == 0) {
             goto dll_systask_beacon_END;
         }
-        if (fp->length == 0)    {
-            vl_close(fp);
-            goto dll_systask_beacon_END;
+        if (task->cursor >= sched->length) {
+            task->cursor = 0;
         }
-
-        // move fp start onto the cursor in order to use vl_load() later on
-        scratch     = fp->start;
-        fp->start  += task->cursor;
+        beacon = &sched->entry[task->cursor >> 3];
 
         /// Beacon List Management:
-        /// <LI> Move cursor onto next beacon period (above, +8)</LI>
+        /// <LI> Move cursor onto next beacon period (+8)</LI>
         /// <LI> Loop cursor if it is past the length of the list </LI>
-        /// <LI> In special case where cursor = 254, everything still works! </LI>
         task->cursor += 8;
-        if (task->cursor >= fp->length) {
+        if (task->cursor >= sched->length) {
         	task->cursor = 0;
         }
 
-        // Load next beacon into btemp, then undo the start hack, then close
-        vl_load(fp, 8, dll.netconf.btemp);
-        fp->start = scratch;
-        vl_close(fp);
+        // Load next beacon into btemp.  Its period is already in ticks.
+        ot_memcpy(dll.netconf.btemp, (ot_u8*)beacon->btemp, 8);
+        nextbeacon = (ot_u16)beacon->timeout;
+    }
+    else {
+        // Bytes[0:1] = next process code
+        nextbeacon = otutils_calc_longtimeout( PLATFORM_ENDIAN16(*(ot_u16*)&dll.netconf.btemp[0]) );
     }
 
     // Bytes[2:3] = Chan ID, Cmd Code
@@ -895,9 +987,6 @@ OT_WEAK void dll_systask_beacon(ot_task task) {
 		//b_session->flags    = dll.netconf.btemp[3] & 0x78;
 
     //}
-
-	// Bytes[0:1] = next process code
-    nextbeacon = otutils_calc_longtimeout( PLATFORM_ENDIAN16(*(ot_u16*)&dll.netconf.btemp[0]) );
     
     dll_systask_beacon_END:
     
@@ -914,6 +1003,97 @@ OT_WEAK void dll_systask_beacon(ot_task task) {
 
 
 
+static scansched_t* sub_scansched_get(ot_u8 isf_id) {
+/// Hold Scan (ISF 4) and Sleep Scan (ISF 5) each get their own slot.
+    scansched_t* sched = &scansched[isf_id & 1];
+
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    if (sched->modcount != vl_get_modcount()) {
+        sched->isf_id = 0;
+    }
+#   endif
+    if (sched->isf_id != isf_id) {
+        vlFILE*     fp;
+        ot_uni16    scratch;
+        ot_int      i;
+
+        ot_memset((ot_u8*)sched, 0, sizeof(scansched_t));
+#       if (OT_FEATURE(VLWATCH) != ENABLED)
+        sched->modcount = vl_get_modcount();
+#       endif
+        fp = ISF_open_su(isf_id);
+        if (fp != NULL) {
+            /// Only whole 4 byte scan entries are used
+            sched->length   = (fp->length > (_SCAN_ENTRIES*4)) ? (_SCAN_ENTRIES*4) : fp->length;
+            sched->length  &= ~3;
+
+            for (i=0; i<sched->length; i+=4) {
+                scanentry_t* scan = &sched->entry[i>>2];
+
+                /// Two-byte Next Scan field: the DASH7 registry is big-endian.
+                scratch.ushort  = PLATFORM_ENDIAN16( vl_read(fp, i) );
+                scan->type      = (scratch.ubyte[UPPER] & 0x80);
+                scan->timeout   = (ot_u32)otutils_calc_longtimeout(scratch.ushort);
+
+                scratch.ushort  = vl_read(fp, i+2);
+                scan->channel   = scratch.ubyte[0];
+                scan->code      = scratch.ubyte[1];
+            }
+            vl_close(fp);
+        }
+        sched->isf_id = isf_id;
+    }
+
+    return sched;
+}
+
+
+#if (M2_FEATURE(BEACONS) == ENABLED)
+static beaconsched_t* sub_beaconsched_get(void) {
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    if (beaconsched.modcount != vl_get_modcount()) {
+        beaconsched.valid = False;
+    }
+#   endif
+    if (beaconsched.valid == False) {
+        vlFILE*     fp;
+        ot_uni16    scratch;
+        ot_int      i, j;
+
+        beaconsched.length = 0;
+        fp = ISF_open_su( ISF_ID(beacon_transmit_sequence) );
+        if (fp != NULL) {
+            /// Only whole 8 byte beacon entries are used
+            beaconsched.length  = (fp->length > (_BEACON_ENTRIES*8)) ? (_BEACON_ENTRIES*8) : fp->length;
+            beaconsched.length &= ~7;
+
+            for (i=0; i<beaconsched.length; i+=8) {
+                beaconentry_t* beacon = &beaconsched.entry[i>>3];
+
+                for (j=0; j<8; j+=2) {
+                    scratch.ushort      = vl_read(fp, i+j);
+                    beacon->btemp[j]    = scratch.ubyte[0];
+                    beacon->btemp[j+1]  = scratch.ubyte[1];
+                }
+
+                // Bytes[0:1] = next process code
+                beacon->timeout = (ot_u32)otutils_calc_longtimeout( PLATFORM_ENDIAN16(*(ot_u16*)&beacon->btemp[0]) );
+            }
+            vl_close(fp);
+        }
+        beaconsched.valid = True;
+#       if (OT_FEATURE(VLWATCH) != ENABLED)
+        beaconsched.modcount = vl_get_modcount();
+#       endif
+    }
+
+    return &beaconsched;
+}
+#endif
+
+
+
+
 
 
 
@@ -1182,13 +1362,11 @@ OT_WEAK void dll_rfevt_frx(ot_int pcode, ot_int fcode) {
         }
     }
 
-    // Multiframe packet RX frame check
-#   if (M2_FEATURE(M2DP) == ENABLED)
+    // Multiframe packet RX frame check: non-final frames are reassembled by
+    // the encoder, and any damage is reported again with the last frame.
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
     else if (pcode > 0) {
         __DEBUG_ERRCODE_EVAL(=112);
-    	if (fcode != 0) {
-    		m2dp_mark_frame();
-    	}
     	return;
     }
 #	endif
@@ -1413,9 +1591,9 @@ OT_WEAK void dll_rfevt_ftx(ot_int pcode, ot_int scratch) {
     m2session* active;
     __DEBUG_ERRCODE_EVAL(=140);
 
-    /// Non-final frame TX'ed in multiframe packet
+    /// Non-final frame TX'ed in multiframe packet.  The encoder frames the
+    /// rest of the packet in place, so there is nothing to do here.
     if (pcode == 1) {
-        ///@todo possibly put the queue rearrangement here
     }
 
     /// Packet TX is done.  Handle this event and pre-empt the kernel.
@@ -29,9 +29,11 @@
 
 #include <m2/encode.h>
 #include <m2/radio.h>
+#include <m2/network.h>
 
 #include <otlib/crc16.h>
 #include <otlib/buffers.h>
+#include <otlib/memcpy.h>
 
 #include <platform/config.h>
 
@@ -114,57 +116,401 @@ ot_u8 em2_check_crc5() {
   * coding enabled can receive and decode a frame using RS coding simply by
   * discarding (or ignoring) the extra block.
   *
-  * RS coding is not presently available in the open-source distribution of
-  * OpenTag.  The functions below are stub functions, effectively, which just
-  * discard the RS code-block as described above.  If you wish to use RS coding
-  * with your OpenTag-based design, a non-open-source module for RS coding is
-  * maintained by Haystack Technologies (www.haystacktechnologies.com).  Or,
-  * you could try implementing it yourself, as the specification is freely
-  * available on wiki.indigresso.com
+  * The codec below is a systematic, shortened RS code over GF(256), using the
+  * primitive polynomial x^8+x^4+x^3+x^2+1 (0x11D) and generator roots a^0 to
+  * a^(npar-1).  The codeword is the whole frame: length byte through CRC16,
+  * followed by the parity block.  Parity is computed by an LFSR as bytes are
+  * encoded, and syndromes are accumulated as bytes are decoded, so the only
+  * work left at the end of a clean frame is a check of the syndromes.  When
+  * errors are present, em2_rs_postprocess() runs Berlekamp-Massey, a Chien
+  * search over the frame, and Forney's algorithm to repair bytes in place.
   */
 #if (M2_FEATURE(RSCODE))
 #   define RS_ENCODE_1BYTE()    if (em2.lctl & 0x40) em2_rs_encode(1)
-#   define RS_DECODE_1BYTE()    if (em2.lctl & 0x40) em2_rs_encode(1)
+#   define RS_ENCODE_NBYTES(N)  if (em2.lctl & 0x40) em2_rs_encode(N)
+#   define RS_DECODE_1BYTE()    if (em2.lctl & 0x40) em2_rs_decode(1)
 #   define RS_DECODE_START()    do { \
                                     if ((em2.crc5 == 0) && (em2.lctl & 0x40)) { \
                                         em2_rs_init_decode(&rxq); \
-                                        em2_rs_encode(2);   \
+                                        em2_rs_decode(2);   \
                                 }   } while (0)
+
+/// GF(256) antilog table.  It is doubled so that the sum of two logs can be
+/// used as an index without a modulo-255 operation.
+static const ot_u8 rs_exp[510] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E
+};
+
+/// GF(256) log table.  rs_log[0] is undefined and must not be used.
+static const ot_u8 rs_log[256] = {
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+
+
+static ot_u8 sub_rs_mul(ot_u8 a, ot_u8 b) {
+    if ((a == 0) || (b == 0)) {
+        return 0;
+    }
+    return rs_exp[rs_log[a] + rs_log[b]];
+}
+
+static ot_u8 sub_rs_div(ot_u8 a, ot_u8 b) {
+    if (a == 0) {
+        return 0;
+    }
+    return rs_exp[rs_log[a] + 255 - rs_log[b]];
+}
+
+static ot_u8 sub_rs_eval(ot_u8* poly, ot_int degree, ot_u8 log_x) {
+/// Evaluate poly[0] + poly[1]x + ... + poly[degree]x^degree at x = a^log_x
+    ot_u8 y = 0;
+    while (degree >= 0) {
+        y = sub_rs_mul(y, rs_exp[log_x]) ^ poly[degree--];
+    }
+    return y;
+}
+
 #else
 #   define RS_ENCODE_1BYTE();
+#   define RS_ENCODE_NBYTES(N);
 #   define RS_DECODE_1BYTE();
 #   define RS_DECODE_START();
 
 #endif
 
+
+
+#ifndef EXTF_em2_rs_paritylength
+OT_WEAK ot_int em2_rs_paritylength(ot_int msg_length) {
+    return 4 + (((msg_length + 13) / 18) << 1);
+}
+#endif
+
+
+#if (M2_FEATURE(RSCODE))
+
 #ifndef EXTF_em2_rs_init_decode
 OT_WEAK ot_int em2_rs_init_decode(ot_queue* q) {
-    ///@todo see if this should return the number of parity bytes rather than -1
-    // npar = 4 + (( (q->front[0]+1) + 13) / 18) * 2;
-    return -1;
+    ot_int npar;
+
+    em2.rs_length   = (ot_int)q->front[0] + 1;
+    npar            = em2_rs_paritylength(em2.rs_length);
+    em2.rs_front    = q->front;
+    em2.rs_cursor   = q->front;
+    em2.rs_npar     = npar;
+    em2.rs_count    = em2.rs_length;
+
+    /// A frame that cannot be a valid codeword is not decoded, but its parity
+    /// length is still returned so the caller can strip it.
+    if ((em2.rs_length > 255) || (em2.rs_length < (npar+4))) {
+        em2.rs_count = -1;
+    }
+
+    memset(em2.rs_reg, 0, npar);
+    return npar;
 }
 #endif
 
+
 #ifndef EXTF_em2_rs_decode
 OT_WEAK void em2_rs_decode(ot_int n_bytes) {
+/// Horner update of each syndrome: S[j] = S[j]*a^j + r
+    ot_int npar = em2.rs_npar;
+
+    if (n_bytes > em2.rs_count) {
+        n_bytes = em2.rs_count;
+    }
+    em2.rs_count -= (n_bytes > 0) ? n_bytes : 0;
+
+    while (n_bytes-- > 0) {
+        ot_u8   r;
+        ot_u8*  s;
+        ot_int  j;
+        r = *em2.rs_cursor++;
+        s = em2.rs_reg;
+        for (j=0; j<npar; j++, s++) {
+            *s = r ^ ((*s != 0) ? rs_exp[rs_log[*s] + j] : 0);
+        }
+    }
 }
 #endif
 
+
 #ifndef EXTF_em2_rs_check
 OT_WEAK ot_int em2_rs_check(void) {
-    return -1;
+    ot_int j;
+    ot_int nonzero;
+
+    if (em2.rs_count < 0) {
+        return -1;
+    }
+
+    /// Pick up any bytes that the streaming decoder did not feed in (e.g. the
+    /// bytes flushed at the end of the FEC trellis).
+    em2_rs_decode(em2.rs_count);
+
+    nonzero = 0;
+    for (j=0; j<em2.rs_npar; j++) {
+        nonzero += (em2.rs_reg[j] != 0);
+    }
+    return nonzero;
 }
 #endif
 
+
 #ifndef EXTF_em2_rs_postprocess
 OT_WEAK ot_int em2_rs_postprocess(void) {
-    return 0;
+    ot_u8   lambda[M2_RS_NPARMAX+1];
+    ot_u8   prev[M2_RS_NPARMAX+1];
+    ot_u8   omega[M2_RS_NPARMAX];
+    ot_u8*  syn;
+    ot_int  npar, L, m, r, i;
+    ot_int  found;
+    ot_u8   b;
+
+    r = em2_rs_check();
+    if (r <= 0) {
+        return r;
+    }
+    em2.rs_count    = -1;           // frame is consumed by this call
+    syn             = em2.rs_reg;
+    npar            = em2.rs_npar;
+
+    /// 1. Berlekamp-Massey: find error locator lambda(x) from syndromes
+    memset(lambda, 0, sizeof(lambda));
+    memset(prev, 0, sizeof(prev));
+    lambda[0]   = 1;
+    prev[0]     = 1;
+    L           = 0;
+    m           = 1;
+    b           = 1;
+
+    for (r=0; r<npar; r++) {
+        ot_u8 d = syn[r];
+        for (i=1; i<=L; i++) {
+            d ^= sub_rs_mul(lambda[i], syn[r-i]);
+        }
+
+        if (d == 0) {
+            m++;
+        }
+        else {
+            ot_u8 temp[M2_RS_NPARMAX+1];
+            ot_u8 coef = sub_rs_div(d, b);
+
+            memcpy(temp, lambda, sizeof(temp));
+            for (i=m; i<=npar; i++) {
+                lambda[i] ^= sub_rs_mul(coef, prev[i-m]);
+            }
+            if ((L << 1) <= r) {
+                L = r + 1 - L;
+                memcpy(prev, temp, sizeof(prev));
+                b = d;
+                m = 1;
+            }
+            else {
+                m++;
+            }
+        }
+    }
+    if ((L << 1) > npar) {
+        return -1;
+    }
+
+    /// 2. omega(x) = S(x)*lambda(x) mod x^npar, the error evaluator
+    for (r=0; r<npar; r++) {
+        omega[r] = 0;
+        for (i=0; (i<=r) && (i<=L); i++) {
+            omega[r] ^= sub_rs_mul(lambda[i], syn[r-i]);
+        }
+    }
+
+    /// 3. Chien search over the bytes of the frame.  Byte i is the term of
+    ///    degree p = length-1-i, so its locator is X = a^p.  Each root of
+    ///    lambda(1/X) is corrected using Forney (first root a^0):
+    ///    e = X * omega(1/X) / lambda'(1/X)
+    found = 0;
+    for (i=0; i<em2.rs_length; i++) {
+        ot_u8 log_xinv;
+        ot_u8 p = (ot_u8)(em2.rs_length - 1 - i);
+
+        log_xinv = (p == 0) ? 0 : (ot_u8)(255 - p);
+        if (sub_rs_eval(lambda, L, log_xinv) == 0) {
+            ot_u8 num, den;
+            ot_int k;
+
+            // lambda'(x): in GF(2^m), only the odd-power terms survive
+            den = 0;
+            for (k=L-((L&1)==0); k>0; k-=2) {
+                den = sub_rs_mul(den, rs_exp[(log_xinv << 1) % 255]) ^ lambda[k];
+            }
+            num = sub_rs_eval(omega, npar-1, log_xinv);
+            if (den == 0) {
+                return -1;
+            }
+            em2.rs_front[i] ^= sub_rs_mul(rs_exp[p], sub_rs_div(num, den));
+            found++;
+        }
+    }
+
+    /// 4. All roots of lambda must be inside the (shortened) codeword
+    return (found == L) ? found : -1;
 }
 #endif
 
-#ifndef EXTF_em2_rs_paritylength
-OT_WEAK ot_int em2_rs_paritylength(ot_int msg_length) {
-    return 4 + (((msg_length + 13) / 18) << 1);
+
+#ifndef EXTF_em2_rs_init_encode
+OT_WEAK ot_int em2_rs_init_encode(ot_queue* q) {
+    ot_u8   g[M2_RS_NPARMAX+1];
+    ot_int  length;
+    ot_int  npar;
+    ot_int  i, j;
+
+    /// The parity length depends on the total frame length, which includes
+    /// the parity.  paritylength() grows slower than its input, so iterating
+    /// from below converges on the smallest consistent value.
+    length  = (ot_int)q->front[0] + 1;
+    npar    = em2_rs_paritylength(length);
+    while ((i = em2_rs_paritylength(length + npar)) != npar) {
+        npar = i;
+    }
+
+    /// Frames that do not fit in one codeword go out without RS coding
+    if ((length + npar) > 255) {
+        q->front[1] &= ~0x40;
+        em2.lctl    &= ~0x40;
+        return 0;
+    }
+
+    /// g(x) = (x + a^0)(x + a^1)...(x + a^(npar-1)), g[j] is term x^j.  It
+    /// is stored to rs_gen in log form, high-order term first.
+    memset(g, 0, sizeof(g));
+    g[0] = 1;
+    for (i=0; i<npar; i++) {
+        for (j=i+1; j>0; j--) {
+            g[j] = g[j-1] ^ sub_rs_mul(g[j], rs_exp[i]);
+        }
+        g[0] = sub_rs_mul(g[0], rs_exp[i]);
+    }
+    for (i=0; i<npar; i++) {
+        ot_u8 coef      = g[npar-1-i];
+        em2.rs_gen[i]   = (coef == 0) ? 255 : rs_log[coef];
+    }
+
+    memset(em2.rs_reg, 0, npar);
+    em2.rs_front    = q->front;
+    em2.rs_cursor   = q->front;
+    em2.rs_length   = length + npar;
+    em2.rs_npar     = npar;
+    em2.rs_count    = length;
+
+    return npar;
+}
+#endif
+
+
+#ifndef EXTF_em2_rs_encode
+OT_WEAK void em2_rs_encode(ot_int n_bytes) {
+    ot_int npar = em2.rs_npar;
+
+    if (em2.rs_count <= 0) {
+        return;
+    }
+    if (n_bytes > em2.rs_count) {
+        n_bytes = em2.rs_count;
+    }
+    em2.rs_count -= n_bytes;
+
+    while (n_bytes-- > 0) {
+        ot_u8   fb;
+        ot_int  i;
+
+        fb = *em2.rs_cursor++ ^ em2.rs_reg[0];
+        for (i=0; i<npar; i++) {
+            ot_u8 term = 0;
+            if ((fb != 0) && (em2.rs_gen[i] != 255)) {
+                term = rs_exp[em2.rs_gen[i] + rs_log[fb]];
+            }
+            em2.rs_reg[i] = term ^ ((i < (npar-1)) ? em2.rs_reg[i+1] : 0);
+        }
+    }
+
+    /// Parity is complete when the last message byte goes through.  It is put
+    /// into the frame right behind the CRC, before it is read for TX.
+    if (em2.rs_count == 0) {
+        memcpy(em2.rs_cursor, em2.rs_reg, npar);
+    }
+}
+#endif
+
+#else
+/// Without RS support, RS coded frames are received by ignoring the parity
+#ifndef EXTF_em2_rs_init_decode
+OT_WEAK ot_int em2_rs_init_decode(ot_queue* q) {
+    return em2_rs_paritylength((ot_int)q->front[0] + 1);
+}
+#endif
+
+#ifndef EXTF_em2_rs_decode
+OT_WEAK void em2_rs_decode(ot_int n_bytes) {
+}
+#endif
+
+#ifndef EXTF_em2_rs_check
+OT_WEAK ot_int em2_rs_check(void) {
+    return -1;
+}
+#endif
+
+#ifndef EXTF_em2_rs_postprocess
+OT_WEAK ot_int em2_rs_postprocess(void) {
+    return -1;
 }
 #endif
 
@@ -179,6 +525,8 @@ OT_WEAK void em2_rs_encode(ot_int n_bytes) {
 }
 #endif
 
+#endif
+
 #ifndef EXTF_em2_rs_interleave
 OT_WEAK void em2_rs_interleave(ot_u8* start, ot_int numbytes) {
     while (numbytes < 0) {
@@ -216,11 +564,13 @@ OT_WEAK void em2_rs_interleave(ot_u8* start, ot_int numbytes) {
 
 #   if !defined(EXTF_em2_encode_data_HW)
     OT_WEAK void em2_encode_data_HW() {
-        while ( (em2.bytes > 0) && radio_txopen() ) {
-            em2.bytes--;
-            RS_ENCODE_1BYTE();
-            radio_putbyte( q_readbyte(&txq) );
-        }
+    /// RS parity is calculated ahead of the radio buffer, over all remaining
+    /// data, so it is ready by the time the parity bytes are loaded.
+        ot_int fill;
+        RS_ENCODE_NBYTES(em2.bytes);
+        fill            = radio_putburst(txq.getcursor, em2.bytes);
+        txq.getcursor  += fill;
+        em2.bytes      -= fill;
     }
 #   endif
 
@@ -257,12 +607,13 @@ OT_WEAK void em2_rs_interleave(ot_u8* start, ot_int numbytes) {
 
 #   if !defined(EXTF_em2_encode_data_HWCRC)
     OT_WEAK void em2_encode_data_HWCRC() {
-        while ( (em2.bytes > 0) && radio_txopen() ) {
-            crc_calc_stream(&em2.crc);
-            RS_ENCODE_1BYTE();
-            radio_putbyte( q_readbyte(&txq) );
-            em2.bytes--;
-        }
+    /// CRC and RS parity are calculated ahead of the radio buffer, as above
+        ot_int fill;
+        crc_calc_nstream(&em2.crc, em2.bytes);
+        RS_ENCODE_NBYTES(em2.bytes);
+        fill            = radio_putburst(txq.getcursor, em2.bytes);
+        txq.getcursor  += fill;
+        em2.bytes      -= fill;
     }
 #   endif
 
@@ -674,6 +1025,169 @@ void OT_WEAK em2_decode_data_FEC() {
 
 
 
+/** Multiframe Packet (MFP) Framing <BR>
+  * ========================================================================<BR>
+  * A packet that does not fit in one frame is sent as a burst of frames.  The
+  * first frame carries the normal M2NP header.  Each continuation frame has a
+  * short header: length, link control, TX EIRP, subnet, frame info (with
+  * stream addressing) and dialog ID.  Every frame carries its own CRC16, and
+  * RS parity if used.  Link control bit 7 (FRCONT) is set on every frame
+  * except the last one.
+  *
+  * TX framing is done in place in txq:
+  * <LI> CRC and parity of a non-final frame overwrite the payload that
+  *      follows the cut.  Those bytes are stashed and put back once the frame
+  *      has been encoded. </LI>
+  * <LI> Each continuation header is written over the tail of the frame before
+  *      it, which has already gone to the radio. </LI>
+  * <LI> A resend puts back the last header area and re-encodes the packet. </LI>
+  *
+  * RX reassembly is also done in place in rxq.  Each continuation frame is
+  * received right behind the payload of the previous frame.  Once its CRC is
+  * stripped, its payload is pulled down over its own header.  After the last
+  * frame, rxq spans the whole packet and rxq.back marks the end of the
+  * payload.  A damaged frame makes the whole packet report as damaged.
+  */
+#if (M2_FEATURE(MULTIFRAME) == ENABLED)
+
+static void sub_mfp_cutframe(void) {
+    ot_int span;
+    ot_int limit;
+
+    /// Continuation frame: the previous frame is fully encoded, so the bytes
+    /// it borrowed are restored and the new header goes over its tail.
+    if (em2.mfp_frames != 0) {
+        ot_u8* hdr;
+
+        if (em2.mfp_hdrpos != NULL) {
+            memcpy(em2.mfp_hdrpos, em2.mfp_save, M2_MFP_HDRBYTES);
+        }
+        memcpy(em2.mfp_cursor, em2.mfp_stash, em2.mfp_stashlen);
+
+        hdr             = em2.mfp_cursor - M2_MFP_HDRBYTES;
+        em2.mfp_hdrpos  = hdr;
+        memcpy(em2.mfp_save, hdr, M2_MFP_HDRBYTES);
+        hdr[1]          = em2.mfp_hdr[0];
+        hdr[2]          = 0;                // TX EIRP is written by the driver
+        hdr[3]          = em2.mfp_hdr[1];
+        hdr[4]          = em2.mfp_hdr[2];
+        hdr[5]          = em2.mfp_hdr[3];
+
+        txq.front       = hdr;
+        txq.getcursor   = hdr;
+        txq.putcursor   = em2.mfp_end;
+    }
+
+    /// First frame: save the fields that continuation headers repeat
+    else {
+        em2.mfp_hdr[0]  = txq.front[1] & M2LC_RSCODE;
+        em2.mfp_hdr[1]  = txq.front[3];
+        em2.mfp_hdr[2]  = (txq.front[4] & M2FI_LISTEN) | M2FI_STREAM;
+        em2.mfp_hdr[3]  = txq.front[5 + ((txq.front[4] & M2FI_EXT) != 0)];
+    }
+    em2.mfp_frames++;
+
+    /// Cut the frame so that it fits in M2_PARAM(MAXFRAME) together with the
+    /// CRC and the largest parity block it could get.
+    limit = M2_PARAM(MAXFRAME) - 2;
+#   if (M2_FEATURE(RSCODE))
+    if (txq.front[1] & M2LC_RSCODE) {
+        limit -= em2_rs_paritylength(M2_PARAM(MAXFRAME));
+    }
+#   endif
+
+    span = (ot_int)(em2.mfp_end - txq.front);
+    if (span > limit) {
+        ot_int rest         = span - limit;
+        em2.mfp_stashlen    = (rest > (ot_int)sizeof(em2.mfp_stash)) ? \
+                                (ot_int)sizeof(em2.mfp_stash) : rest;
+        em2.mfp_cursor      = txq.front + limit;
+        memcpy(em2.mfp_stash, em2.mfp_cursor, em2.mfp_stashlen);
+        txq.putcursor       = em2.mfp_cursor;
+        txq.front[1]       |= M2LC_FRCONT;
+        span                = limit;
+    }
+    else {
+        txq.front[1]       &= ~M2LC_FRCONT;
+    }
+    txq.front[0] = (ot_u8)(span - 1);
+}
+
+
+static void sub_mfp_txinit(void) {
+    /// Resend of a multiframe packet: the CRC is not re-streamed on resend,
+    /// but MFP framing is done in place, so the packet is restored and then
+    /// fully re-encoded.
+    if ((txq.options.ubyte[UPPER] == 0) && (em2.mfp_frames > 1)) {
+        memcpy(em2.mfp_hdrpos, em2.mfp_save, M2_MFP_HDRBYTES);
+        txq.front                   = em2.mfp_front;
+        txq.getcursor               = em2.mfp_front;
+        txq.putcursor               = em2.mfp_end;
+        txq.options.ubyte[UPPER]    = 1;
+    }
+    em2.mfp_front   = txq.front;
+    em2.mfp_end     = txq.putcursor;
+    em2.mfp_hdrpos  = NULL;
+    em2.mfp_frames  = 0;
+}
+
+
+static void sub_mfp_copydown(ot_u8* dst, ot_u8* src, ot_int length) {
+/// Overlapping copy to a lower address, which memcpy() does not guarantee
+    while (length-- > 0) {
+        *dst++ = *src++;
+    }
+}
+
+
+static ot_u16 sub_mfp_joinframe(ot_u16 crc_invalid) {
+    ot_u8* join;
+
+    /// First frame: its payload stays where it is
+    if (em2.mfp_cursor == NULL) {
+        join            = rxq.front + rxq.front[0];
+        em2.mfp_front   = rxq.front;
+        em2.mfp_damage  = crc_invalid;
+        em2.mfp_hdr[3]  = rxq.front[5 + ((rxq.front[4] & M2FI_EXT) != 0)];
+    }
+
+    /// Continuation frame: check the short header, then pull the payload
+    /// down over it.
+    else {
+        ot_int paylen   = (ot_int)rxq.front[0] - M2_MFP_HDRBYTES;
+        join            = em2.mfp_cursor;
+
+        if ((paylen < 0) \
+        || ((rxq.front[4] & M2FI_ADDRMASK) != M2FI_STREAM) \
+        || (rxq.front[5] != em2.mfp_hdr[3])) {
+            crc_invalid = 1;
+            paylen      = 0;
+        }
+        em2.mfp_damage |= crc_invalid;
+        sub_mfp_copydown(join, join + M2_MFP_HDRBYTES, paylen);
+        join += paylen;
+    }
+
+    /// More frames: the next one is received right behind this payload
+    if (em2.lctl & M2LC_FRCONT) {
+        em2.mfp_cursor = join;
+        return crc_invalid;
+    }
+
+    /// Last frame: rxq now spans the whole packet
+    rxq.front       = em2.mfp_front;
+    rxq.getcursor   = em2.mfp_front;
+    rxq.putcursor   = join;
+    rxq.back        = join;
+    em2.mfp_cursor  = NULL;
+    return em2.mfp_damage;
+}
+
+#endif
+
+
+
+
 #if ((RF_FEATURE(FEC) == ENABLED) || (RF_FEATURE(PN9) == ENABLED))
 #   define SET_ENCODER_HW()         (em2_encode_data = &em2_encode_data_HW)
 #   define SET_DECODER_HW()         (em2_decode_data = &em2_decode_data_HW)
@@ -742,6 +1256,10 @@ OT_WEAK void em2_encode_newpacket() {
     em2_encode_data = m2_encoder[(txq.options.ubyte[LOWER] != 0)];
 
 #endif
+
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    sub_mfp_txinit();
+#   endif
 }
 #endif
 
@@ -775,6 +1293,11 @@ OT_WEAK void em2_decode_newpacket() {
     em2_decode_data = m2_decoder[(txq.options.ubyte[LOWER] != 0)];
 
 #endif
+
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    em2.mfp_frames  = 0;
+    em2.mfp_cursor  = NULL;
+#   endif
 }
 #endif
 
@@ -784,6 +1307,14 @@ OT_WEAK void em2_decode_newpacket() {
 #if !defined(EXTF_em2_encode_newframe)
 OT_WEAK void em2_encode_newframe() {
 
+    ///0. Multiframe packets are cut into frames here, before the frame length
+    ///   is used for anything.  On a resend, framing is already done.
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    if (txq.options.ubyte[UPPER] != 0) {
+        sub_mfp_cutframe();
+    }
+#   endif
+
     ///1. CRC management variants:
     /// <LI> software CRC5 and software CRC16 </LI>
     /// <LI> software CRC5 and hardware CRC16 </LI>
@@ -791,21 +1322,19 @@ OT_WEAK void em2_encode_newframe() {
     /// <LI> hardware CRC5 and hardware CRC16 </LI>
 #   if ((RF_FEATURE(CRC16) | RF_FEATURE(CRC)) != ENABLED)
     if (txq.options.ubyte[UPPER] != 0) {
-#       if (RF_FEATURE(CRC5) != ENABLED)
-        em2_add_crc5();
-#       endif
-#       if ((RF_FEATURE(CRC16) | RF_FEATURE(CRC)) != ENABLED)
         crc_init_stream(&em2.crc, True, q_span(&txq), txq.getcursor);
-        txq.putcursor += 2;
-#       endif
+        txq.putcursor  += 2;
+        txq.front[0]   += 2;
     }
 #   endif
 
     /// 2. Handle RS Coding and other link control flags, and initialize
-    ///    RS Encoder if it is supported.  Otherwise, kill the flag
+    ///    RS Encoder if it is supported.  Otherwise, kill the flag.  The RS
+    ///    parity length depends on the frame length, so the CRC must already
+    ///    be counted in it.
 #   if (M2_FEATURE(RSCODE))
     em2.lctl = txq.front[1];
-    if (em2.lctl & 0x40) {
+    if ((em2.lctl & 0x40) && (txq.options.ubyte[UPPER] != 0)) {
         ot_int parity_bytes;
         parity_bytes    = em2_rs_init_encode(&txq);
         txq.front[0]   += parity_bytes;
@@ -816,10 +1345,18 @@ OT_WEAK void em2_encode_newframe() {
     txq.front[1]    = em2.lctl;
 #   endif
 
-    /// 3. Set encoder total bytes now that all are in the queue
+    /// 3. CRC5 protects the length byte and link control bits, so it can
+    ///    only be applied once these are settled.
+#   if (RF_FEATURE(CRC5) != ENABLED)
+    if (txq.options.ubyte[UPPER] != 0) {
+        em2_add_crc5();
+    }
+#   endif
+
+    /// 4. Set encoder total bytes now that all are in the queue
     em2.bytes = q_span(&txq);
 
-    /// 4. Prepare frame encoder, depending on frame type and supported methods.
+    /// 5. Prepare frame encoder, depending on frame type and supported methods.
     ///    (0) HW Encoder: do nothing.
     ///    (1) SW PN9 Encoder: init PN9 LFSR -- also used in FEC.
     ///    (2) SW FEC Encoder: init FEC state machine and data.
@@ -853,6 +1390,21 @@ OT_WEAK void em2_decode_newframe() {
     em2.state   = 1;
     em2.bytes   = 8;      // dummy length until actual length is received
 
+    /// A continuation frame of a multiframe packet is received right behind
+    /// the payload of the frame before it.
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    if (em2.mfp_cursor != NULL) {
+        rxq.front       = em2.mfp_cursor;
+        rxq.getcursor   = em2.mfp_cursor;
+        rxq.putcursor   = em2.mfp_cursor;
+    }
+#   endif
+
+    /// RS decoding stays off until the frame header is received
+#   if (M2_FEATURE(RSCODE))
+    em2.lctl    = 0;
+#   endif
+
     /// Prepare SW FEC Decoders, and if necessary PN9 decoder
 #   if ((M2_FEATURE(FECRX) == ENABLED) && (RF_FEATURE(FEC) != ENABLED))
         if (rxq.options.ubyte[LOWER]) {
@@ -923,7 +1475,13 @@ OT_WEAK ot_u16 em2_decode_endframe() {
     ///   (RS and CRC are actually both types of block codes)
     rxq.front[0] = (ot_u8)framebytes;
 
-    ///5. If CRC is still invalid, report the packet is uncorrectably broken
+    ///5. Multiframe packets are reassembled in rxq as frames come in.  On the
+    ///   last frame, the result covers all frames of the packet.
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    crc_invalid = sub_mfp_joinframe(crc_invalid);
+#   endif
+
+    ///6. If CRC is still invalid, report the packet is uncorrectably broken
     return crc_invalid;
 }
 #endif
@@ -39,6 +39,7 @@
 
 #include <otlib/auth.h>
 #include <otlib/buffers.h>
+#include <otlib/memcpy.h>
 #include <otlib/utils.h>
 #include <otsys/veelite.h>
 
@@ -205,21 +206,32 @@ ot_int network_route_ff(m2session* active) {
     
     /// Data Link Layer Security: Decryption
     /// @note Still Experimental
-    /// @todo make sure auth_decrypt() strips the Authentication bytes (4) and 
-    ///       includes in return value.
     ///
     /// Do the decryption using the key selected above, and return error if the
     /// result is not authenticated properly or has any other sort of framing
-    /// problem.  Decryption returns a value used to reframe the plain-data.
+    /// problem.  The nonce, payload and tag are decrypted in place in rxq, and
+    /// decryption returns the tag length, used to reframe the plain-data.
     if (m2np.header.fr_info & M2FI_DLLS) {
 #   if (OT_FEATURE(DLL_SECURITY))
-        ot_u8*  nonce;
-        ot_int  lendiff;
-        ot_uint datalen;
-        nonce           = rxq.getcursor - 1;
+        authseg_t   nonce;
+        authseg_t   payload;
+        authseg_t   tag;
+        ot_int      lendiff;
+        
+        nonce.base      = rxq.front;
+        nonce.offset    = (ot_uint)(rxq.getcursor - rxq.front) - 1;
+        nonce.length    = 7;
         rxq.getcursor  += 6;
-        datalen         = rxq.back - rxq.getcursor;
-        lendiff         = auth_decrypt(nonce, rxq.getcursor, datalen, dlls_key_index, 0); 
+        if ((rxq.back - rxq.getcursor) < 4) {
+            return -1;
+        }
+        payload.base    = rxq.front;
+        payload.offset  = (ot_uint)(rxq.getcursor - rxq.front);
+        payload.length  = (ot_uint)(rxq.back - rxq.getcursor) - 4;
+        tag.base        = rxq.front;
+        tag.offset      = payload.offset + payload.length;
+        tag.length      = 4;
+        lendiff         = auth_decrypt_sg(&nonce, NULL, &payload, 1, &tag, dlls_key_index);
         if (lendiff < 0) {
             return -1;
         }
@@ -459,33 +471,142 @@ void m2np_put_deviceid(ot_bool use_vid) {
 
 
 ot_bool m2np_idcmp(ot_int length, ot_u8* id) {
-    ot_u8* stored_id;
-    ot_u8  check;
+/// The stored IDs are halfword aligned in dll.netconf, so the comparison can
+/// be done a halfword at a time, exiting on the first mismatch.
+    ot_u16*  stored_id;
+    ot_uni16 test;
     
     // Don't match on vid == 0, that is reserved as unassigned value
     if ((length == 2) && (*(ot_u16*)dll.netconf.vid == 0)) {
         return False;
     }
     
+    stored_id = (ot_u16*)((length == 8) ? dll.netconf.uid : dll.netconf.vid);
+    
+    for (; length>0; length-=2, id+=2) {
+        test.ubyte[0] = id[0];
+        test.ubyte[1] = id[1];
+        if (test.ushort != *stored_id++) {
+            return False;
+        }
+    }
+    
+    return True;
+}
+
+
+
+ot_bool m2np_idlist_search(ot_int length, ot_int count, ot_u8* list) {
+    ot_u8*      stored_id;
+    ot_u16      tail;
+    ot_uni16    test;
+    
+    if ((length == 2) && (*(ot_u16*)dll.netconf.vid == 0)) {
+        return False;
+    }
+
+    /// Prefilter on the last halfword of the ID, then do the full compare.
     stored_id   = (length == 8) ? dll.netconf.uid : dll.netconf.vid;
-    length      = 8 - length;
-    check       = 0;
-    
-    switch (length & 7) {
-        case 0: check |= *stored_id++ ^ *id++; 
-        case 1: check |= *stored_id++ ^ *id++; 
-        case 2: check |= *stored_id++ ^ *id++; 
-        case 3: check |= *stored_id++ ^ *id++; 
-        case 4: check |= *stored_id++ ^ *id++; 
-        case 5: check |= *stored_id++ ^ *id++; 
-        case 6: check |= *stored_id++ ^ *id++; 
-        case 7: check |= *stored_id ^ *id;
-                break;
+    tail        = *(ot_u16*)&stored_id[length-2];
+    
+    for (; count>0; count--, list+=length) {
+        test.ubyte[0] = list[length-2];
+        test.ubyte[1] = list[length-1];
+        if (test.ushort == tail) {
+            if ((length == 2) || m2np_idcmp(length, list)) {
+                return True;
+            }
+        }
+    }
+    
+    return False;
+}
+
+
+
+#if (M2_FEATURE(ACKBLOOM))
+static void sub_ackbloom_hash(ot_u16* h1, ot_u16* h2, ot_int length, ot_u8 seed, ot_u8* id) {
+/// Two 16 bit multiplicative hashes of the seed and ID.  The K filter bits are
+/// taken by double-hashing: bit[i] = h1 + i*h2.  h2 is forced odd so that the
+/// bits are distinct in any power-of-two filter.
+    ot_u16 a = 0x811C ^ seed;
+    ot_u16 b = 0x3A5F ^ ((ot_u16)seed << 8);
+    
+    while (--length >= 0) {
+        a = (ot_u16)((a ^ *id) * 0x9E37);
+        b = (ot_u16)((b ^ *id) * 0x6A09);
+        b = (ot_u16)((b << 3) | (b >> 13));
+        id++;
+    }
+    *h1 = a ^ (a >> 8);
+    *h2 = b | 1;
+}
+
+
+ot_bool m2np_ackbloom_test(ot_int length, ot_int filter_bytes, ot_u8 seed, ot_u8* filter) {
+    ot_u16  h1, h2;
+    ot_u16  mask;
+    ot_int  i;
+    
+    if ((length == 2) && (*(ot_u16*)dll.netconf.vid == 0)) {
+        return False;
+    }
+
+    /// A malformed filter never matches, so the device will still respond.
+    if ((filter_bytes <= 0) \
+    || (filter_bytes > M2_ACKBLOOM_MAXBYTES) \
+    || ((filter_bytes & (filter_bytes-1)) != 0)) {
+        return False;
     }
     
-    return (ot_bool)(check == 0);
+    sub_ackbloom_hash(&h1, &h2, length, seed, 
+                        (length == 8) ? dll.netconf.uid : dll.netconf.vid);
+    mask = (ot_u16)(filter_bytes << 3) - 1;
+    
+    for (i=0; i<M2_ACKBLOOM_K; i++, h1+=h2) {
+        ot_u16 bit = h1 & mask;
+        if ((filter[bit>>3] & (1 << (bit&7))) == 0) {
+            return False;
+        }
+    }
+    
+    return True;
+}
+
+
+ot_int m2np_put_ackbloom(ot_int length, ot_int count, ot_u8* list, ot_int filter_bytes, ot_u8 seed) {
+    ot_u8*  filter;
+    ot_u16  mask;
+
+    if ((filter_bytes <= 0) \
+    || (filter_bytes > M2_ACKBLOOM_MAXBYTES) \
+    || ((filter_bytes & (filter_bytes-1)) != 0) \
+    || ((txq.back - txq.putcursor) < (filter_bytes+3))) {
+        return 0;
+    }
+    
+    q_writebyte(&txq, M2_ACKLIST_BLOOM);
+    q_writebyte(&txq, (ot_u8)filter_bytes);
+    q_writebyte(&txq, seed);
+    filter  = q_markbyte(&txq, filter_bytes);
+    mask    = (ot_u16)(filter_bytes << 3) - 1;
+    ot_memset(filter, 0, filter_bytes);
+    
+    for (; count>0; count--, list+=length) {
+        ot_u16 h1, h2;
+        ot_int i;
+        sub_ackbloom_hash(&h1, &h2, length, seed, list);
+        
+        for (i=0; i<M2_ACKBLOOM_K; i++, h1+=h2) {
+            ot_u16 bit  = h1 & mask;
+            filter[bit>>3] |= (1 << (bit&7));
+        }
+    }
+    
+    return filter_bytes + 3;
 }
 #endif
+#endif
 
 
 
@@ -502,11 +623,24 @@ OT_WEAK void m2np_footer() {
     /// <LI> Or the key activated by authentication API </LI>
 #   if (OT_FEATURE(DLL_SECURITY))
     if (txq.getcursor[4] & M2FI_DLLS) {
-        ot_u8*  nonce   = txq.getcursor + 5;
-        ot_u8*  data    = txq.getcursor + 5 + 7;
-        ot_uint datalen = txq.putcursor - data;
-        ot_int  lendiff = auth_encrypt(nonce, data, datalen, 0, 0);     // using key_index=0 and options=0
-        txq.putcursor  += lendiff;
+        authseg_t   nonce;
+        authseg_t   payload;
+        authseg_t   tag;
+        ot_int      lendiff;
+        
+        nonce.base      = txq.front;
+        nonce.offset    = (ot_uint)(txq.getcursor - txq.front) + 5;
+        nonce.length    = 7;
+        payload.base    = txq.front;
+        payload.offset  = nonce.offset + 7;
+        payload.length  = (ot_uint)(txq.putcursor - txq.front) - payload.offset;
+        tag.base        = txq.front;
+        tag.offset      = payload.offset + payload.length;
+        tag.length      = 4;
+        lendiff         = auth_encrypt_sg(&nonce, NULL, &payload, 1, &tag, 0);    // using key_index=0
+        if (lendiff > 0) {
+            txq.putcursor += lendiff;
+        }
     }
 #   endif    
 #   if (OT_FEATURE(NL_SECURITY))
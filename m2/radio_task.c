@@ -31,6 +31,7 @@
 #if OT_FEATURE(M2)
 #include <m2/radio.h>
 #include <m2/dll.h>
+#include <m2/encode.h>
 
 #include <otlib/buffers.h>
 #include <otsys/veelite.h>
@@ -150,6 +151,99 @@ static const ot_u8 tgd_ti[16] = {
 
 
 
+/** Compiled Channel Table   <BR>
+  * ========================================================================<BR>
+  * The channel_configuration ISF is decoded once into RAM, so that channel
+  * changes during CSMA and scans are a table lookup rather than a file walk.
+  * chantable.index[] maps each 6 bit spectrum ID to the channel entry that
+  * the linear search of the file would have matched (or 0xFF for none).  The
+  * table is rebuilt lazily on the next lookup after it is invalidated, which
+  * happens through a veelite action when the file is written, or through
+  * rm2_channel_refresh().  Without VLWATCH there are no veelite actions, so
+  * the table is also stale after any filesystem change (vl_get_modcount()).
+  */
+#define _CHANTABLE_ENTRIES      (ISF_MAX(channel_configuration)/6)
+#define _CHANTABLE_NONE         0xFF
+
+typedef struct {
+    ot_u8   tx_eirp;
+    ot_u8   link_qual;
+    ot_u8   cs_thr;
+    ot_u8   cca_thr;
+} chanentry_t;
+
+typedef struct {
+    ot_bool     valid;
+    ot_u8       flags;
+    ot_u8       index[64];
+    chanentry_t entry[_CHANTABLE_ENTRIES];
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    ot_u32      modcount;
+#   endif
+} chantable_t;
+
+static chantable_t chantable;
+
+
+static ot_int sub_chantable_invalidate(void* event) {
+    chantable.valid = False;
+    radio.flags    |= RADIO_FLAG_REFRESH;
+    return 0;
+}
+
+
+static void sub_chantable_check(void) {
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    if (chantable.valid && (chantable.modcount != vl_get_modcount())) {
+        sub_chantable_invalidate(NULL);
+    }
+#   endif
+}
+
+
+static void sub_chantable_build(vlFILE* fp) {
+    ot_u8       spec_id[_CHANTABLE_ENTRIES];
+    ot_int      i, j, count;
+    ot_uni16    scratch;
+
+    /// Phymac flags are stored in byte 2 of the file header
+    scratch.ushort  = vl_read(fp, 2);
+    chantable.flags = scratch.ubyte[0];
+
+    /// Decode each 6 byte channel entry, in file order
+    for (i=6, count=0; (i<fp->length) && (count<_CHANTABLE_ENTRIES); i+=6, count++) {
+        scratch.ushort                  = vl_read(fp, i);
+        spec_id[count]                  = scratch.ubyte[0];
+        scratch.ushort                  = vl_read(fp, i+2);
+        chantable.entry[count].tx_eirp  = scratch.ubyte[0];
+        chantable.entry[count].link_qual= scratch.ubyte[1];
+        scratch.ushort                  = vl_read(fp, i+4);
+        chantable.entry[count].cs_thr   = scratch.ubyte[0];
+        chantable.entry[count].cca_thr  = scratch.ubyte[1];
+    }
+
+    /// Resolve every spectrum ID to the first entry that matches it exactly,
+    /// or that matches its channel class (upper nibble).  The channel list is
+    /// not necessarily sorted, so first-match order is preserved.
+    for (i=0; i<64; i++) {
+        chantable.index[i] = _CHANTABLE_NONE;
+        for (j=0; j<count; j++) {
+            if ((i == spec_id[j]) || ((i & 0xF0) == spec_id[j])) {
+                chantable.index[i] = (ot_u8)j;
+                break;
+            }
+        }
+    }
+
+    chantable.valid = True;
+#   if (OT_FEATURE(VLWATCH) != ENABLED)
+    chantable.modcount = vl_get_modcount();
+#   endif
+}
+
+
+
+
 
 /** Radio-Agnostic Mode 2 Library Functions    <BR>
   * ========================================================================<BR>
@@ -186,9 +280,15 @@ OT_WEAK void rm2_init(void) {
     /// necessary settings and calibration will always occur. 
     phymac[0].channel   = 0xF0;
     phymac[0].tx_eirp   = 0x7F;
+    chantable.valid     = False;
     fp                  = ISF_open_su( ISF_ID(channel_configuration) );
     rm2_channel_lookup(0x18, fp);
     vl_close(fp);
+    
+    /// Drop the compiled channel table whenever the channel config is written
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    vl_watch(VL_ISF_BLOCKID, ISF_ID(channel_configuration), (VL_FLAG_MODDED | VL_FLAG_RESIZED), &sub_chantable_invalidate);
+#   endif
 }
 #endif
 
@@ -275,6 +375,10 @@ OT_WEAK ot_uint rm2_pkt_duration(ot_queue* pkt_q) {
     ot_uint pkt_duration;
 
     pkt_bytes = q_length(pkt_q);
+#   if (M2_FEATURE(MULTIFRAME) == ENABLED)
+    // Each continuation frame of a multiframe packet adds a header and CRC
+    pkt_bytes += (pkt_bytes / M2_PARAM(MAXFRAME)) * (M2_MFP_HDRBYTES + 2);
+#   endif
     if (pkt_q->front[1] & 0x40) {
         // If packet is using RS coding, adjust by the nominal rate (+25%).
         pkt_bytes += (pkt_bytes+3)>>2;
@@ -404,7 +508,7 @@ OT_WEAK ot_bool rm2_mac_filter() {
 
 #ifndef EXTF_rm2_channel_refresh
 OT_WEAK void rm2_channel_refresh(void) {
-    radio.flags |= RADIO_FLAG_REFRESH;
+    sub_chantable_invalidate(NULL);
 }
 #endif
 
@@ -413,15 +517,11 @@ OT_WEAK void rm2_channel_refresh(void) {
 OT_WEAK ot_bool rm2_test_channel(ot_u8 channel) {
     ot_bool test;
     
+    /// The channel config file is only opened if the compiled channel table
+    /// needs to be rebuilt, which rm2_channel_lookup() handles.
     test = rm2_channel_fastcheck(channel);
     if (test == False) {
-        vlFILE* fp;
-        /// Open the Mode 2 FS Config register that contains the channel list
-        /// for this host, and make sure the channel we want to use is available
-        /// @todo assert fp
-        fp      = ISF_open_su( ISF_ID(channel_configuration) );
-        test    = rm2_channel_lookup(channel, fp);
-        vl_close(fp);
+        test = rm2_channel_lookup(channel, NULL);
     }
 
     return test;
@@ -431,14 +531,10 @@ OT_WEAK ot_bool rm2_test_channel(ot_u8 channel) {
 
 #ifndef EXTF_rm2_test_chanlist
 OT_WEAK ot_bool rm2_test_chanlist() {
-    vlFILE* fp;
     ot_int  i;
     ot_bool test;
     ot_u8	next_channel;
 
-    fp = ISF_open_su( ISF_ID(channel_configuration) );
-    ///@todo assert fp
-
     /// Go through the list of tx channels
     /// <LI> Make sure the channel ID is valid. </LI>
     /// <LI> Make sure the transmission can fit within the contention period. </LI>
@@ -449,12 +545,11 @@ OT_WEAK ot_bool rm2_test_chanlist() {
         	test = True;
         	break;
         }
-        if (rm2_channel_lookup(next_channel, fp)) {
+        if (rm2_channel_lookup(next_channel, NULL)) {
         	test = True;
 			break;
         }
     }
-    vl_close(fp);
 
     return test;
 }
@@ -465,6 +560,7 @@ OT_WEAK ot_bool rm2_test_chanlist() {
 OT_WEAK ot_bool rm2_channel_fastcheck(ot_u8 chan_id) {
     
     // Check if there's a forced-refresh condition (always fail)
+    sub_chantable_check();
     if (radio.flags & RADIO_FLAG_REFRESH) {
         radio.flags ^= RADIO_FLAG_REFRESH;
         return False;
@@ -492,53 +588,47 @@ OT_WEAK ot_bool rm2_channel_lookup(ot_u8 chan_id, vlFILE* fp) {
 /// Duty: (a) See if the supplied channel is supported on this device & config.
 ///       If yes, return true.  (b) Determine if recalibration is required
 ///       before changing to the new channel, and recalibrate if so.
-    ot_u8       spectrum_id;
-    ot_int      i;
-    volatile ot_uni16    scratch;
-
-    // Strip the FEC & Spread bits
-    spectrum_id = chan_id & 0x3F;
+/// The channel config file is only read when the compiled table is stale.  If
+/// fp is NULL, the file is opened and closed here as needed.
+    ot_u8 select;
+
+    sub_chantable_check();
+    if (chantable.valid == False) {
+        if (fp != NULL) {
+            sub_chantable_build(fp);
+        }
+        else {
+            fp = ISF_open_su( ISF_ID(channel_configuration) );
+            ///@todo assert fp
+            sub_chantable_build(fp);
+            vl_close(fp);
+        }
+    }
 
     /// Populate the phymac flags: these are not frequently used
-    /// @todo I might want to do this in radio_init() instead
-    scratch.ushort  = vl_read(fp, 2);
-    phymac[0].flags = scratch.ubyte[0];
-
-    /// Look through the channel list to find the one with matching spectrum id.
-    /// The channel list is not necessarily sorted.
-    /// @todo might do this with vl_get() in the future
-    for (i=6; i<fp->length; i+=6) {
-        scratch.ushort = vl_read(fp, i);
-
-        if ((spectrum_id == scratch.ubyte[0]) \
-        || ((spectrum_id & 0xF0) == scratch.ubyte[0])) {
-            ot_u8 old_chan_id   = phymac[0].channel;
-            ot_u8 old_tx_eirp   = (phymac[0].tx_eirp & 0x7f);
-
-            phymac[0].tg        = rm2_default_tgd(chan_id);
-            phymac[0].channel   = chan_id;
-          //phymac[0].autoscale = scratch.ubyte[1];
-
-            scratch.ushort      = vl_read(fp, i+2);
-            phymac[0].tx_eirp   = scratch.ubyte[0] & 0x80;
-            phymac[0].tx_eirp  |= rm2_clip_txeirp(scratch.ubyte[0]);
-            phymac[0].link_qual = scratch.ubyte[1];
-
-            ///@todo Try this: *(ot_u16*)&phymac[0].cs_thr = vl_read(fp, i+4);  
-            ///it will need some rearrangement in phymac struct
-            /// Convert thresholds from DASH7 numeric encoding to native encoding
-            scratch.ushort      = vl_read(fp, i+4);
-            //phymac[0].cs_thr    = __THR(scratch.ubyte[0]);
-            //phymac[0].cca_thr   = scratch.ubyte[1];
-            //phymac[0].cs_thr    = rm2_calc_rssithr(phymac[0].cs_thr);
-            //phymac[0].cca_thr   = rm2_calc_rssithr(phymac[0].cca_thr);
-            radio.threshold.raw = scratch.ubyte[0];
-            phymac[0].cs_thr    = rm2_calc_rssithr( (ot_u8)(radio.threshold.raw + radio.threshold.offset) );
-            phymac[0].cca_thr   = rm2_calc_rssithr( scratch.ubyte[1] );
-            
-            rm2_enter_channel(old_chan_id, old_tx_eirp);
-            return True;
-        }
+    phymac[0].flags = chantable.flags;
+
+    /// Strip the FEC & Spread bits, then index the table by spectrum id
+    select = chantable.index[chan_id & 0x3F];
+
+    if (select != _CHANTABLE_NONE) {
+        const chanentry_t* entry    = &chantable.entry[select];
+        ot_u8 old_chan_id           = phymac[0].channel;
+        ot_u8 old_tx_eirp           = (phymac[0].tx_eirp & 0x7f);
+
+        phymac[0].tg        = rm2_default_tgd(chan_id);
+        phymac[0].channel   = chan_id;
+        phymac[0].tx_eirp   = entry->tx_eirp & 0x80;
+        phymac[0].tx_eirp  |= rm2_clip_txeirp(entry->tx_eirp);
+        phymac[0].link_qual = entry->link_qual;
+
+        /// Convert thresholds from DASH7 numeric encoding to native encoding
+        radio.threshold.raw = entry->cs_thr;
+        phymac[0].cs_thr    = rm2_calc_rssithr( (ot_u8)(radio.threshold.raw + radio.threshold.offset) );
+        phymac[0].cca_thr   = rm2_calc_rssithr( entry->cca_thr );
+        
+        rm2_enter_channel(old_chan_id, old_tx_eirp);
+        return True;
     }
     return False;
 }
@@ -37,10 +37,18 @@
 
 #include <otlib/alp.h>
 #include <otlib/buffers.h>
+#include <otlib/memcpy.h>
 #include <otlib/queue.h>
 #include <otlib/utils.h>
 #include <otsys/veelite.h>
 
+#if (defined(__SSE2__) && defined(__GNUC__))
+#   define _CORR_SSE2   1
+#   include <emmintrin.h>
+#else
+#   define _CORR_SSE2   0
+#endif
+
 
 
 
@@ -155,31 +163,46 @@ m2qp_struct m2qp;
 
 /** @brief Subroutine for use with m2qp_load_isf(): Loads arithmetic comparison.
   * @param cursor       (ot_int*)   Used by m2qp_load_isf()
-  * @param data_byte    (ot_u8)     One byte of data to load (and process)
+  * @param data         (const ot_u8*) Span of data to load (and process)
+  * @param length       (ot_int)    Number of bytes in the span
   * @retval ot_int      always returns 0
   */
-ot_int sub_load_comparison(ot_int* cursor, ot_u8 data_byte);
+ot_int sub_load_comparison(ot_int* cursor, const ot_u8* data, ot_int length);
 
 /** @brief Subroutine for use with m2qp_load_isf(): Performs string token search.
   * @param cursor       (ot_int*)   Used by m2qp_load_isf()
-  * @param data_byte    (ot_u8)     One byte of data to load (and process)
-  * @retval ot_int      returns 1 if there is a match, 0 if no match
+  * @param data         (const ot_u8*) Span of data to load (and process)
+  * @param length       (ot_int)    Number of bytes in the span
+  * @retval ot_int      returns the number of matches in the span
+  */
+ot_int sub_load_charcorrelation(ot_int* cursor, const ot_u8* data, ot_int length);
+
+/** @brief Prepares the token search engine from m2qp.qtmpl
+  * @retval ot_bool     False if the token is longer than M2QC_COR_MAXTOKEN
   */
-ot_int sub_load_charcorrelation(ot_int* cursor, ot_u8 data_byte);
+ot_bool sub_corr_init(void);
 
 /** @brief Subroutine for use with m2qp_load_isf(): Loads return template
   * @param cursor       (ot_int*)   Used by m2qp_load_isf()
-  * @param data_byte    (ot_u8)     One byte of data to load (and process)
+  * @param data         (const ot_u8*) Span of data to load (and process)
+  * @param length       (ot_int)    Number of bytes in the span
   * @retval ot_int      always returns 0
   */
-ot_int sub_load_return(ot_int* cursor, ot_u8 data_byte);
+ot_int sub_load_return(ot_int* cursor, const ot_u8* data, ot_int length);
 
 /** @brief Subroutine for use with m2qp_load_isf(): Does nothing
   * @param cursor       (ot_int*)   Used by m2qp_load_isf()
-  * @param data_byte    (ot_u8)     One byte of data to load (and process)
+  * @param data         (const ot_u8*) Span of data to load (and process)
+  * @param length       (ot_int)    Number of bytes in the span
   * @retval ot_int      always returns 0
   */
-ot_int sub_load_nonnull(ot_int* cursor, ot_u8 data_byte);
+ot_int sub_load_nonnull(ot_int* cursor, const ot_u8* data, ot_int length);
+
+/** @brief Returns the length of ISF data, as it is loaded by m2qp_load_isf()
+  * @param fp           (vlFILE*)   open ISF file
+  * @retval ot_int      File length, or the amount of data in a ring file
+  */
+static ot_int sub_file_length(vlFILE* fp);
 
 
 
@@ -195,7 +218,7 @@ typedef void (*m2qp_subproc)(void);
 void    sub_opgroup_globalisf(void);
 void    sub_opgroup_udp(void);
 void    sub_opgroup_collection(void);
-void    sub_opgroup_scinit(void);
+void    sub_opgroup_aggregate(void);
 void    sub_opgroup_sctransport(void);
 void    sub_opgroup_rfu(void);
 
@@ -206,6 +229,12 @@ void    sub_renack(ot_int nack);
 void    sub_load_query();
 ot_int  sub_process_query(m2session* active);
 
+#if (M2_FEATURE(AGGREGATE) == ENABLED)
+#   define _OPGROUP_AGGREGATE   &sub_opgroup_aggregate
+#else
+#   define _OPGROUP_AGGREGATE   &sub_opgroup_rfu
+#endif
+
 /// This is a command vector table used to turn a command opcode into a
 /// function call that is appropriate for processing that command.
 static const ot_sub opgroup_proc[8] = { &sub_opgroup_globalisf,     //Announcement
@@ -213,7 +242,7 @@ static const ot_sub opgroup_proc[8] = { &sub_opgroup_globalisf,     //Announceme
                                         &sub_opgroup_udp,           //Inventory+UDP
                                         &sub_opgroup_collection,    //Collection
                                         &sub_opgroup_collection,    //Collection
-                                        &sub_opgroup_scinit,        //DS init, DS negotiate
+                                        _OPGROUP_AGGREGATE,         //Aggregation
                                         &sub_opgroup_sctransport,   //DS send, DS ACK
                                         &sub_opgroup_rfu            //RFU
                                     };
@@ -265,6 +294,8 @@ OT_WEAK void m2qp_init() {
     //Initialize to an undefined code value
     m2qp.cmd.code = 0x1F;
 
+    m2qp_flush_querycache();
+
     ///@todo m2alp: Revise this code to use independent buffer 
     ///      for M2ALP instead of having it point directly to 
     ///      rxq & txq.
@@ -534,8 +565,21 @@ void sub_opgroup_collection(void) {
 
 
 
-void sub_opgroup_scinit(void) {
-/// This is an SCTP command.  RFU
+void sub_opgroup_aggregate(void) {
+/// Aggregation is like collection, but the reply payload is the reduction of
+/// the called data.  Responses go to the global ISF callback, like the other
+/// ISF opgroups, which can parse the aggregate return template from rxq.
+#if (M2_FEATURE(AGGREGATE) == ENABLED)
+    if (((m2qp.cmd.code & M2TT_MASK) != M2TT_RESPONSE) && ((m2qp.cmd.ext & M2CE_NORESP) == 0)) {
+        ot_int count;
+        count = m2qp_isf_aggregate(&rxq, &m2np.rt.dlog);
+        if (count < 0) {
+            sub_renack(count);
+        }
+    }
+#endif
+
+    sub_opgroup_globalisf();
 }
 
 
@@ -605,17 +649,26 @@ ot_int sub_process_query(m2session* active) {
     /// ACK check: Non-initial A2P only
     /// Look through the ack list for this host's device ID.  If it is
     /// there, then the query can exit.
+    /// The list is either a plain ID list or a Bloom filter (see network.h).
     if (cmd_type > M2TT_REQ_M_INIT) {     ///@todo future update code
         ot_bool id_test;
+        ot_int  id_length       = m2np.rt.dlog.length;
         ot_int  number_of_acks  = (ot_int)q_readbyte(&rxq);
 
-        do {
-            id_test = m2np_idcmp(m2np.rt.dlog.length, q_markbyte(&rxq, m2np.rt.dlog.length));
-            number_of_acks--;
+#       if (M2_FEATURE(ACKBLOOM))
+        if (number_of_acks == M2_ACKLIST_BLOOM) {
+            ot_int  filter_bytes    = (ot_int)q_readbyte(&rxq);
+            ot_u8   seed            = q_readbyte(&rxq);
+            id_test = m2np_ackbloom_test(id_length, filter_bytes, seed, q_markbyte(&rxq, filter_bytes));
+        }
+        else
+#       endif
+        {
+            id_test = m2np_idlist_search(id_length, number_of_acks, 
+                                        q_markbyte(&rxq, number_of_acks*id_length));
         }
-        while ((number_of_acks >= 0) && (id_test == False));
 
-        if (number_of_acks != 0) {
+        if (id_test) {
             goto sub_process_query_EXITA2P;
         }
     }
@@ -664,32 +717,207 @@ ot_int sub_process_query(m2session* active) {
 
 
 
+/** Query Result Cache <BR>
+  * ========================================================================<BR>
+  * Collections and anycast rounds send the same global query many times over.
+  * The results of m2qp_isf_comp() are memoized, keyed by the query template,
+  * the ISF comparison template, and the ID of the user running the query.
+  * Results are valid until veelite reports a modification (vl_get_modcount),
+  * so a repeated query is answered without opening any files.
+  */
+#if (M2_FEATURE(QUERYCACHE) == ENABLED)
+
+#define _QCACHE_ENTRIES     M2_PARAM(QUERYCACHE)
+#define _QCACHE_TOKEN       M2QC_COR_MAXTOKEN
+#define _QCACHE_USERID      8
+
+typedef struct {
+    ot_u32  modcount;
+    ot_u8   valid;
+    ot_u8   is_series;
+    ot_u8   comp_id;
+    ot_u8   code;
+    ot_int  comp_offset;
+    ot_u8   length;
+    ot_u8   user_length;        // 255 when there is no user (root access)
+    ot_u8   user[_QCACHE_USERID];
+    ot_u8   mask[_QCACHE_TOKEN];
+    ot_u8   ref[_QCACHE_TOKEN];  // value & mask
+    ot_int  score;
+} qcache_entry;
+
+typedef struct {
+    ot_u8           next;
+    qcache_entry    entry[_QCACHE_ENTRIES];
+} qcache_struct;
+
+static qcache_struct qcache;
+
+
+static ot_bool sub_qcache_key(qcache_entry* key, ot_u8 is_series, id_tmpl* user_id) {
+/// Builds a cache key from the loaded query.  Returns False if the query
+/// cannot be cached.
+    ot_int i;
+
+    if ((m2qp.qtmpl.length > _QCACHE_TOKEN) || \
+        ((user_id != NULL) && (user_id->length > _QCACHE_USERID))) {
+        return False;
+    }
+
+    ot_memset((ot_u8*)key, 0, sizeof(qcache_entry));
+    key->valid          = True;
+    key->is_series      = is_series;
+    key->comp_id        = m2qp.qdata.comp_id;
+    key->comp_offset    = m2qp.qdata.comp_offset;
+    key->code           = m2qp.qtmpl.code;
+    key->length         = m2qp.qtmpl.length;
+    key->user_length    = 255;
+
+    if (user_id != NULL) {
+        key->user_length = user_id->length;
+        ot_memcpy(key->user, user_id->value, user_id->length);
+    }
+    for (i=0; i<m2qp.qtmpl.length; i++) {
+        key->mask[i]    = m2qp.qtmpl.mask[i];
+        key->ref[i]     = m2qp.qtmpl.value[i] & key->mask[i];
+    }
+    return True;
+}
+
+
+static ot_bool sub_qcache_match(qcache_entry* key, qcache_entry* entry) {
+    ot_u8*  a;
+    ot_u8*  b;
+    ot_int  i;
+
+    if ((entry->is_series   != key->is_series)  || (entry->comp_id != key->comp_id) || \
+        (entry->comp_offset != key->comp_offset)|| (entry->code    != key->code)    || \
+        (entry->length      != key->length)     || (entry->user_length != key->user_length)) {
+        return False;
+    }
+
+    /// Unused token and user bytes are zero in both, so the arrays are compared
+    /// in full: user, mask and ref are contiguous in the entry.
+    a = key->user;
+    b = entry->user;
+    for (i=0; i<(_QCACHE_USERID + _QCACHE_TOKEN*2); i++) {
+        if (a[i] != b[i]) {
+            return False;
+        }
+    }
+    return True;
+}
+
+
+static qcache_entry* sub_qcache_find(qcache_entry* key) {
+    ot_u32  modcount = vl_get_modcount();
+    ot_int  i;
+
+    for (i=0; i<_QCACHE_ENTRIES; i++) {
+        qcache_entry* entry = &qcache.entry[i];
+
+        if (entry->valid && (entry->modcount == modcount) && sub_qcache_match(key, entry)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+static void sub_qcache_store(qcache_entry* key, ot_int score) {
+    key->modcount   = vl_get_modcount();
+    key->score      = score;
+    ot_memcpy((ot_u8*)&qcache.entry[qcache.next], (ot_u8*)key, sizeof(qcache_entry));
+    qcache.next     = (qcache.next+1 == _QCACHE_ENTRIES) ? 0 : qcache.next+1;
+}
+
+#endif
+
+
+#ifndef EXTF_m2qp_flush_querycache
+OT_WEAK void m2qp_flush_querycache(void) {
+#if (M2_FEATURE(QUERYCACHE) == ENABLED)
+    ot_memset((ot_u8*)&qcache, 0, sizeof(qcache_struct));
+#endif
+}
+#endif
+
+
+
+
+
+
+
 /** Protocol File System (ISF) Functions
   * ============================================================================
   * - ISF manipulation is the core feature of M2QP.
   * - M2QP ISF manipulation can be done on single files or series of files.
   */
 #ifndef EXTF_m2qp_isf_comp
+static ot_int sub_isf_comp(ot_u8 is_series, id_tmpl* user_id);
+
 OT_WEAK ot_int m2qp_isf_comp(ot_u8 is_series, id_tmpl* user_id) {
+#   if (M2_FEATURE(QUERYCACHE) == ENABLED)
+    qcache_entry    key;
+    qcache_entry*   hit;
+    ot_bool         cacheable;
+#   endif
+    ot_int          score;
+
+    // Assure length is 0 when Non-Null search is used
+    m2qp.qtmpl.length   = (m2qp.qtmpl.code) ? m2qp.qtmpl.length : 0;
+
+    // Get ISF information from queue
+    m2qp.qdata.comp_id  = q_readbyte(&rxq);
+
+    if (is_series)  m2qp.qdata.comp_offset  = q_readshort(&rxq);
+    else            m2qp.qdata.comp_offset  = q_readbyte(&rxq);
+
+#   if (M2_FEATURE(QUERYCACHE) == ENABLED)
+    // Repeated queries get the memoized result
+    cacheable = sub_qcache_key(&key, is_series, user_id);
+    if (cacheable) {
+        hit = sub_qcache_find(&key);
+        if (hit != NULL) {
+            return hit->score;
+        }
+    }
+    score = sub_isf_comp(is_series, user_id);
+    if (cacheable) {
+        sub_qcache_store(&key, score);
+    }
+    return score;
+
+#   else
+    score = sub_isf_comp(is_series, user_id);
+    return score;
+#   endif
+}
+
+
+static ot_int sub_isf_comp(ot_u8 is_series, id_tmpl* user_id) {
     ot_int  score;
 
     // Load the data from the file/series into the query buffer
-    {   ot_int  (*load_function)(ot_int*, ot_u8);
+    {   m2qp_loadfn load_function;
+        ot_int      window_bytes;
 
-        // Assure length is 0 when Non-Null search is used, and set the load
-        // function accordingly, depending on the query method
-        m2qp.qtmpl.length   = (m2qp.qtmpl.code) ? m2qp.qtmpl.length : 0;
+        // Set the load function according to the query method
         load_function       = ((m2qp.qtmpl.code & M2QC_COR_SEARCH) != 0) ? \
                                &sub_load_charcorrelation : &sub_load_comparison;
 
-        // Get ISF information from queue, and load data
-        m2qp.qdata.comp_id  = q_readbyte(&rxq);
-
-        if (is_series)  m2qp.qdata.comp_offset  = q_readshort(&rxq);
-        else            m2qp.qdata.comp_offset  = q_readbyte(&rxq);
+        // A token search runs to the end of the dataset.  A comparison only
+        // loads as many bytes as are in the comparison token.
+        window_bytes = m2qp.qtmpl.length;
+        if (m2qp.qtmpl.code & M2QC_COR_SEARCH) {
+            if (sub_corr_init() == False) {
+                return -1;
+            }
+            window_bytes = (m2qp.qtmpl.length != 0) ? 0x7FFF : 0;
+        }
 
         score   = m2qp_load_isf(is_series, m2qp.qdata.comp_id, m2qp.qdata.comp_offset,
-                                m2qp.qtmpl.length, load_function, user_id );
+                                window_bytes, load_function, user_id );
     }
 
     /// Manage search errors
@@ -788,8 +1016,8 @@ OT_WEAK ot_int m2qp_isf_call( ot_u8 is_series, ot_queue* input_q, id_tmpl* user_
             fp_f = ISF_open(scratch.ubyte[i&1], VL_ACCESS_R, user_id);
             if (fp_f != NULL) {
                 q_writebyte(&txq, GET_B0_U16(fp_f->idmod) );
-                q_writebyte(&txq, (ot_u8)fp_f->length );
-                total_length += fp_f->length;
+                q_writebyte(&txq, (ot_u8)sub_file_length(fp_f) );
+                total_length += sub_file_length(fp_f);
             }
             vl_close(fp_f);
         }
@@ -808,7 +1036,7 @@ OT_WEAK ot_int m2qp_isf_call( ot_u8 is_series, ot_queue* input_q, id_tmpl* user_
             return -2;
         }
         offset          = q_readbyte(input_q);
-        total_length    = fp_f->length;
+        total_length    = sub_file_length(fp_f);
         q_writebyte(&txq, (ot_u8)offset );
         q_writebyte(&txq, (ot_u8)total_length );
         vl_close(fp_f);
@@ -836,79 +1064,387 @@ OT_WEAK ot_int m2qp_isf_call( ot_u8 is_series, ot_queue* input_q, id_tmpl* user_
 
 
 
+/** Aggregate Call <BR>
+  * ========================================================================<BR>
+  * The reducer runs as the load function of m2qp_load_isf(), so the called
+  * data is streamed through it one span at a time, and nothing but the
+  * running results is kept.  Elements may straddle spans (and files of a
+  * series), so a partial element is carried between spans.
+  */
+#if (M2_FEATURE(AGGREGATE) == ENABLED)
+
+#define _AGG_LASTN      M2_PARAM(AGG_LASTN)
+
+typedef struct {
+    ot_u8   format;
+    ot_u8   size;
+    ot_u8   fill;               // bytes of the partial element
+    ot_u8   last_head;          // next slot of the last-N ring
+    ot_u32  part;
+    ot_u16  count;
+    ot_s32  min;
+    ot_s32  max;
+    ot_u32  sum;
+    ot_s32  last[_AGG_LASTN];
+} agg_struct;
+
+static agg_struct agg;
+
+
+static void sub_agg_push(ot_u32 raw) {
+    ot_s32 value;
+
+    // Sign extend, if signed elements.  Unsigned 4 byte elements are kept as
+    // their bit pattern, and compared as unsigned.
+    if ((agg.format & M2AG_FMT_SIGNED) && (agg.size < 4)) {
+        ot_u32 sign = (ot_u32)1 << ((agg.size << 3) - 1);
+        if (raw & sign) {
+            raw |= ~((sign << 1) - 1);
+        }
+    }
+    value = (ot_s32)raw;
+
+    if (agg.count == 0) {
+        agg.min = value;
+        agg.max = value;
+    }
+    else if ((agg.format & M2AG_FMT_SIGNED) || (agg.size < 4)) {
+        if (value < agg.min)    agg.min = value;
+        if (value > agg.max)    agg.max = value;
+    }
+    else {
+        if ((ot_u32)value < (ot_u32)agg.min)    agg.min = value;
+        if ((ot_u32)value > (ot_u32)agg.max)    agg.max = value;
+    }
+
+    agg.sum                += (ot_u32)value;
+    agg.last[agg.last_head] = value;
+    agg.last_head           = (agg.last_head + 1) % _AGG_LASTN;
+    agg.count++;
+}
+
+
+static ot_int sub_load_aggregate(ot_int* cursor, const ot_u8* data, ot_int length) {
+    *cursor += length;
+
+    while (--length >= 0) {
+        ot_u32 byte = *data++;
+
+        if (agg.format & M2AG_FMT_LE)   agg.part |= (byte << (agg.fill << 3));
+        else                            agg.part  = (agg.part << 8) | byte;
+
+        if (++agg.fill == agg.size) {
+            sub_agg_push(agg.part & (0xFFFFFFFF >> ((4-agg.size) << 3)));
+            agg.part = 0;
+            agg.fill = 0;
+        }
+    }
+    return 0;
+}
+
+
+static void sub_agg_writelast(ot_int n) {
+/// Writes the last n elements, oldest first, in their stored size and order
+    ot_int slot = agg.last_head - n;
+
+    if (slot < 0) {
+        slot += _AGG_LASTN;
+    }
+    while (--n >= 0) {
+        ot_u32  value = (ot_u32)agg.last[slot];
+        ot_int  i;
+
+        for (i=0; i<agg.size; i++) {
+            ot_int shift = (agg.format & M2AG_FMT_LE) ? i : (agg.size - 1 - i);
+            q_writebyte(&txq, (ot_u8)(value >> (shift << 3)));
+        }
+        slot = (slot + 1) % _AGG_LASTN;
+    }
+}
+
+
+#ifndef EXTF_m2qp_isf_aggregate
+OT_WEAK ot_int m2qp_isf_aggregate(ot_queue* input_q, id_tmpl* user_id) {
+    ot_u8   reducers;
+    ot_u8   last;
+    ot_u8   isf_id;
+    ot_int  offset;
+    ot_int  window;
+    ot_int  room;
+    ot_int  score;
+
+    /// 1. Break down the Aggregate Call Template
+    reducers    = q_readbyte(input_q);
+    agg.format  = q_readbyte(input_q);
+    last        = q_readbyte(input_q);
+    isf_id      = q_readbyte(input_q);
+    offset      = (reducers & M2AG_SERIES) ? q_readshort(input_q) : q_readbyte(input_q);
+    window      = (ot_int)q_readshort(input_q);
+    if (window <= 0) {
+        window = 32767;
+    }
+
+    agg.size        = 1 << (agg.format & M2AG_FMT_SIZEMASK);
+    agg.fill        = 0;
+    agg.part        = 0;
+    agg.last_head   = 0;
+    agg.count       = 0;
+    agg.sum         = 0;
+    if (agg.size > 4) {
+        return -1;
+    }
+
+    /// 2. Run the reducer over the window.  If the data is not accessible,
+    ///    don't respond.
+    score = m2qp_load_isf((reducers & M2AG_SERIES), isf_id, offset, window,
+                          &sub_load_aggregate, user_id);
+    if (score < 0) {
+        return -2;
+    }
+
+    /// 3. Write the Aggregate Return Template.  The last-N list is clipped to
+    ///    the elements seen, the ring size, and the room left in the frame.
+    if (last > agg.count)   last = (ot_u8)agg.count;
+    if (last > _AGG_LASTN)  last = _AGG_LASTN;
+    if ((reducers & M2AG_LAST) == 0) {
+        last = 0;
+    }
+    room = (txq.back - txq.putcursor) - 5;
+    room-= ((reducers & M2AG_MIN) != 0) << 2;
+    room-= ((reducers & M2AG_MAX) != 0) << 2;
+    room-= ((reducers & M2AG_SUM) != 0) << 2;
+    room-= ((reducers & M2AG_LAST) != 0);
+    if (room < 0) {
+        return -1;
+    }
+    if ((last * agg.size) > room) {
+        last = (ot_u8)(room / agg.size);
+    }
+
+    q_writebyte(&txq, reducers);
+    q_writebyte(&txq, agg.format);
+    q_writebyte(&txq, isf_id);
+    q_writeshort(&txq, agg.count);
+    if (reducers & M2AG_MIN)    q_writelong(&txq, (ot_u32)agg.min);
+    if (reducers & M2AG_MAX)    q_writelong(&txq, (ot_u32)agg.max);
+    if (reducers & M2AG_SUM)    q_writelong(&txq, agg.sum);
+    if (reducers & M2AG_LAST) {
+        q_writebyte(&txq, last);
+        sub_agg_writelast(last);
+    }
+
+    return agg.count;
+}
+#endif
+
+#endif
+
+
+
+
+/** Series Map and Span Loading <BR>
+  * ========================================================================<BR>
+  * m2qp_load_isf() processes ISF data in contiguous spans instead of one byte
+  * at a time.  A span is taken directly from the file when veelite can give a
+  * pointer to it (vl_memptr), otherwise it is read in small chunks.
+  *
+  * The series map caches the file IDs and lengths of the last ISF Series
+  * used, so the files ahead of the offset don't need to be opened to find
+  * where the window starts.  It is validated against the veelite mod count.
+  */
+
+#define _SERIESMAP_FILES    16
+#define _SPAN_CHUNK         16
+
+typedef struct {
+    ot_u32  modcount;
+    ot_u8   iss_id;
+    ot_u8   n_files;            // 0 when the map is invalid
+    ot_u16  length[_SERIESMAP_FILES];
+} seriesmap_t;
+
+static seriesmap_t seriesmap;
+
+
+static ot_int sub_file_length(vlFILE* fp) {
+/// Ring files are loaded by logical offset, from the oldest byte, so their
+/// length is the amount of data in the ring (the preamble is not loaded).
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_int fill = vl_ring_fill(fp);
+    if (fill >= 0) {
+        return fill;
+    }
+#   endif
+    return (ot_int)fp->length;
+}
+
+
+static ot_u8 sub_series_fileid(vlFILE* fp_s, ot_int index) {
+    ot_uni16 scratch;
+    scratch.ushort = vl_read(fp_s, index & ~1);
+    return scratch.ubyte[index & 1];
+}
+
+
+static ot_bool sub_seriesmap_load(ot_u8 iss_id, vlFILE* fp_s) {
+    ot_u32  modcount = vl_get_modcount();
+    ot_int  i;
+
+    if ((seriesmap.n_files != 0) \
+    && (seriesmap.iss_id == iss_id) \
+    && (seriesmap.modcount == modcount)) {
+        return True;
+    }
+
+    /// Build a new map.  Series that are too long, or that contain files which
+    /// don't exist, are not mapped.
+    seriesmap.n_files = 0;
+    if ((fp_s->length == 0) || (fp_s->length > _SERIESMAP_FILES)) {
+        return False;
+    }
+    for (i=0; i<fp_s->length; i++) {
+        vlFILE* fp_f = ISF_open_su( sub_series_fileid(fp_s, i) );
+        if (fp_f == NULL) {
+            return False;
+        }
+        seriesmap.length[i] = (ot_u16)sub_file_length(fp_f);
+        vl_close(fp_f);
+    }
+    seriesmap.iss_id    = iss_id;
+    seriesmap.modcount  = modcount;
+    seriesmap.n_files   = (ot_u8)fp_s->length;
+    return True;
+}
+
+
+static ot_int sub_load_span(vlFILE* fp_f, ot_int offset, ot_int* cursor,
+                            ot_int window_bytes, m2qp_loadfn load_function) {
+    ot_u8*  data;
+    ot_int  span;
+    ot_int  ring_fill = -1;
+    ot_int  output = 0;
+
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ring_fill = vl_ring_fill(fp_f);
+#   endif
+    span = ((ring_fill >= 0) ? ring_fill : (ot_int)fp_f->length) - offset;
+    if (span > (window_bytes - *cursor)) {
+        span = window_bytes - *cursor;
+    }
+    if (span <= 0) {
+        return 0;
+    }
+
+    /// Contiguous file data: process the whole span at once.  Ring files are
+    /// stored wrapped, so they always go through the ring reader.
+    data = (ring_fill >= 0) ? NULL : vl_memptr(fp_f);
+    if (data != NULL) {
+        return load_function(cursor, &data[offset], span);
+    }
+
+    /// Otherwise go through the file a chunk at a time
+    while (span > 0) {
+        ot_u8       chunk[_SPAN_CHUNK];
+        ot_uni16    scratch;
+        ot_int      n, k;
+
+        n = (span > _SPAN_CHUNK) ? _SPAN_CHUNK : span;
+        if (ring_fill >= 0) {
+            vl_ring_read(fp_f, offset, n, chunk);
+            offset += n;
+        }
+        else {
+            for (k=0; k<n; k++, offset++) {
+                if ((k == 0) || ((offset & 1) == 0)) {
+                    scratch.ushort = vl_read(fp_f, offset & ~1);
+                }
+                chunk[k] = scratch.ubyte[offset & 1];
+            }
+        }
+        output += load_function(cursor, chunk, n);
+        span   -= n;
+    }
+
+    return output;
+}
+
+
 #ifndef EXTF_m2qp_load_isf
 OT_WEAK ot_int m2qp_load_isf(   ot_u8       is_series,
                                 ot_u8       isf_id,
                                 ot_int      offset,
                                 ot_int      window_bytes,
-                                ot_int      (*load_function)(ot_int*, ot_u8),
+                                m2qp_loadfn load_function,
                                 id_tmpl*    user_id ) {
-    ot_uni16 scratch;
-    ot_int  i;
-    vlFILE* fp_f;
     vlFILE* fp_s    = NULL;
+    ot_u8   file_id = isf_id;
     ot_int  n_files = 1;
+    ot_int  i       = 0;
     ot_int  j       = 0;
     ot_int  output  = 0;
 
     /// 1. Open the ISF Series, if enabled
     ///    Do not respond if the series is not accessible (return negative)
+    ///    If there is a window to load, use the series map to skip over the
+    ///    files that come before the offset.  The skipped files are still
+    ///    access-checked (header lookup only), so an inaccessible file fails
+    ///    the query as it would if it were opened.  With no window (Non-Null
+    ///    queries) all the files are opened, to make sure they exist.
     if (is_series) {
         fp_s = ISS_open( isf_id, VL_ACCESS_R, user_id );
         if (fp_s == NULL) {
             return -32768;
         }
         n_files = fp_s->length;
-    }
 
-    /// 2. If no Series, spoof a single file access as a series of size 1
-    else {
-        scratch.ubyte[0]    = isf_id;
-        n_files             = 1;
+        if ((window_bytes > 0) && sub_seriesmap_load(isf_id, fp_s)) {
+            while ((i < n_files) && (offset >= (ot_int)seriesmap.length[i])) {
+                vaddr header;
+                if (vl_getheader_vaddr(&header, VL_ISF_BLOCKID, sub_series_fileid(fp_s, i),
+                                        VL_ACCESS_R, user_id) != 0) {
+                    vl_close(fp_s);
+                    return -32768;
+                }
+                offset -= seriesmap.length[i];
+                i++;
+            }
+        }
     }
 
-    /// 3.  Step through each file of the ISF Series, and process it.
-    ///     This double-loop will extract and process a window of "window_bytes"
-    ///     bytes that is stored contiguously across any number of files in a
-    ///     series.  Processing stops when the series ends or the window is full.
-    for (i=0; i<n_files; i++) {
-        ot_u8 align = (i & 1);
+    /// 2.  Step through each file of the ISF Series (or the single ISF), and
+    ///     process it.  This will extract and process a window of
+    ///     "window_bytes" bytes that is stored contiguously across any number
+    ///     of files in a series.  Processing stops when the series ends or the
+    ///     window is full.
+    for (; i<n_files; i++) {
+        vlFILE* fp_f;
 
-        // Read the next file ID if we are processing a ISS (series)
-        if ((is_series) && (align == 0)) {
-            scratch.ushort = vl_read(fp_s, i);
+        if (is_series) {
+            file_id = sub_series_fileid(fp_s, i);
         }
 
-        // Open the file:
-        // - If not accessible as a series, skip it
-        // - If not accessible as an file, bail
-        fp_f = ISF_open( scratch.ubyte[align], VL_ACCESS_R, user_id );
+        // Open the file: if not accessible, bail
+        fp_f = ISF_open( file_id, VL_ACCESS_R, user_id );
         if (fp_f == NULL) {
             vl_close(fp_s);
             return -32768;
         }
 
-        // Subtract the file length from the offset value.  When the offset
-        // goes negative, the current file is the one we should start on.
-        offset -= fp_f->length;
-        if (offset < 0) {
-            offset += fp_f->length;
-
-            // Load the window and process it, using the open file
-            while ( (j < window_bytes) && (offset < fp_f->length) ) {
-                ot_uni16 ldata;
-
-                align = offset & 1;
-                if (align == 0) {
-                    ldata.ushort = vl_read(fp_f, offset);
-                }
-                output += load_function( &j, ldata.ubyte[align] );
-                offset++;
-            }
-            // reset offset to 0, so the process resumes at next series file
-            offset = 0;
+        // Subtract the file length from the offset value until the offset
+        // lands inside a file.  The window starts there, and resumes at the
+        // start of each following file.
+        if (offset < sub_file_length(fp_f)) {
+            output += sub_load_span(fp_f, offset, &j, window_bytes, load_function);
+            offset  = 0;
+        }
+        else {
+            offset -= sub_file_length(fp_f);
         }
         vl_close(fp_f);
+
+        if ((window_bytes > 0) && (j >= window_bytes)) {
+            break;
+        }
     }
     vl_close(fp_s);
 
@@ -937,80 +1473,199 @@ OT_WEAK ot_int m2qp_load_isf(   ot_u8       is_series,
 
 
 
-/** Protocol File Loading Subroutines <BR>
+/** Token Search Engine <BR>
   * ========================================================================<BR>
-  * - Used as the load_function() argument to sub_load_isf()
+  * Used by sub_load_charcorrelation() for M2QC_COR_SEARCH queries.  The query
+  * passes a window when its correlation score, (matches - mismatches), meets
+  * the threshold in the query code.  That is the same as requiring at least
+  * "need" masked matches in the window, which allows some optimizations:
+  * <LI> The token is pre-masked once per query, rather than once per byte. </LI>
+  * <LI> The datastream is kept in a doubled ring buffer, so the window is
+  *      always contiguous and nothing gets shifted on each new byte. </LI>
+  * <LI> Window tests exit early once too many mismatches are found.  On SSE2
+  *      hosts, the whole window is tested with a single vector compare. </LI>
+  * <LI> Exact-match tokens (need == length) use a streaming Boyer-Moore-
+  *      Horspool skip: after each window test, the next windows that cannot
+  *      match, based on the last byte in the window, are not tested. </LI>
   */
 
-ot_int sub_load_charcorrelation(ot_int* cursor, ot_u8 data_byte) {
-/// This is a pure character-by-character correlation, which is not as efficient
-/// for comparing strings as more specialized methods (The Boyer-Moore-Horspool
-/// method might fit nicely here) but it gives the ability to report partial
-/// matches, which the BM or BMH methods do not.
-///
-/// A correlation is a mathematic process for comparing two sequences, so check
-/// Wikipedia for more info (http://en.wikipedia.org/wiki/Cross-correlation).
-/// This function performs a correlation of a byte-wise token onto a byte-wise
-/// datastream.  The token is usually supplied in the command data (stored in
-/// shared memory), and the datastream is fed into this function byte-by-byte
-/// (usually referenced from file data).
+typedef struct {
+    ot_u8   length;
+    ot_u8   need;
+    ot_u8   fill;
+    ot_u8   head;
+    ot_u8   skip;
+    ot_u8   ref[M2QC_COR_MAXTOKEN];
+    ot_u8   mask[M2QC_COR_MAXTOKEN];
+    ot_u8   win[M2QC_COR_MAXTOKEN*2];
+} corr_struct;
+
+static corr_struct corr;
+
 
+ot_bool sub_corr_init(void) {
     ot_int i;
-    ot_int c;
-    ot_u8* local_buf;
-
-    /// The datastream is buffered in an unused part of the data-queue.
-    /// The LOCAL_U8() macro behaves similar to array nomenclature
-    local_buf = &LOCAL_U8(0);
-    local_buf[*cursor] = data_byte;
-
-    /// If the datastream is *not* fully pre-buffered, return to the caller.
-    /// If the datastream is fully pre-buffered, then proceed to correlation.
-    if ( *cursor < (m2qp.qtmpl.length-1) ) {
-        (*cursor)++;
-        return 0;
+    ot_int need;
+
+    if (m2qp.qtmpl.length > M2QC_COR_MAXTOKEN) {
+        return False;
     }
 
-    /// Equality Correlation with data shifting of the buffer after each
-    /// comparison operation.  The value c is the comparison score.  It is a
-    /// bipolar accumulator, so a non-equality alters the score by -1 and an
-    /// equality by +1.  It is implemented as c += (0 or 2) - 1
-    else {
-        for (i=0, c=0; i<m2qp.qtmpl.length; i++) {
-            c += ( (local_buf[i] & m2qp.qtmpl.mask[i]) == \
-                   (m2qp.qtmpl.value[i] & m2qp.qtmpl.mask[i]) ) << 1;
-            c -= 1;
+    /// Unused token positions get mask 0 and ref 0, so they always match.  The
+    /// vector test depends on this.
+    ot_memset(corr.ref, 0, sizeof(corr.ref));
+    ot_memset(corr.mask, 0, sizeof(corr.mask));
+    for (i=0; i<m2qp.qtmpl.length; i++) {
+        corr.mask[i]    = m2qp.qtmpl.mask[i];
+        corr.ref[i]     = m2qp.qtmpl.value[i] & corr.mask[i];
+    }
+
+    /// score = 2*matches - length, so score >= thr when matches >= need
+    need        = ((ot_int)m2qp.qtmpl.length + (m2qp.qtmpl.code & M2QC_COR_THRMASK) + 1) >> 1;
+    corr.need   = (ot_u8)need;
+    corr.length = m2qp.qtmpl.length;
+    corr.fill   = 0;
+    corr.head   = 0;
+    corr.skip   = 1;
+    return True;
+}
+
+
+static ot_bool sub_corr_test(const ot_u8* window) {
+#if (_CORR_SSE2)
+    __m128i w, m, r;
+    ot_int  hits;
+
+    w       = _mm_loadu_si128((const __m128i*)window);
+    m       = _mm_loadu_si128((const __m128i*)corr.mask);
+    r       = _mm_loadu_si128((const __m128i*)corr.ref);
+    w       = _mm_cmpeq_epi8(_mm_and_si128(w, m), r);
+    hits    = __builtin_popcount(_mm_movemask_epi8(w));
+    hits   -= (M2QC_COR_MAXTOKEN - corr.length);
+    return (ot_bool)(hits >= corr.need);
+
+#else
+    ot_int i;
+    ot_int misses = (corr.length - corr.need) + 1;
+
+    /// Right to left, as in BMH: the last byte is the likeliest to mismatch
+    for (i=corr.length-1; i>=0; i--) {
+        if ((window[i] & corr.mask[i]) != corr.ref[i]) {
+            if (--misses == 0) {
+                return False;
+            }
+        }
+    }
+    return True;
+#endif
+}
+
+
+static ot_u8 sub_corr_bmhshift(ot_u8 last_byte) {
+/// Distance to the next alignment where the current last byte of the window
+/// can match the token.  This is the BMH bad-character shift, computed on
+/// demand since a 256 entry table per query is too costly on small MCUs.
+    ot_int i;
 
-            local_buf[i-1] = local_buf[i];
+    for (i=corr.length-2; i>=0; i--) {
+        if ((last_byte & corr.mask[i]) == corr.ref[i]) {
+            break;
         }
     }
+    return (ot_u8)(corr.length - 1 - i);
+}
+
+
+static ot_int sub_corr_push(ot_u8 data_byte) {
+    ot_u8*  window;
+    ot_bool hit;
+    ot_u8   pos;
+
+    /// Write the byte into both halves of the ring, so that the latest
+    /// "length" bytes are always contiguous at win[head]
+    pos                         = corr.head;
+    corr.win[pos]               = data_byte;
+    corr.win[pos+corr.length]   = data_byte;
+    corr.head                   = (pos+1 == corr.length) ? 0 : pos+1;
+
+    if (corr.fill < corr.length) {
+        corr.fill++;
+        if (corr.fill < corr.length) {
+            return 0;
+        }
+    }
+
+    /// Windows that the BMH skip has ruled out are not tested
+    if (corr.skip > 1) {
+        corr.skip--;
+        return 0;
+    }
+    if (corr.need > corr.length) {
+        return 0;
+    }
+
+    window  = &corr.win[corr.head];
+    hit     = sub_corr_test(window);
+    
+    if (corr.need == corr.length) {
+        corr.skip = sub_corr_bmhshift(window[corr.length-1]);
+    }
+    
+    return (ot_int)hit;
+}
 
-    /// One parameter of the correlation query is a correlation threshold.  It
-    /// occupies the lower 5 bits of the query code.  It is an integer value.
-    /// Scores higher than the threshold are passing scores.  The query score
-    /// indicates the number of hits the query made on the file data.
-    return (c >= (ot_int)(m2qp.qtmpl.code & 0x1F));
+
+
+
+
+
+/** Protocol File Loading Subroutines <BR>
+  * ========================================================================<BR>
+  * - Used as the load_function() argument to sub_load_isf()
+  */
+
+ot_int sub_load_charcorrelation(ot_int* cursor, const ot_u8* data, ot_int length) {
+/// A correlation is a mathematic process for comparing two sequences, so check
+/// Wikipedia for more info (http://en.wikipedia.org/wiki/Cross-correlation).
+/// This function performs a correlation of a byte-wise token onto a byte-wise
+/// datastream.  The token is usually supplied in the command data (stored in
+/// shared memory), and the datastream is fed into this function in spans
+/// (usually referenced from file data).
+///
+/// One parameter of the correlation query is a correlation threshold.  It
+/// occupies the lower 5 bits of the query code.  It is an integer value.
+/// Scores higher than the threshold are passing scores.  The query score
+/// indicates the number of hits the query made on the file data.  The work
+/// is done by the Token Search Engine, above, which sub_corr_init() has set
+/// up for this query.
+    ot_int hits = 0;
+
+    *cursor += length;
+    while (--length >= 0) {
+        hits += sub_corr_push(*data++);
+    }
+    return hits;
 }
 
 
-ot_int sub_load_comparison(ot_int* cursor, ot_u8 data_byte) {
+ot_int sub_load_comparison(ot_int* cursor, const ot_u8* data, ot_int length) {
 /// Just loads comparison data, from the file system, into the local buffer.
 /// Comparison is limited to16 bytes per the Mode 2 Spec.
-    LOCAL_U8(*cursor) = data_byte;
-    (*cursor)++;
+    ot_memcpy(&LOCAL_U8(*cursor), (void*)data, length);
+    *cursor += length;
     return 0;
 }
 
 
-ot_int sub_load_return(ot_int* cursor, ot_u8 data_byte) {
+ot_int sub_load_return(ot_int* cursor, const ot_u8* data, ot_int length) {
 /// Just loads file data into the TX queue.
-    q_writebyte(&txq, data_byte);
-    (*cursor)++;
+    q_writestring(&txq, (ot_u8*)data, length);
+    *cursor += length;
     return 0;
 }
 
 
-ot_int sub_load_nonnull(ot_int* cursor, ot_u8 data_byte) {
+ot_int sub_load_nonnull(ot_int* cursor, const ot_u8* data, ot_int length) {
 /// Does Nothing: the nonnull comparison only requires that the specified file
 /// exists on the device.
     return 0;
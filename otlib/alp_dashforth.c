@@ -1,4 +1,4 @@
-/* Copyright 2010-2011 JP Norair
+/* Copyright 2010-2016 JP Norair
   *
   * Licensed under the OpenTag License, Version 1.0 (the "License");
   * you may not use this file except in compliance with the License.
@@ -16,32 +16,140 @@
 /**
   * @file       /otlib/alp_dashforth.c
   * @author     JP Norair
-  * @version    R100
-  * @date       1 July 2011
+  * @version    R101
+  * @date       20 Oct 2016
   * @brief      ALP to DASHForth applet extractor
   * @ingroup    ALP
   *
-  * Placeholder for future dashforth module ALP wrapper
-  * 
+  * The DASHForth ALP pushes applets to the system VM.  Commands (bit 7 of the
+  * command requests a response):
+  * <LI> 0 RUN:    [inlen][input][bytecode].  Runs the bytecode. </LI>
+  * <LI> 1 RUNF:   [isf_id][input].  Runs the applet stored in an ISF file,
+  *                which must be executable by the requester. </LI>
+  * <LI> 2 RESULT: no payload.  Reports the last applet. </LI>
+  * <LI> 3 KILL:   no payload.  Stops a running applet (root only). </LI>
+  *
+  * The response to all commands is [status][outlen][output], where status is
+  * a DF_Status (as s8).  Status 1 means the applet is still running on the
+  * DASHForth task, and RESULT will report it when it is done.
+  *
+  * Running requires user access.  Applets read files with the access of the
+  * requester, so the VM does not open any new holes in the file system.
+  *
   ******************************************************************************
   */
 
 
+#include <otstd.h>
 #include <otlib/alp.h>
 
 #if (   (OT_FEATURE(SERVER) == ENABLED) \
      && (OT_FEATURE(ALP) == ENABLED) \
      && (OT_FEATURE(DASHFORTH) == ENABLED) )
 
-#include "dashforth.h"
+#include <otlib/dashforth.h>
+#include <otlib/auth.h>
+#include <otlib/queue.h>
+#include <otsys/veelite.h>
 
-// DASHForth APL processor would go here.  It does not have to do much, just
-// push the applet to the VM.  I'm not sure if the directive cmd has any usage
-// for DASHForth aside from the response bit.
+#define DF_CMD_RUN      0
+#define DF_CMD_RUNF     1
+#define DF_CMD_RESULT   2
+#define DF_CMD_KILL     3
 
-// DASHForth manages its own user system, pusuant to the auth module, but
-// independently configurable.
 
-#endif
+static ot_int sub_result(alp_tmpl* alp, ot_int status) {
+    df_vm*  vm      = dashforth_vm();
+    ot_int  outlen  = (status == DF_DONE) ? vm->outlen : 0;
+
+    if (q_writespace(alp->outq) < (2+outlen)) {
+        outlen = 0;
+        if (q_writespace(alp->outq) < 2) {
+            return 0;
+        }
+    }
+    q_writebyte(alp->outq, (ot_u8)status);
+    q_writebyte(alp->outq, (ot_u8)outlen);
+    q_writestring(alp->outq, vm->out, outlen);
+    return 2 + outlen;
+}
+
+
+OT_WEAK ot_bool alp_proc_dashforth(alp_tmpl* alp, const id_tmpl* user_id) {
+    ot_int  data_in = INREC(alp, PLEN);
+    ot_u8   cmd_in  = INREC(alp, CMD);
+    ot_u8*  payload = alp->inq->getcursor;
+    ot_int  status;
+
+    alp->inq->getcursor += data_in;
+
+    switch (cmd_in & 0x7F) {
+        case DF_CMD_RUN:
+        case DF_CMD_RUNF: {
+            ot_int  inlen;
+            ot_u8*  code    = NULL;
+            ot_int  codelen = 0;
+            vlFILE* fp      = NULL;
 
+            status = DF_ERR_ACCESS;
+            if ((data_in < 1) || (auth_isuser(user_id) == False)) {
+                break;
+            }
+            if ((cmd_in & 0x7F) == DF_CMD_RUN) {
+                inlen   = payload[0];
+                code    = &payload[1+inlen];
+                codelen = data_in - 1 - inlen;
+                if (codelen <= 0) {
+                    status = DF_ERR_VERIFY;
+                    break;
+                }
+            }
+            else {
+                inlen   = data_in - 1;
+                fp      = ISF_open(payload[0], VL_ACCESS_X, user_id);
+                if (fp == NULL) {
+                    break;
+                }
+            }
+            status = dashforth_exec(code, codelen, fp, &payload[1], inlen,
+                                    user_id, OT_PARAM(DASHFORTH_SLICE), NULL);
+            if (fp != NULL) {
+                vl_close(fp);
+            }
+        } break;
+
+        case DF_CMD_RESULT:
+            status = DF_ERR_ACCESS;
+            if (auth_isroot(user_id) || df_isowner(dashforth_vm(), user_id)) {
+                status = dashforth_vm()->status;
+            }
+            break;
+
+        case DF_CMD_KILL:
+            status = DF_ERR_ACCESS;
+            if (auth_isroot(user_id)) {
+                dashforth_kill();
+                status = dashforth_vm()->status;
+            }
+            break;
+
+        default:
+            status = DF_ERR_VERIFY;
+            break;
+    }
+
+    alp->OUTREC(PLEN) = sub_result(alp, status);
+
+    if (cmd_in & 0x80) {
+        //Transform input cmd to error or data return variant for response
+        alp->OUTREC(CMD) ^= 0x80;
+    }
+    else {
+        alp->outq->putcursor -= alp->OUTREC(PLEN);
+    }
+
+    return True;
+}
+
+#endif
 
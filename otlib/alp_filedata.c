@@ -60,8 +60,23 @@
   *                         1011: Create New File (optional)
   *                         1100: Read File Header + Data
   *                         1101: Return File Header + Data
-  *                         1110: Restore File (optional)
+  *                         1110: Restore File from delta (optional)
   *                         1111: Return Error
+  *
+  * Vectored File Data: when File Block is 000, the Read (0100), Overwrite
+  * (0110) and Write (0111) operands take a list of tuples, each with its own
+  * file block:
+  *   Read:     [Block][ID][Offset:2][Span:2]
+  *   Write:    [Block][ID][Offset:2][Span:2][Data...]
+  * The response is a single record.  Reads return [Block][ID][Err][Offset:2]
+  * [Span:2][Data...] for each tuple, and writes return [Block][ID][Err].
+  * Consecutive tuples on the same file share one open and access check, and
+  * Overwrite truncates each file once, on its first tuple.  An Overwrite list
+  * can truncate up to 8 files, and tuples on further files return error 0x0A.
+  * Ring files are read by logical offset, and they can't be written with
+  * tuples (error 0x04).  Read data is clipped to the room left in the
+  * response, and a read tuple with no room left for its data returns error
+  * 0x0A.  Processing stops at the first tuple that has no room for its return.
   *</PRE>
   ******************************************************************************
   */
@@ -103,6 +118,8 @@ static ot_int sub_filecreate(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respon
 
 static ot_int sub_filerestore(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond, ot_u8 cmd_in, ot_int data_in );
 
+static ot_int sub_filevector(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond, ot_u8 cmd_in, ot_int data_in );
+
 //static ot_int sub_fileerror(ot_bool respond, alp_tmpl* alp, const id_tmpl* user_id );
 
 
@@ -141,7 +158,13 @@ OT_WEAK ot_bool alp_proc_filedata(alp_tmpl* alp, const id_tmpl* user_id) {
     //alp->inq->getcursor+= 4;
 
     // Return value is the number of bytes of output the command has produced
-    alp->OUTREC(PLEN) = cmd_fn[cmd_in & 0x0F](alp, user_id, (cmd_in & 0x80), cmd_in, data_in);
+    // Block 000 with a data read/write operand is the vectored form
+    if (((cmd_in & 0x70) == 0) && ((cmd_in & 0x0D) == 0x04 || (cmd_in & 0x0E) == 0x06)) {
+        alp->OUTREC(PLEN) = sub_filevector(alp, user_id, (cmd_in & 0x80), cmd_in, data_in);
+    }
+    else {
+        alp->OUTREC(PLEN) = cmd_fn[cmd_in & 0x0F](alp, user_id, (cmd_in & 0x80), cmd_in, data_in);
+    }
 
     if (cmd_in & 0x80) {
         //Transform input cmd to error or data return variant for response
@@ -239,17 +262,19 @@ static ot_int sub_fileheaders( alp_tmpl* alp, const id_tmpl* user_id, ot_u8 resp
     /// Only run if respond bit is set!
     if (respond) {
         while ((data_in > 0) && sub_qnotfull(respond, 6, alp->outq)) {
-            vaddr   header;
-            ot_bool allow_output = True;
+            vl_header_t header;
+            ot_bool     allow_output = True;
 
             data_in--;  // one for the file id
 
-            allow_output = (ot_bool)(vl_getheader_vaddr(&header, file_block, \
+            /// vl_getheader() reads through the veelite header cache, so the
+            /// length is current even if it has not been written back yet.
+            allow_output = (ot_bool)(vl_getheader(&header, file_block, \
                                     q_readbyte(alp->inq), VL_ACCESS_R, NULL) == 0);
             if (allow_output) {
-                q_writeshort_be(alp->outq, vworm_read(header + 4)); // id & mod
-                q_writeshort(alp->outq, vworm_read(header + 0)); // length
-                q_writeshort(alp->outq, vworm_read(header + 2)); // alloc
+                q_writeshort_be(alp->outq, header.idmod);   // id & mod
+                q_writeshort(alp->outq, header.length);     // length
+                q_writeshort(alp->outq, header.alloc);      // alloc
                 data_out += 6;
             }
         }
@@ -312,6 +337,12 @@ static ot_int sub_filedata(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond,
         /// 3. offset, span are adjusted to convey leftover data
         /// 4. miscellaneous write error occurs when vl_write fails
         if (file_mod) {
+#           if (OT_FEATURE(VLRING) == ENABLED)
+            if (vl_ring_fill(fp) >= 0) {
+                err_code = 0x04;    // Ring files are only written by vl_ring_append()
+                goto sub_filedata_senderror;
+            }
+#           endif
             if (offset >= fp->alloc) {
                 err_code = 0x07;
                 goto sub_filedata_senderror;
@@ -337,8 +368,17 @@ static ot_int sub_filedata(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond,
         /// 2. If inc_header param is set, include the file header in output
         /// 3. Negotiate boundaries for read -- no errors
         /// 4. Read out file data
+        /// Ring files are read as a window over the ring, where offset 0 is
+        /// the oldest byte and the length is the amount of data in the ring.
         else {
-            ot_u8 overhead = 5 << (inc_header != 0);
+            ot_u8   overhead    = 5 << (inc_header != 0);
+            ot_u16  flength     = fp->length;
+#           if (OT_FEATURE(VLRING) == ENABLED)
+            ot_int  ring_fill   = vl_ring_fill(fp);
+            if (ring_fill >= 0) {
+                flength = (ot_u16)ring_fill;
+            }
+#           endif
             
             if (overhead >= q_writespace(outq)) {
                 goto sub_filedata_overrun;
@@ -348,26 +388,43 @@ static ot_int sub_filedata(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond,
             // ID + Offset + Bytes Returned for Read Data
             // ID + Mod + Length + Alloc + Offset + Bytes Returned for Read Header & Data
             data_out += overhead;
+            // The open file has the current length, which may still be
+            // held in the veelite header cache (or the mirror).
             if (inc_header) {
-                q_writeshort_be(outq, vworm_read(header + 4));
-                q_writeshort(outq, vworm_read(header + 0));    // length
-                q_writeshort(outq, vworm_read(header + 2));    // alloc
+                q_writeshort_be(outq, fp->idmod);
+                q_writeshort(outq, flength);    // length
+                q_writeshort(outq, fp->alloc);  // alloc
             }
             else {
-                q_writebyte(outq, (vworm_read(header+4) & 0x00ff) );
+                q_writebyte(outq, (fp->idmod & 0x00ff) );
             }
             
-            if (offset >= fp->length) {
+            if (offset >= flength) {
                 span    = 0;
                 limit   = 0;
             }
-            else if (limit > fp->length) {
-                span    = fp->length - offset;
-                limit   = fp->length;
+            else if (limit > flength) {
+                span    = flength - offset;
+                limit   = flength;
             }
             q_writeshort(outq, offset);
             q_writeshort(outq, span);
 
+#           if (OT_FEATURE(VLRING) == ENABLED)
+            if (ring_fill >= 0) {
+                ot_int chunk;
+                for (; offset<limit; offset+=chunk, span-=chunk, data_out+=chunk) {
+                    chunk = q_writespace(outq) - 2;
+                    if (chunk <= 0) {
+                        goto sub_filedata_overrun;
+                    }
+                    if (chunk > (ot_int)(limit-offset)) {
+                        chunk = (ot_int)(limit-offset);
+                    }
+                    outq->putcursor += vl_ring_read(fp, offset, chunk, outq->putcursor);
+                }
+            }
+#           endif
             for (; offset<limit; offset+=2, span-=2, data_out+=2) {
                 if (2 >= q_writespace(outq)) {
                     goto sub_filedata_overrun;
@@ -433,6 +490,172 @@ static ot_int sub_filedata(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond,
 
 
 
+#define _VECTOR_TRUNCS      8       // files that one Overwrite list can truncate
+
+static ot_int sub_filevector(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond, ot_u8 cmd_in, ot_int data_in) {
+    ot_int      data_out    = 0;
+    vlFILE*     fp          = NULL;
+    ot_u16      file_ref    = 0;
+    ot_u16      trunc_ref[_VECTOR_TRUNCS];
+    ot_u8       truncs      = 0;
+    ot_u8       open_err    = 0;
+    ot_u8       file_mod    = ((cmd_in & 0x02) ? VL_ACCESS_W : VL_ACCESS_R);
+    ot_u8       insert_mode = (cmd_in & 0x01);
+    ot_queue*   inq         = alp->inq;
+    ot_queue*   outq        = alp->outq;
+
+    while (data_in >= 6) {
+        ot_u8   file_block  = q_readbyte(inq);
+        ot_u8   file_id     = q_readbyte(inq);
+        ot_u16  offset      = q_readshort(inq);
+        ot_u16  span        = q_readshort(inq);
+        ot_u8   err_code;
+
+        data_in -= 6;
+
+        /// 1. Open the file and check access, unless the last tuple was on
+        ///    the same file (block 0 is never valid, so file_ref 0 is none).
+        if (file_ref != (((ot_u16)file_block << 8) | file_id)) {
+            vaddr header;
+            vl_close(fp);
+            fp          = NULL;
+            file_ref    = ((ot_u16)file_block << 8) | file_id;
+            open_err    = vl_getheader_vaddr(&header, (vlBLOCK)file_block, file_id, file_mod, user_id);
+            if (open_err == 0) {
+                fp = vl_open_file(header);
+                if (fp == NULL) {
+                    open_err = 0xFF;
+                }
+            }
+        }
+        err_code = open_err;
+
+        /// 2a. Write: bulk store the span straight from the input queue,
+        ///     clipped to the file allocation and to the record data.  Ring
+        ///     files are only written by vl_ring_append().  Overwrite
+        ///     truncates a file on the first tuple that writes to it, so a
+        ///     file that is listed again keeps the data already written.
+        if (file_mod == VL_ACCESS_W) {
+            ot_uint store;
+
+            if (respond && ((data_out > (255-3)) || (q_writespace(outq) < 3))) {
+                break;
+            }
+            if (span > (ot_u16)data_in) {
+                span = (ot_u16)data_in;
+            }
+            store = span;
+            if (err_code == 0) {
+#               if (OT_FEATURE(VLRING) == ENABLED)
+                if (vl_ring_fill(fp) >= 0) {
+                    err_code = 0x04;
+                }
+                else
+#               endif
+                if (insert_mode == 0) {
+                    ot_u8 i = 0;
+                    while ((i < truncs) && (trunc_ref[i] != file_ref)) {
+                        i++;
+                    }
+                    if (i == truncs) {
+                        if (truncs == _VECTOR_TRUNCS) {
+                            err_code = 0x0A;
+                        }
+                        else {
+                            trunc_ref[truncs++] = file_ref;
+                            fp->length          = 0;
+                        }
+                    }
+                }
+            }
+            if (err_code == 0) {
+                if (offset >= fp->alloc) {
+                    err_code = 0x07;
+                }
+                else {
+                    if (store > (ot_uint)(fp->alloc - offset)) {
+                        store       = fp->alloc - offset;
+                        err_code    = 0x08;
+                    }
+                    if ((vl_storespan(fp, offset, store, inq->getcursor) != 0) && (err_code == 0)) {
+                        err_code = 0x09;
+                    }
+                }
+            }
+            inq->getcursor += span;
+            data_in        -= span;
+
+            if (respond) {
+                q_writebyte(outq, file_block);
+                q_writebyte(outq, file_id);
+                q_writebyte(outq, err_code);
+                data_out += 3;
+            }
+        }
+
+        /// 2b. Read: bulk load the span straight into the output queue,
+        ///     clipped to the file length and to the space left in the
+        ///     record.  The returned span is the amount actually read.  The
+        ///     7 byte return of each following tuple is kept free, so a tuple
+        ///     with no room left for data still reports the overrun (0x0A).
+        else if (respond) {
+            ot_int  ring_fill = -1;
+            ot_int  room = q_writespace(outq);
+            if (room > (255 - data_out)) {
+                room = 255 - data_out;
+            }
+            if (room < 7) {
+                break;
+            }
+            room -= 7 + (7 * (data_in / 6));
+            if (err_code == 0) {
+                ot_u16 flength = fp->length;
+#               if (OT_FEATURE(VLRING) == ENABLED)
+                ring_fill = vl_ring_fill(fp);
+                if (ring_fill >= 0) {
+                    flength = (ot_u16)ring_fill;
+                }
+#               endif
+                if (offset >= flength) {
+                    span = 0;
+                }
+                else if (span > (flength - offset)) {
+                    span = flength - offset;
+                }
+                if ((ot_int)span > room) {
+                    if (room > 0) {
+                        span        = (ot_u16)room;
+                    }
+                    else {
+                        span        = 0;
+                        err_code    = 0x0A;
+                    }
+                }
+            }
+            else {
+                span = 0;
+            }
+            q_writebyte(outq, file_block);
+            q_writebyte(outq, file_id);
+            q_writebyte(outq, err_code);
+            q_writeshort(outq, offset);
+            q_writeshort(outq, span);
+            if (span != 0) {
+                outq->putcursor += (ring_fill >= 0) ? \
+                                    vl_ring_read(fp, offset, span, outq->putcursor) : \
+                                    vl_loadspan(fp, offset, span, outq->putcursor);
+            }
+            data_out += 7 + span;
+        }
+    }
+
+    vl_close(fp);
+    return data_out;
+}
+
+
+
+
 static ot_int sub_filedelete( alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond, ot_u8 cmd_in, ot_int data_in ) {
     ot_int  data_out    = 0;
     vlBLOCK file_block  = (vlBLOCK)((cmd_in >> 4) & 0x07);
@@ -491,15 +714,53 @@ static ot_int sub_filecreate(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respon
 
 
 
-/// Not currently supported, always returns "unrestorable" error
+/// Restore patches each listed file from a binary delta (see vl_patch()).
+/// Input is [ID][Delta Length:2][Delta...] per file, and the response is
+/// [ID][Err] per file.  The error is 0x03 (unrestorable) if the file is not
+/// the base of the delta, or if restore is not supported, and 0x0B if the
+/// patched file does not match the result CRC, so the requester must rewrite
+/// the whole file.  A delta that is invalid or does not fit in the record is
+/// 0xFF.
 static ot_int sub_filerestore(alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond, ot_u8 cmd_in, ot_int data_in ) {
     ot_int  data_out    = 0;
-    //vlBLOCK file_block  = ((cmd_in >> 4) & 0x07);
+    vlBLOCK file_block  = (vlBLOCK)((cmd_in >> 4) & 0x07);
 
-    while ((data_in > 0) && sub_qnotfull(respond, 2, alp->outq)) {
-        ot_u8   err_code    = 0x03;
+    while ((data_in >= 3) && sub_qnotfull(respond, 2, alp->outq)) {
+        vaddr   header;
+        ot_u8   err_code;
         ot_u8   file_id     = q_readbyte(alp->inq);
-        data_in            -= 1;
+        ot_u16  span        = q_readshort(alp->inq);
+        data_in            -= 3;
+
+        if (span > (ot_u16)data_in) {
+            span        = (ot_u16)data_in;
+            err_code    = 0xFF;
+        }
+        else {
+            err_code = vl_getheader_vaddr(&header, file_block, file_id, VL_ACCESS_W, user_id);
+        }
+        if (err_code == 0) {
+#           if (OT_FEATURE(VLRESTORE) == ENABLED)
+            vlFILE* fp = vl_open_file(header);
+            err_code = 0xFF;
+            if (fp != NULL) {
+                err_code = vl_patch(fp, span, alp->inq->getcursor);
+                if (err_code == 1) {
+                    err_code = 0x03;
+                }
+                else if (err_code == 2) {
+                    err_code = 0x0B;
+                }
+                if ((vl_close(fp) != 0) && (err_code == 0)) {
+                    err_code = 0x09;
+                }
+            }
+#           else
+            err_code = 0x03;
+#           endif
+        }
+        alp->inq->getcursor    += span;
+        data_in                -= span;
 
         if (respond) {
             q_writebyte(alp->outq, file_id);
@@ -42,8 +42,6 @@
 
 #if ((OT_FEATURE(ALP) == ENABLED) && (OT_FEATURE(SERVER) == ENABLED))
 
-#define ALP_FUNCTIONS       5
-
 #if ALP(FILE_MGR)
 #   define ALP_FILESYSTEM   1
 #else
@@ -178,75 +176,123 @@ OT_WEAK ot_bool alp_ext_proc(alp_tmpl* alp, const id_tmpl* user_id) { return Tru
  * ========================================================================<BR>
  */
 
+/// The dispatch table has two parts:
+/// <LI> alp_map[256] maps every ALP ID to an index of alp_pool[].  IDs that 
+///      are not mapped (index 0) go to the default element, which is the ALP
+///      extension processor (if enabled) or else the null processor. </LI>
+/// <LI> alp_pool[] holds the elements: the default, the built-in processors,
+///      and ALP_HANDLERS slots for handlers registered at runtime. </LI>
+/// Both are initialized at compile-time, so there is no startup cost, and
+/// resolving any ID is one lookup no matter how many protocols are present.
+#if defined(OT_PARAM_ALP_HANDLERS)
+#   define ALP_HANDLERS         OT_PARAM_ALP_HANDLERS
+#else
+#   define ALP_HANDLERS         4
+#endif
+
+/// Runtime estimates are in kernel reserve units (ticks), the same as used
+/// by task->reserve.  ALP_RUNTIME_DEFAULT is the traditional estimate.
+#define ALP_RUNTIME_DEFAULT     32
+
+#if (ALP_EXT)
+#   define ALP_DEFAULT_FN       &alp_ext_proc
+#else
+#   define ALP_DEFAULT_FN       &alp_proc_null
+#endif
+
 typedef struct {
     alp_fn      callback;
     ot_queue*   appq;
+    ot_u8       runtime;
 } alp_elem_t;
 
-static const alp_elem_t null_elem = { &alp_proc_null, NULL };
+typedef enum {
+    ALP_IDX_default = 0,
+    ALP_IDX_null,
+#if ALP_FILESYSTEM
+    ALP_IDX_filedata,
+#endif
+#if ALP_SENSORS
+    ALP_IDX_sensor,
+#endif
+#if ALP_SECURITY
+    ALP_IDX_security,
+#endif
+#if ALP_LOGGER
+    ALP_IDX_logger,
+#endif
+#if ALP_DASHFORTH
+    ALP_IDX_dashforth,
+#endif
+    ALP_IDX_registered
+} alp_idx_t;
 
-#if (ALP_EXT)
-static const alp_elem_t ext_elem = { &alp_ext_proc, NULL };
+#define ALP_POOLSIZE    (ALP_IDX_registered + ALP_HANDLERS)
+
+static alp_elem_t alp_pool[ALP_POOLSIZE] = {
+    { ALP_DEFAULT_FN, NULL, ALP_RUNTIME_DEFAULT },
+    { &alp_proc_null, NULL, 1 },
+#if ALP_FILESYSTEM
+    { &alp_proc_filedata, NULL, ALP_RUNTIME_DEFAULT },
+#endif
+#if ALP_SENSORS
+    { &alp_proc_sensor, NULL, ALP_RUNTIME_DEFAULT },
+#endif
+#if ALP_SECURITY
+    { &alp_proc_sec, NULL, ALP_RUNTIME_DEFAULT },
+#endif
+#if ALP_LOGGER
+    { &alp_proc_logger, NULL, ALP_RUNTIME_DEFAULT },
+#endif
+#if ALP_DASHFORTH
+    { &alp_proc_dashforth, NULL, ALP_RUNTIME_DEFAULT },
 #endif
+};
 
-///@todo If this gets much bigger, it's better to have a binary tree ID search
-///      in order to conserve ROM/RAM space.
-static const alp_elem_t alp_table[ALP_FUNCTIONS] = {
+/// Built-in IDs that are not compiled-in map to the null processor, not to 
+/// the default, so they are not passed to the ALP extension processor.
 #if ALP_FILESYSTEM
-    { &alp_proc_filedata, NULL },
+#   define ALP_MAP_1    ALP_IDX_filedata
+#else
+#   define ALP_MAP_1    ALP_IDX_null
 #endif
 #if ALP_SENSORS
-    { &alp_proc_sensor, NULL },
+#   define ALP_MAP_2    ALP_IDX_sensor
 #else
-    { &alp_proc_null, NULL },
+#   define ALP_MAP_2    ALP_IDX_null
 #endif
 #if ALP_SECURITY
-    { &alp_proc_security, NULL },
+#   define ALP_MAP_3    ALP_IDX_security
 #else
-    { &alp_proc_null, NULL },
+#   define ALP_MAP_3    ALP_IDX_null
 #endif
 #if ALP_LOGGER
-    { &alp_proc_logger, NULL },
+#   define ALP_MAP_4    ALP_IDX_logger
 #else
-    { &alp_proc_null, NULL },
+#   define ALP_MAP_4    ALP_IDX_null
 #endif
 #if ALP_DASHFORTH
-    { &alp_proc_dashforth, NULL },
+#   define ALP_MAP_5    ALP_IDX_dashforth
 #else
-    { &alp_proc_null, NULL },
+#   define ALP_MAP_5    ALP_IDX_null
 #endif
+
+/// alp_builtin[] is kept so that unregistering a built-in ID can restore it.
+static const ot_u8 alp_builtin[6] = {
+    ALP_IDX_null, ALP_MAP_1, ALP_MAP_2, ALP_MAP_3, ALP_MAP_4, ALP_MAP_5
 };
 
+static ot_u8 alp_map[256] = {
+    [0] = ALP_IDX_null,
+    [1] = ALP_MAP_1,
+    [2] = ALP_MAP_2,
+    [3] = ALP_MAP_3,
+    [4] = ALP_MAP_4,
+    [5] = ALP_MAP_5,
+};
 
 
-static const alp_elem_t* sub_get_elem(ot_u8 alp_id) {
-    const alp_elem_t* element;
-    
-    if (alp_id == 0) {
-        element = &null_elem;
-    }
-    else {
-        alp_id--;
-
-#       if (ALP_API)
-        if (alp_id >= 0x80) {
-            alp_id -= (0x80 - (ALP_FUNCTIONS-ALP_API));
-        }
-#       endif
-        if (alp_id >= ALP_FUNCTIONS) {
-#           if (ALP_EXT)
-            element = &ext_elem;
-#           else
-            element = &null_elem;
-#           endif
-        }
-        else {
-            element = &(alp_table[alp_id]);
-        }
-    }
-    
-    return (const alp_elem_t*)element;
-}
+#define sub_get_elem(ALP_ID)    (&alp_pool[alp_map[(ot_u8)(ALP_ID)]])
 
 
 #ifndef EXTF_alp_proc
@@ -337,8 +383,60 @@ void alp_notify(alp_tmpl* alp, ot_sig callback) {
 #endif
 
 
-void alp_add_app(alp_tmpl* alp, ot_u8 alp_id, alp_fn callback, ot_queue appq) {
-///@todo To be completed when transformation of ALP is complete
+#ifndef EXTF_alp_register
+ot_int alp_register(ot_u8 alp_id, alp_fn callback, ot_queue* appq, ot_u8 runtime) {
+/// A handler already registered to this ID is updated in place.  Otherwise
+/// a free slot is taken from the registered part of the pool.  Registering a
+/// built-in ID overrides the built-in processor.
+    ot_int index;
+    
+    index = alp_map[alp_id];
+    if (index < ALP_IDX_registered) {
+        for (index=ALP_IDX_registered; index<ALP_POOLSIZE; index++) {
+            if (alp_pool[index].callback == NULL) {
+                break;
+            }
+        }
+        if (index >= ALP_POOLSIZE) {
+            return -1;
+        }
+    }
+    
+    alp_pool[index].callback    = (callback != NULL) ? callback : &alp_proc_null;
+    alp_pool[index].appq        = appq;
+    alp_pool[index].runtime     = (runtime != 0) ? runtime : ALP_RUNTIME_DEFAULT;
+    alp_map[alp_id]             = (ot_u8)index;
+    
+    return 0;
+}
+#endif
+
+
+#ifndef EXTF_alp_unregister
+void alp_unregister(ot_u8 alp_id) {
+/// The ID reverts to its built-in processor, if it has one, or else to the
+/// default element (usually ALP extension).
+    ot_int index;
+    
+    index = alp_map[alp_id];
+    if (index >= ALP_IDX_registered) {
+        alp_pool[index].callback    = NULL;
+        alp_pool[index].appq        = NULL;
+    }
+    alp_map[alp_id] = (alp_id < sizeof(alp_builtin)) ? alp_builtin[alp_id] : ALP_IDX_default;
+}
+#endif
+
+
+#ifndef EXTF_alp_get_runtime
+ot_u8 alp_get_runtime(ot_u8 alp_id) {
+    return sub_get_elem(alp_id)->runtime;
+}
+#endif
+
+
+void alp_add_app(alp_tmpl* alp, ot_u8 alp_id, alp_fn callback, ot_queue* appq) {
+    alp_register(alp_id, callback, appq, 0);
 }
 
 
@@ -966,27 +1064,10 @@ ot_bool alp_is_available(alp_tmpl* alp, ot_int length) {
   * @retval ot_u8       index of the processor routine
   * @ingroup ALP
   * @sa alp_proc
-  *
-  *
-  *//** @brief  Internal function for resolving the index of an app processor
-  * @param  alp_id      (ot_u8) ALP ID
-  * @retval ot_u8       index of the processor routine
-  * @ingroup ALP
-  * @sa alp_proc
-  *
-  *
   */
 #ifndef EXTF_alp_get_handle
 OT_WEAK ot_u8 alp_get_handle(ot_u8 alp_id) {
-#   if (ALP_API)
-    if (alp_id >= 0x80) {
-        alp_id -= (0x80-(ALP_FUNCTIONS-ALP_API));
-    }
-#   endif
-    if (alp_id > (ALP_FUNCTIONS+1)) {
-        alp_id = (ALP_FUNCTIONS+1);
-    }
-    return alp_id;
+    return alp_map[alp_id];
 }
 #endif
 
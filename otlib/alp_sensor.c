@@ -86,7 +86,7 @@ static ot_int sub_actuator( alp_tmpl* alp, const id_tmpl* user_id, ot_u8 respond
         if (actuator_file != 0) {
             fp = vl_open(VL_ISF_BLOCKID, actuator_file, VL_ACCESS_X, NULL);
             if (fp != NULL) {
-                error_code = vl_execute(fp, 1, &actuator_val);
+                error_code = vl_execute(fp, 1, &actuator_val, user_id);
                 vl_close(fp);
             }
         }
@@ -35,6 +35,10 @@
 #include <otlib/rand.h>
 #include <otsys/veelite.h>
 
+#if (OT_FEATURE(SERVER) && OT_FEATURE(M2))
+#   include <m2/transport.h>
+#endif
+
 #define _SEC_NL     OT_FEATURE(NLSECURITY)
 #define _SEC_DLL    OT_FEATURE(DLL_SECURITY)
 #define _SEC_ALL    (_SEC_NL && _SEC_DLL)
@@ -95,8 +99,15 @@ typedef struct OT_PACKED {
 #   include <oteax.h>
     typedef eax_ctx authctx_t;
 
+/// OT_PARAM_AUTH_KEYS sets the size of the key table.  A positive value (at
+/// least 2) is a static table.  A negative value selects the dynamic table, 
+/// which grows in chunks and is intended for gateways with many keys.
 #   undef   AUTH_NUM_ELEMENTS
-#   define  AUTH_NUM_ELEMENTS   3
+#   if defined(OT_PARAM_AUTH_KEYS)
+#       define AUTH_NUM_ELEMENTS    OT_PARAM_AUTH_KEYS
+#   else
+#       define AUTH_NUM_ELEMENTS    3
+#   endif
 
     static uint32_t dlls_nonce;
     static ot_uint  dlls_size   = 0;
@@ -108,12 +119,26 @@ typedef struct OT_PACKED {
     static authinfo_t   dlls_info[AUTH_NUM_ELEMENTS];
     
 #   elif (AUTH_NUM_ELEMENTS < 0)
+#   include <stdlib.h>
     // Dynamic Allocation:
     // Is allocated at time of initialization.
     // Must be at least 2 elements.
     // Items will only be cleared during deinit/delete.
-    static authctx_t* dlls_ctx = NULL;
-    static authinfo_t* dlls_info = NULL;
+    // - dlls_hash is an open-addressed (linear probe) table of key indices,
+    //   hashed on the 64 bit ID.  Empty slots are -1.  It is kept at least
+    //   2x the size of the key table, so probes are short.
+    // - dlls_heap is a min-heap of key indices, ordered by EOL.  Keys with 
+    //   EOL == 0 never expire, and they are not put into the heap.  
+    //   dlls_hpos tracks the heap position of each key (-1 if not in heap).
+#   define AUTH_CHUNK   64
+    static authctx_t*   dlls_ctx    = NULL;
+    static authinfo_t*  dlls_info   = NULL;
+    static ot_uint      dlls_alloc  = 0;
+    static ot_int*      dlls_hash   = NULL;
+    static ot_uint      dlls_hmask  = 0;
+    static ot_int*      dlls_heap   = NULL;
+    static ot_int*      dlls_hpos   = NULL;
+    static ot_uint      dlls_hsize  = 0;
     
 #   endif
 
@@ -180,6 +205,15 @@ static void sub_expand_key(void* rawkey, authctx_t* ctx) {
 }
 
 
+static void sub_keys_changed(void) {
+/// Query results depend on the access rights of the querying user, so cached
+/// results are dropped whenever a key is added, deleted, or expires.
+#   if (OT_FEATURE(SERVER) && OT_FEATURE(M2))
+    m2qp_flush_querycache();
+#   endif
+}
+
+
 
 ///@todo Bring this into OT Utils?
 static ot_bool sub_idcmp(const id_tmpl* user_id, uint64_t id) {
@@ -199,6 +233,245 @@ static ot_bool sub_authcmp(const id_tmpl* user_id, const id_tmpl* comp_id, ot_u8
 
 
 
+#if (AUTH_NUM_ELEMENTS < 0)
+/** Dynamic Key Table Subroutines <BR>
+  * ========================================================================<BR>
+  * Hash index on the 64 bit ID, and expiry heap on the EOL.
+  */
+static ot_uint sub_hash_slot(uint64_t id64) {
+    ot_u32 h;
+    h   = (ot_u32)id64 ^ (ot_u32)(id64 >> 32);
+    h  ^= h >> 16;
+    h  *= 0x45D9F3B;
+    h  ^= h >> 16;
+    return (ot_uint)h & dlls_hmask;
+}
+
+
+static ot_int sub_hash_find(uint64_t id64) {
+    ot_uint slot = sub_hash_slot(id64);
+    
+    while (dlls_hash[slot] >= 0) {
+        if (dlls_info[dlls_hash[slot]].id == id64) {
+            return dlls_hash[slot];
+        }
+        slot = (slot + 1) & dlls_hmask;
+    }
+    return -1;
+}
+
+
+static void sub_hash_insert(ot_int index) {
+    ot_uint slot = sub_hash_slot(dlls_info[index].id);
+    
+    while (dlls_hash[slot] >= 0) {
+        slot = (slot + 1) & dlls_hmask;
+    }
+    dlls_hash[slot] = index;
+}
+
+
+static ot_uint sub_hash_locate(ot_int index) {
+    ot_uint slot = sub_hash_slot(dlls_info[index].id);
+    
+    while (dlls_hash[slot] != index) {
+        slot = (slot + 1) & dlls_hmask;
+    }
+    return slot;
+}
+
+
+static void sub_hash_remove(ot_int index) {
+/// Backward-shift deletion: entries following the removed slot are moved back
+/// if the hole lies between their home slot and their present slot.  This
+/// keeps probe sequences unbroken without using tombstones.
+    ot_uint hole, scan, home;
+    
+    hole = sub_hash_locate(index);
+    scan = hole;
+    while (1) {
+        scan = (scan + 1) & dlls_hmask;
+        if (dlls_hash[scan] < 0) {
+            break;
+        }
+        home = sub_hash_slot(dlls_info[dlls_hash[scan]].id);
+        if (((scan - home) & dlls_hmask) >= ((scan - hole) & dlls_hmask)) {
+            dlls_hash[hole] = dlls_hash[scan];
+            hole            = scan;
+        }
+    }
+    dlls_hash[hole] = -1;
+}
+
+
+static void sub_heap_place(ot_uint pos, ot_int index) {
+    dlls_heap[pos]      = index;
+    dlls_hpos[index]    = (ot_int)pos;
+}
+
+
+static void sub_heap_fix(ot_uint pos) {
+    ot_int  index   = dlls_heap[pos];
+    ot_u32  eol     = dlls_info[index].EOL;
+    ot_uint next;
+    
+    // Sift up
+    while (pos > 0) {
+        next = (pos - 1) >> 1;
+        if (dlls_info[dlls_heap[next]].EOL <= eol) {
+            break;
+        }
+        sub_heap_place(pos, dlls_heap[next]);
+        pos = next;
+    }
+    
+    // Sift down
+    while (1) {
+        next = (pos << 1) + 1;
+        if (next >= dlls_hsize) {
+            break;
+        }
+        if (((next+1) < dlls_hsize)
+        && (dlls_info[dlls_heap[next+1]].EOL < dlls_info[dlls_heap[next]].EOL)) {
+            next++;
+        }
+        if (eol <= dlls_info[dlls_heap[next]].EOL) {
+            break;
+        }
+        sub_heap_place(pos, dlls_heap[next]);
+        pos = next;
+    }
+    
+    sub_heap_place(pos, index);
+}
+
+
+static void sub_heap_remove(ot_int index) {
+    ot_int pos = dlls_hpos[index];
+    
+    if (pos >= 0) {
+        dlls_hpos[index] = -1;
+        dlls_hsize--;
+        if ((ot_uint)pos != dlls_hsize) {
+            sub_heap_place(pos, dlls_heap[dlls_hsize]);
+            sub_heap_fix(pos);
+        }
+    }
+}
+
+
+static void sub_heap_insert(ot_int index) {
+    if (dlls_info[index].EOL != 0) {
+        sub_heap_place(dlls_hsize, index);
+        sub_heap_fix(dlls_hsize++);
+    }
+}
+
+
+static void sub_sweep_keys(void) {
+/// Expired keys are popped from the heap and their contexts are wiped, same as
+/// with the static table.  The key stays in the hash, as a guest, until it is
+/// deleted or replaced.  Each key is swept at most once, so cost is amortized.
+    ot_u32  now;
+    ot_int  index;
+    
+    if (dlls_hsize != 0) {
+        now = time_get_utc();
+        while ((dlls_hsize != 0) && (dlls_info[dlls_heap[0]].EOL <= now)) {
+            index = dlls_heap[0];
+            sub_heap_remove(index);
+            memset((void*)&dlls_ctx[index], 0, sizeof(authctx_t));
+            dlls_info[index].mflags = AUTHMOD_guest;
+            sub_keys_changed();
+        }
+    }
+}
+
+
+static ot_bool sub_grow_tables(void) {
+/// Grow the key table by AUTH_CHUNK elements, and rehash if the hash table 
+/// needs to grow as well.  Key contexts are moved manually rather than via
+/// realloc, so that no key material is left behind in freed memory.
+    ot_uint     new_alloc;
+    ot_uint     hash_size;
+    ot_uint     i;
+    void*       newptr;
+    
+    // Key indices are ot_int and the hash table is kept at 2x the key table,
+    // so the table must stay within 1/4 of the ot_uint range.
+    new_alloc = dlls_alloc + AUTH_CHUNK;
+    if (new_alloc > 16384) {
+        return False;
+    }
+    
+    newptr = malloc(new_alloc * sizeof(authctx_t));
+    if (newptr == NULL) {
+        return False;
+    }
+    if (dlls_ctx != NULL) {
+        memcpy(newptr, dlls_ctx, dlls_alloc * sizeof(authctx_t));
+        memset(dlls_ctx, 0, dlls_alloc * sizeof(authctx_t));
+        free(dlls_ctx);
+    }
+    dlls_ctx = (authctx_t*)newptr;
+    
+    newptr = realloc(dlls_info, new_alloc * sizeof(authinfo_t));
+    if (newptr == NULL) {
+        return False;
+    }
+    dlls_info = (authinfo_t*)newptr;
+    
+    newptr = realloc(dlls_heap, new_alloc * sizeof(ot_int));
+    if (newptr == NULL) {
+        return False;
+    }
+    dlls_heap = (ot_int*)newptr;
+    
+    newptr = realloc(dlls_hpos, new_alloc * sizeof(ot_int));
+    if (newptr == NULL) {
+        return False;
+    }
+    dlls_hpos = (ot_int*)newptr;
+    for (i=dlls_alloc; i<new_alloc; i++) {
+        dlls_hpos[i] = -1;
+    }
+    
+    for (hash_size=1; hash_size<(new_alloc<<1); hash_size<<=1);
+    if ((hash_size-1) != dlls_hmask) {
+        newptr = realloc(dlls_hash, hash_size * sizeof(ot_int));
+        if (newptr == NULL) {
+            return False;
+        }
+        dlls_hash   = (ot_int*)newptr;
+        dlls_hmask  = hash_size - 1;
+        for (i=0; i<hash_size; i++) {
+            dlls_hash[i] = -1;
+        }
+        for (i=2; i<dlls_size; i++) {
+            sub_hash_insert(i);
+        }
+    }
+    
+    dlls_alloc = new_alloc;
+    return True;
+}
+#endif
+
+
+#if (_SEC_ANY)
+static void sub_set_eol(ot_int index, ot_u32 eol) {
+#   if (AUTH_NUM_ELEMENTS < 0)
+    sub_heap_remove(index);
+    dlls_info[index].EOL = eol;
+    sub_heap_insert(index);
+#   else
+    dlls_info[index].EOL = eol;
+#   endif
+}
+#endif
+
+
+
 
 
 
@@ -226,8 +499,10 @@ void auth_init(void) {
     /// - Initialize the table in 64 unit chunks.
     if ((dlls_info == NULL) || (dlls_ctx == NULL)) {
         auth_deinit();
-        
-        ///@todo do the actual initialization.  Will be done through libjudy.
+        if (sub_grow_tables() == False) {
+            auth_deinit();
+            return;
+        }
     }
     
 #   endif
@@ -278,14 +553,25 @@ void auth_deinit(void) {
 #   elif (AUTH_NUM_ELEMENTS < 0)
     // Clear memory elements and free them.
     if (dlls_info != NULL) {
-        memset(dlls_info, 0, sizeof(authinfo_t) * dlls_size);
+        memset(dlls_info, 0, sizeof(authinfo_t) * dlls_alloc);
         free(dlls_info);
+        dlls_info = NULL;
     }
     if (dlls_ctx != NULL) {
-        memset(dlls_ctx, 0, sizeof(authctx_t) * dlls_size);
+        memset(dlls_ctx, 0, sizeof(authctx_t) * dlls_alloc);
         free(dlls_ctx);
+        dlls_ctx = NULL;
     }
-    dlls_size = 0;
+    free(dlls_hash);
+    free(dlls_heap);
+    free(dlls_hpos);
+    dlls_hash   = NULL;
+    dlls_heap   = NULL;
+    dlls_hpos   = NULL;
+    dlls_hmask  = 0;
+    dlls_hsize  = 0;
+    dlls_alloc  = 0;
+    dlls_size   = 0;
     
 #   endif
 }
@@ -416,73 +702,168 @@ ot_int auth_decrypt(void* nonce, void* data, ot_uint datalen, ot_uint key_index)
 
 
 
-static ot_int sub_crypt_q(ot_queue* q, ot_uint key_index, bool enc) {
 #if (_SEC_ANY)
-#ifdef __C2000__
-    ot_u32  nonce[2] = {0, 0};
+/// Bounce buffer for segments that cannot be processed where they are.  It
+/// holds a whole M2 frame payload plus the tag.
+#define AUTH_SGBUF_SIZE     (256+4)
+
+static ot_u8 sub_getoctet(void* base, ot_uint offset) {
+#   ifdef __C2000__
+    return (ot_u8)__byte((int*)base, offset);
+#   else
+    return ((ot_u8*)base)[offset];
+#   endif
+}
+
+static void sub_putoctet(void* base, ot_uint offset, ot_u8 octet) {
+#   ifdef __C2000__
+    __byte((int*)base, offset) = octet;
+#   else
+    ((ot_u8*)base)[offset] = octet;
+#   endif
+}
+
+static void sub_moveoctets(void* dst, ot_uint dst_offset, void* src, ot_uint src_offset, ot_uint length) {
+    while (length-- != 0) {
+        sub_putoctet(dst, dst_offset++, sub_getoctet(src, src_offset++));
+    }
+}
+#endif
+
+
+static ot_int sub_crypt_sg(authseg_t* nonce, authseg_t* header, authseg_t* payload, 
+                        ot_uint segments, authseg_t* tag, ot_uint key_index, ot_bool enc) {
+#if (_SEC_ANY)
+    /// The EAX driver works on whole messages: [payload][tag] in one buffer.
+    /// A single payload segment followed directly by its tag is processed 
+    /// in place.  Otherwise, the segments are gathered into a bounce buffer, 
+    /// processed, and scattered back.
     ot_int (*EAXdrv_fn)(void*, void*, ot_uint, void*);
-    ot_u32* data;
-    ot_int length;
-    int rc;
-    int i;
-    
-    // Extract the nonce, and zero-pad it.
-    nonce[0] = ((ot_u32*)q->front)[0];
-    nonce[1] = ((ot_u32*)q->front)[1];
-    __byte((int*)nonce, 7) = 0;
-    q->getcursor = 7;
-    
-    // Shift the queue 3 bytes forward.  This makes it 32bit aligned.  It has
-    // the secondary benefit of guaranteeing that the last word is zero padded,
-    // without violating any data boundaries.
-    length  = q_span(q);
-    data    = &((ot_u32*)q->front)[1];
-    for (i=0; i<length; i++) {
-        __byte((int*)data, i) = __byte((int*)data, i+3);
-    }
-    __byte((int*)data, i)   = 0;
-    __byte((int*)data, i+1) = 0;
-    __byte((int*)data, i+2) = 0;
-    
-    // Run cryptography, then put everything back into original alignment.
-    if (enc) {
-        EAXdrv_fn = &EAXdrv_encrypt;
+    ot_u32  nonce_buf[2] = {0, 0};
+    ot_u8*  msg;
+    ot_uint msglen;
+    ot_int  retval;
+    ot_int  i;
+
+    if (key_index >= dlls_size) {
+        return -1;
     }
-    else {
-        EAXdrv_fn = &EAXdrv_decrypt;
-        length -= 4;
+    
+    /// The driver has no associated-data input, so headers are not supported.
+    if ((header != NULL) && (header->length != 0)) {
+        return -1;
     }
-    rc = sub_do_crypto(nonce, data, length, key_index, EAXdrv_fn);
     
-    for(i=length+3; i>=0; i--) {
-        __byte((int*)data, i+3) = __byte((int*)data, i);
+    /// Nonce is copied out, so it can be aligned and zero-padded to 8 bytes.
+    sub_moveoctets(nonce_buf, 0, nonce->base, nonce->offset, 7);
+    
+    EAXdrv_fn = enc ? &EAXdrv_encrypt : &EAXdrv_decrypt;
+    
+    if ((segments == 1) 
+     && (tag->base == payload->base) 
+     && (tag->offset == (payload->offset + payload->length))
+#       ifdef __C2000__
+     && ((payload->offset & 1) == 0)
+#       endif
+    ) {
+#       ifdef __C2000__
+        msg = (ot_u8*)payload->base + (payload->offset >> 1);
+#       else
+        msg = (ot_u8*)payload->base + payload->offset;
+#       endif
+        retval = EAXdrv_fn(nonce_buf, msg, payload->length, (void*)&dlls_ctx[key_index]);
+        return (retval != 0) ? -2 : 4;
     }
-    __byte((int*)data, 0) = __byte((int*)nonce, 4);
-    __byte((int*)data, 1) = __byte((int*)nonce, 5);
-    __byte((int*)data, 2) = __byte((int*)nonce, 6);
     
-    return rc;
+    {   static ot_u8 sg_buf[AUTH_SGBUF_SIZE];
+        authseg_t* seg;
+        
+        msglen = 0;
+        for (i=0, seg=payload; i<segments; i++, seg++) {
+            if ((msglen + seg->length) > (AUTH_SGBUF_SIZE-4)) {
+                ot_memset(sg_buf, 0, msglen);
+                return -1;
+            }
+            sub_moveoctets(sg_buf, msglen, seg->base, seg->offset, seg->length);
+            msglen += seg->length;
+        }
+        if (enc == False) {
+            sub_moveoctets(sg_buf, msglen, tag->base, tag->offset, 4);
+        }
+        
+        retval = EAXdrv_fn(nonce_buf, sg_buf, msglen, (void*)&dlls_ctx[key_index]);
+        
+        /// Scatter back: plain or cipher data, and the new tag on encrypt.  
+        /// Failed decryption leaves the segments untouched.
+        if ((retval == 0) || enc) {
+            msglen = 0;
+            for (i=0, seg=payload; i<segments; i++, seg++) {
+                sub_moveoctets(seg->base, seg->offset, sg_buf, msglen, seg->length);
+                msglen += seg->length;
+            }
+            if (enc) {
+                sub_moveoctets(tag->base, tag->offset, sg_buf, msglen, 4);
+            }
+        }
+
+        /// The bounce buffer is static, so don't leave the data or tag in it.
+        /// msglen is the payload length on both paths, and the tag follows.
+        ot_memset(sg_buf, 0, msglen+4);
+    }
+    return (retval != 0) ? -2 : 4;
     
 #else
-    ot_u8* nonce;
-    ot_u8* data;
-    ot_uint length;
-    ot_int (*EAXdrv_fn)(void*, void*, ot_uint, void*);
+    return -1;
+#endif
+}
 
-    nonce   = q_markbyte(q, 7);
-    length  = q_span(q);
-    data    = q->getcursor; //q_markbyte(q, length);
 
-    if (enc) {
-        EAXdrv_fn = &EAXdrv_encrypt;
-    }
-    else {
-        EAXdrv_fn = &EAXdrv_decrypt;
-        length -= 4;
+
+#ifndef EXTF_auth_encrypt_sg
+ot_int auth_encrypt_sg(authseg_t* nonce, authseg_t* header, authseg_t* payload, 
+                        ot_uint segments, authseg_t* tag, ot_uint key_index) {
+    return sub_crypt_sg(nonce, header, payload, segments, tag, key_index, True);
+}
+#endif
+
+
+
+#ifndef EXTF_auth_decrypt_sg
+ot_int auth_decrypt_sg(authseg_t* nonce, authseg_t* header, authseg_t* payload, 
+                        ot_uint segments, authseg_t* tag, ot_uint key_index) {
+    return sub_crypt_sg(nonce, header, payload, segments, tag, key_index, False);
+}
+#endif
+
+
+
+static ot_int sub_crypt_q(ot_queue* q, ot_uint key_index, bool enc) {
+#if (_SEC_ANY)
+    /// The queue holds a 7 byte nonce, then the payload, then (on decrypt) 
+    /// the 4 byte tag.  All three are referenced as segments of the queue 
+    /// buffer, so the payload is processed in place.
+    authseg_t nonce;
+    authseg_t payload;
+    authseg_t tag;
+    
+    nonce.offset    = (ot_uint)(q->getcursor - q->front);
+    nonce.base      = (void*)q->front;
+    nonce.length    = 7;
+    q->getcursor   += 7;
+    
+    payload.base    = nonce.base;
+    payload.offset  = nonce.offset + 7;
+    payload.length  = q_span(q);
+    if (enc == false) {
+        payload.length -= 4;
     }
     
-    return sub_do_crypto(nonce, data, length, key_index, EAXdrv_fn);
-#endif
+    tag.base        = nonce.base;
+    tag.offset      = payload.offset + payload.length;
+    tag.length      = 4;
+    
+    return sub_crypt_sg(&nonce, NULL, &payload, 1, &tag, key_index, (ot_bool)enc);
+    
 #else
     return -1;
 #endif
@@ -590,6 +971,7 @@ static ot_int sub_search_user(uint64_t id64, authmod_t reqmod) {
             if ((dlls_info[i].EOL != 0) && (dlls_info[i].EOL <= time_get_utc())) {
                 memset((void*)&dlls_ctx[i], 0, sizeof(authctx_t));
                 dlls_info[i].mflags = AUTHMOD_guest;
+                sub_keys_changed();
                 continue;
             }
             // Key is found, and valid
@@ -598,8 +980,19 @@ static ot_int sub_search_user(uint64_t id64, authmod_t reqmod) {
     }
     
 #elif (AUTH_NUM_ELEMENTS < 0)
-    ///@todo Dynamic Allocation: uses libjudy
-    return -1;
+    // Hashed Search
+    // - Expired keys are swept from the expiry heap first, so there is no
+    //   need to check the EOL of the found key.
+    // - Compare mod, as with linear search.
+    ot_int i;
+    
+    if (dlls_size > 2) {
+        sub_sweep_keys();
+        i = sub_hash_find(id64);
+        if ((i >= 0) && ((dlls_info[i].mflags & 0x3F) >= reqmod)) {
+            return i;
+        }
+    }
     
 #endif
     // returns guest by default
@@ -741,17 +1134,12 @@ ot_u8 auth_check(ot_u8 req_mod, ot_u8 rw_mod, const id_tmpl* user_id) {
 
     user_type = auth_search_user(user_id, req_mod);
     if (user_type >= 0) {
-#   if (AUTH_NUM_ELEMENTS >= 0)
         if (user_type < dlls_size) {
             if (dlls_info[user_type].mflags == AUTHMOD_root) {
                 return rw_mod;
             }
         }
         return test;
-
-#   elif (AUTH_NUM_ELEMENTS < 0)
-    ///@todo implement this
-#   endif
     }
 
     return 0;
@@ -790,12 +1178,40 @@ static ot_u8 sub_add_key(ot_uint* key_index, keytype_t type, ot_u32 lifetime, vo
         dlls_info[*key_index].mflags = AUTHMOD_user; ///@todo set this to appropriate bits.
         dlls_info[*key_index].EOL    = time_get_utc() + lifetime;
         sub_expand_key(keydata, &dlls_ctx[*key_index]);
+        sub_keys_changed();
         
         return 0;
     }
 
 #elif (AUTH_NUM_ELEMENTS < 0)
-    ///@todo implement this
+    /// Dynamic allocation
+    /// - If the ID is already in the table (as an expired key), replace it.
+    /// - Else grow the table if needed, and add it to the end of the table.
+    ot_int index;
+    
+    if (dlls_info == NULL) {
+        return 255;
+    }
+    
+    index = sub_hash_find(id64);
+    if (index < 0) {
+        if ((dlls_size >= dlls_alloc) && (sub_grow_tables() == False)) {
+            return 255;
+        }
+        index                   = dlls_size++;
+        dlls_info[index].id     = id64;
+        dlls_info[index].EOL    = 0;
+        dlls_hpos[index]        = -1;
+        sub_hash_insert(index);
+    }
+    
+    *key_index              = index;
+    dlls_info[index].mflags = AUTHMOD_user; ///@todo set this to appropriate bits.
+    sub_set_eol(index, time_get_utc() + lifetime);
+    sub_expand_key(keydata, &dlls_ctx[index]);
+    sub_keys_changed();
+    
+    return 0;
     
 #endif
 #endif
@@ -835,7 +1251,7 @@ ot_u8 auth_refresh_key(ot_uint* key_index, ot_u32 new_lifetime, const id_tmpl* u
     
     status = auth_find_keyindex(key_index, user_id);
     if (status == 0) {
-        dlls_info[*key_index].EOL = time_get_utc() + new_lifetime;
+        sub_set_eol(*key_index, time_get_utc() + new_lifetime);
     }
     
     return status;
@@ -923,13 +1339,37 @@ ot_u8 auth_delete_key(ot_uint key_index) {
             memcpy(&dlls_info[i], &dlls_info[i+1], sizeof(authinfo_t));
             memcpy(&dlls_ctx[i], &dlls_ctx[i+1], sizeof(authctx_t));
         }
+        sub_keys_changed();
         
         return 0;
     }
     
 #   elif (AUTH_NUM_ELEMENTS < 0)
-    ///@todo implement this
-    return 255;
+    // The last key is moved into the deleted slot, so the hash and the 
+    // heap only need to be re-pointed for that one key.
+    {   ot_int last;
+    
+        sub_heap_remove(key_index);
+        sub_hash_remove(key_index);
+        memset((void*)&dlls_ctx[key_index], 0, sizeof(authctx_t));
+        
+        last = --dlls_size;
+        if ((ot_int)key_index != last) {
+            memcpy(&dlls_info[key_index], &dlls_info[last], sizeof(authinfo_t));
+            memcpy(&dlls_ctx[key_index], &dlls_ctx[last], sizeof(authctx_t));
+            memset((void*)&dlls_ctx[last], 0, sizeof(authctx_t));
+            
+            dlls_hash[sub_hash_locate(last)] = key_index;
+            if (dlls_hpos[last] >= 0) {
+                sub_heap_place(dlls_hpos[last], key_index);
+                dlls_hpos[last] = -1;
+            }
+        }
+        dlls_info[last].mflags = (1<<7);    //AUTH_KEYFLAGS_INVALID;
+        sub_keys_changed();
+        
+        return 0;
+    }
     
 #   else    
     return 255;
@@ -947,7 +1387,7 @@ keytype_t auth_get_key(void** keydata, ot_uint key_index) {
         return KEYTYPE_none;
     }
     
-#   if (AUTH_NUM_ELEMENTS >= 0)
+#   if (AUTH_NUM_ELEMENTS != 0)
     if (key_index < dlls_size) {
         if (dlls_info[key_index].mflags < (1<<7)) {
             *keydata = (void*)&dlls_ctx[key_index];
@@ -958,10 +1398,6 @@ keytype_t auth_get_key(void** keydata, ot_uint key_index) {
     *keydata = NULL;
     return KEYTYPE_none;
     
-#   elif (AUTH_NUM_ELEMENTS < 0)
-    ///@todo implement this
-    return KEYTYPE_none;
-    
 #   else    
     return KEYTYPE_none;
 #   endif
@@ -31,7 +31,8 @@
 
 
 #define ALP_ENABLED (OT_FEATURE(NDEF) || OT_FEATURE(ALP) || OT_FEATURE(MPIPE))
-#define TXRX_SIZE   ((M2_PARAM_MAXFRAME + (M2_PARAM_MAXFRAME & 1)) * (OT_FEATURE_SERVER == ENABLED))
+#define TXRX_FRAMES ((M2_FEATURE(MULTIFRAME) == ENABLED) ? M2_PARAM_MFPP : 1)
+#define TXRX_SIZE   ((M2_PARAM_MAXFRAME + (M2_PARAM_MAXFRAME & 1)) * TXRX_FRAMES * (OT_FEATURE_SERVER == ENABLED))
 #define ALP_SIZE    ((OT_PARAM_BUFFER_SIZE - (TXRX_SIZE*2))/2)
 
 #if ((ALP_SIZE < 0) && ALP_ENABLED)
@@ -0,0 +1,600 @@
+/* Copyright 2016 JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+/**
+  * @file       /otlib/dashforth.c
+  * @author     JP Norair
+  * @version    R100
+  * @date       20 Oct 2016
+  * @brief      DASHForth applet VM
+  * @ingroup    DASHForth
+  *
+  * The interpreter loop is written once, with macros for the instruction
+  * labels and for dispatch.  With GCC, dispatch is threaded: each instruction
+  * jumps straight to the next one through a label table, which saves the
+  * bounds check and the shared branch of a switch.  Other compilers get the
+  * switch.
+  *
+  * The verifier makes the interpreter cheap: after it passes, pc can only be
+  * the start of an instruction or the end of the code, where a HALT sentinel
+  * sits.  So the interpreter never checks pc, and the only runtime checks are
+  * the stacks, the buffers, and the budget.
+  *
+  ******************************************************************************
+  */
+
+#include <otstd.h>
+
+#if (OT_FEATURE(DASHFORTH) == ENABLED)
+
+#include <otlib/dashforth.h>
+#include <otlib/auth.h>
+#include <otlib/memcpy.h>
+#include <otsys/veelite.h>
+
+
+#if (OT_PARAM(DASHFORTH_CODESIZE) > 4096)
+#   error "OT_PARAM_DASHFORTH_CODESIZE must be 4096 or less"
+#endif
+#if ((OT_PARAM(DASHFORTH_DSTACK) > 255) || (OT_PARAM(DASHFORTH_RSTACK) > 255) \
+  || (OT_PARAM(DASHFORTH_INSIZE) > 255) || (OT_PARAM(DASHFORTH_OUTSIZE) > 255) \
+  || (OT_PARAM(DASHFORTH_VARS) > 255))
+#   error "DASHForth stacks, buffers and variables must have 255 entries or less"
+#endif
+
+#if defined(__GNUC__)
+#   define _DF_THREADED     1
+#else
+#   define _DF_THREADED     0
+#endif
+
+
+/// Instruction lengths (opcode + immediate).  0 is an invalid opcode.
+static const ot_u8 df_oplen[DF_OPCODES] = {
+    1, 2, 3, 5, 1, 0, 0, 0,     // 0x00: HALT LIT8 LIT16 LIT32 YIELD
+    1, 1, 1, 1, 1, 1, 1, 1,     // 0x08: DUP DROP SWAP OVER ROT >R R> R@
+    1, 1, 1, 1, 1, 1, 1, 1,     // 0x10: + - * / MOD NEGATE ABS MIN
+    1, 1, 1, 1, 1, 1, 1, 0,     // 0x18: MAX AND OR XOR INVERT LSHIFT RSHIFT
+    1, 1, 1, 1, 0, 0, 0, 0,     // 0x20: = < > 0=
+    3, 3, 3, 1, 3, 0, 0, 0,     // 0x28: JMP JZ CALL RET NEXT
+    2, 2, 0, 0, 0, 0, 0, 0,     // 0x30: V@ V!
+    1, 1, 1, 1, 1, 0, 0, 0,     // 0x38: INLEN IN@ OUT8 OUT16 OUT32
+    1, 1, 1                     // 0x40: FLEN FREAD8 FREAD16
+};
+
+
+static ot_u16 sub_imm16(const ot_u8* imm) {
+    return ((ot_u16)imm[0] << 8) | (ot_u16)imm[1];
+}
+
+
+static ot_bool sub_isop(const ot_u8* opmap, ot_uint addr) {
+/// True if addr is the start of an instruction, or the end of the code.
+    return (ot_bool)((opmap[addr >> 3] >> (addr & 7)) & 1);
+}
+
+
+static vlFILE* sub_fopen(df_vm* vm, vlFILE** fp, ot_u8* fid, df_cell isf_id) {
+/// One ISF file stays open through a df_run() call, so that loops over a
+/// file do not open it each time.
+    if ((isf_id < 0) || (isf_id > 255)) {
+        return NULL;
+    }
+    if ((*fp != NULL) && (*fid == (ot_u8)isf_id)) {
+        return *fp;
+    }
+    if (*fp != NULL) {
+        vl_close(*fp);
+    }
+    *fid    = (ot_u8)isf_id;
+    *fp     = ISF_open((ot_u8)isf_id, VL_ACCESS_R, vm->user_id);
+    return *fp;
+}
+
+
+static ot_int sub_flength(vlFILE* fp) {
+/// Ring files are read by logical offset, so their length is the ring fill
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_int fill = vl_ring_fill(fp);
+    if (fill >= 0) {
+        return fill;
+    }
+#   endif
+    return (ot_int)fp->length;
+}
+
+
+static ot_u8 sub_fbyte(vlFILE* fp, ot_uint offset) {
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_u8 byte;
+    if (vl_ring_read(fp, offset, 1, &byte) != 0) {
+        return byte;
+    }
+#   endif
+#   if !defined(__C2000__)
+    ot_uni16 scratch;
+    scratch.ushort = vl_read(fp, offset & ~1);
+    return scratch.ubyte[offset & 1];
+#   else
+    return (ot_u8)vl_read(fp, offset);
+#   endif
+}
+
+
+
+
+/** VM functions <BR>
+  * ========================================================================<BR>
+  */
+
+#ifndef EXTF_df_verify
+OT_WEAK ot_int df_verify(const ot_u8* code, ot_int length, ot_u8* opmap) {
+    ot_int pc = 0;
+
+    if ((length <= 0) || (length > OT_PARAM(DASHFORTH_CODESIZE))) {
+        return DF_ERR_VERIFY;
+    }
+
+    // Pass 1: opcodes are valid and instructions fit in the code.  Each
+    // instruction start, and the end of the code, is marked in the opmap.
+    memset(opmap, 0, (length >> 3) + 1);
+    while (pc < length) {
+        ot_u8 op = code[pc];
+        if ((op >= DF_OPCODES) || (df_oplen[op] == 0)) {
+            return DF_ERR_VERIFY;
+        }
+        if ((pc + df_oplen[op]) > length) {
+            return DF_ERR_VERIFY;
+        }
+        opmap[pc >> 3] |= (1 << (pc & 7));
+        pc += df_oplen[op];
+    }
+    opmap[pc >> 3] |= (1 << (pc & 7));
+
+    // Pass 2: branches land on instructions, variables are in range
+    for (pc=0; pc<length; pc+=df_oplen[code[pc]]) {
+        switch (code[pc]) {
+            case DF_JMP:
+            case DF_JZ:
+            case DF_CALL:
+            case DF_NEXT: {
+                ot_uint addr = sub_imm16(&code[pc+1]);
+                if ((addr > (ot_uint)length) || !sub_isop(opmap, addr)) {
+                    return DF_ERR_VERIFY;
+                }
+            } break;
+
+            case DF_VFETCH:
+            case DF_VSTORE:
+                if (code[pc+1] >= OT_PARAM(DASHFORTH_VARS)) {
+                    return DF_ERR_VERIFY;
+                }
+                break;
+
+            default: break;
+        }
+    }
+
+    return DF_DONE;
+}
+#endif
+
+
+static ot_int sub_install(df_vm* vm, ot_int length) {
+/// The code is already in vm->code: verify it and add the HALT sentinel
+    if (df_verify(vm->code, length, vm->opmap) != DF_DONE) {
+        return DF_ERR_VERIFY;
+    }
+    vm->code[length]    = DF_HALT;
+    vm->codelen         = length;
+    vm->status          = DF_DONE;
+    return DF_DONE;
+}
+
+
+#ifndef EXTF_df_load
+OT_WEAK ot_int df_load(df_vm* vm, const ot_u8* code, ot_int length) {
+    vm->codelen = 0;
+    vm->status  = DF_ERR_VERIFY;
+
+    if ((length <= 0) || (length > OT_PARAM(DASHFORTH_CODESIZE))) {
+        return DF_ERR_VERIFY;
+    }
+    memcpy(vm->code, (ot_u8*)code, length);
+    return sub_install(vm, length);
+}
+#endif
+
+
+#ifndef EXTF_df_loadfile
+OT_WEAK ot_int df_loadfile(df_vm* vm, vlFILE* fp) {
+    ot_int  length;
+    ot_int  i;
+
+    vm->codelen = 0;
+    vm->status  = DF_ERR_VERIFY;
+
+    // The file is loaded whole, magic byte included, and then the code is
+    // shifted down over the magic byte.  The extra byte in vm->code is for
+    // the HALT sentinel, so the file may be one byte longer than the code.
+    length = (ot_int)fp->length;
+    if ((length < 2) || (length > (OT_PARAM(DASHFORTH_CODESIZE)+1))) {
+        return DF_ERR_VERIFY;
+    }
+    vl_load(fp, length, vm->code);
+    if (vm->code[0] != DF_MAGIC) {
+        return DF_ERR_VERIFY;
+    }
+    length--;
+    for (i=0; i<length; i++) {
+        vm->code[i] = vm->code[i+1];
+    }
+
+    return sub_install(vm, length);
+}
+#endif
+
+
+#ifndef EXTF_df_start
+OT_WEAK ot_int df_start(df_vm* vm, const ot_u8* input, ot_int inlen, const id_tmpl* user_id) {
+    if (vm->codelen == 0) {
+        return DF_ERR_VERIFY;
+    }
+    if ((inlen < 0) || (inlen > OT_PARAM(DASHFORTH_INSIZE))) {
+        return DF_ERR_BOUNDS;
+    }
+
+    if (auth_isroot(user_id))       vm->user_id = AUTH_ROOT;
+    else if (auth_isuser(user_id))  vm->user_id = AUTH_USER;
+    else                            vm->user_id = AUTH_GUEST;
+
+    // The owner ID is copied, because user_id may not outlive this call.
+    // An ID that does not fit (or a NULL ID) leaves the owner as root-only.
+    vm->owner_len = 0;
+    if ((user_id != NULL) && (user_id->length != 0) && (user_id->length <= DF_OWNERSIZE)) {
+        vm->owner_len = user_id->length;
+        memcpy(vm->owner, user_id->value, user_id->length);
+    }
+
+    vm->fuel    = OT_PARAM(DASHFORTH_MAXOPS);
+    vm->pc      = 0;
+    vm->sp      = 0;
+    vm->rp      = 0;
+    vm->outlen  = 0;
+    vm->inlen   = (ot_u8)inlen;
+    vm->status  = DF_YIELD_SLICE;
+    memset((ot_u8*)vm->var, 0, sizeof(vm->var));
+    if (inlen != 0) {
+        memcpy(vm->in, (ot_u8*)input, inlen);
+    }
+    return DF_DONE;
+}
+#endif
+
+
+#ifndef EXTF_df_isowner
+OT_WEAK ot_bool df_isowner(const df_vm* vm, const id_tmpl* user_id) {
+    ot_int i;
+
+    if ((vm->owner_len == 0) || (user_id == NULL) || (user_id->length != vm->owner_len)) {
+        return False;
+    }
+    for (i=0; i<vm->owner_len; i++) {
+        if (user_id->value[i] != vm->owner[i]) {
+            return False;
+        }
+    }
+    return True;
+}
+#endif
+
+
+
+/** Interpreter <BR>
+  * ========================================================================<BR>
+  * _OP() opens an instruction, _NEXT() ends it and dispatches the next one,
+  * _EXIT() leaves the interpreter with a status.  The budget is counted in
+  * the dispatch, so every instruction costs one unit.
+  */
+
+#define _DS(N)          ds[sp-(N)]
+#define _EXIT(STATUS)   do { status = (STATUS); goto df_exit; } while(0)
+#define _NEED(N)        if (sp < (N)) _EXIT(DF_ERR_STACK)
+#define _ROOM(N)        if ((sp+(N)) > OT_PARAM(DASHFORTH_DSTACK)) _EXIT(DF_ERR_STACK)
+#define _RNEED(N)       if (rp < (N)) _EXIT(DF_ERR_RSTACK)
+#define _RROOM(N)       if ((rp+(N)) > OT_PARAM(DASHFORTH_RSTACK)) _EXIT(DF_ERR_RSTACK)
+#define _BINARY(EXPR)   do { _NEED(2); b = ds[--sp]; a = ds[sp-1]; ds[sp-1] = (EXPR); } while(0)
+#define _FLAG(TEST)     ((TEST) ? -1 : 0)
+
+#if (_DF_THREADED)
+#   define _OP(NAME)    op_##NAME:
+#   define _NEXT()      do { if (left == 0) goto df_slice; left--; goto *optable[code[pc++]]; } while(0)
+#else
+#   define _OP(NAME)    case DF_##NAME:
+#   define _NEXT()      continue
+#endif
+
+
+#ifndef EXTF_df_run
+OT_WEAK ot_int df_run(df_vm* vm, ot_uint budget) {
+    ot_u8*      code    = vm->code;
+    df_cell*    ds      = vm->ds;
+    df_cell*    rs      = vm->rs;
+    ot_uint     pc      = vm->pc;
+    ot_int      sp      = vm->sp;
+    ot_int      rp      = vm->rp;
+    ot_u32      slice;
+    ot_u32      left;
+    ot_int      status;
+    vlFILE*     fp      = NULL;
+    ot_u8       fid     = 0;
+    df_cell     a, b;
+
+#   if (_DF_THREADED)
+    static const void* const optable[256] = {
+        [0 ... 255]     = &&op_BAD,
+        [DF_HALT]       = &&op_HALT,    [DF_LIT8]       = &&op_LIT8,
+        [DF_LIT16]      = &&op_LIT16,   [DF_LIT32]      = &&op_LIT32,
+        [DF_YIELD]      = &&op_YIELD,   [DF_DUP]        = &&op_DUP,
+        [DF_DROP]       = &&op_DROP,    [DF_SWAP]       = &&op_SWAP,
+        [DF_OVER]       = &&op_OVER,    [DF_ROT]        = &&op_ROT,
+        [DF_TOR]        = &&op_TOR,     [DF_FROMR]      = &&op_FROMR,
+        [DF_RFETCH]     = &&op_RFETCH,  [DF_ADD]        = &&op_ADD,
+        [DF_SUB]        = &&op_SUB,     [DF_MUL]        = &&op_MUL,
+        [DF_DIV]        = &&op_DIV,     [DF_MOD]        = &&op_MOD,
+        [DF_NEG]        = &&op_NEG,     [DF_ABS]        = &&op_ABS,
+        [DF_MIN]        = &&op_MIN,     [DF_MAX]        = &&op_MAX,
+        [DF_AND]        = &&op_AND,     [DF_OR]         = &&op_OR,
+        [DF_XOR]        = &&op_XOR,     [DF_INV]        = &&op_INV,
+        [DF_SHL]        = &&op_SHL,     [DF_SHR]        = &&op_SHR,
+        [DF_EQ]         = &&op_EQ,      [DF_LT]         = &&op_LT,
+        [DF_GT]         = &&op_GT,      [DF_ZEQ]        = &&op_ZEQ,
+        [DF_JMP]        = &&op_JMP,     [DF_JZ]         = &&op_JZ,
+        [DF_CALL]       = &&op_CALL,    [DF_RET]        = &&op_RET,
+        [DF_NEXT]       = &&op_NEXT,    [DF_VFETCH]     = &&op_VFETCH,
+        [DF_VSTORE]     = &&op_VSTORE,  [DF_INLEN]      = &&op_INLEN,
+        [DF_INFETCH]    = &&op_INFETCH, [DF_OUT8]       = &&op_OUT8,
+        [DF_OUT16]      = &&op_OUT16,   [DF_OUT32]      = &&op_OUT32,
+        [DF_FLEN]       = &&op_FLEN,    [DF_FREAD8]     = &&op_FREAD8,
+        [DF_FREAD16]    = &&op_FREAD16,
+    };
+#   endif
+
+    if ((vm->status != DF_YIELD_SLICE) || (vm->codelen == 0)) {
+        return vm->status;
+    }
+
+    // The fuel caps the slice.  Running out of slice is a yield, but running
+    // out of fuel is an error.
+    slice   = (budget < vm->fuel) ? budget : vm->fuel;
+    left    = slice;
+
+#   if (_DF_THREADED)
+    _NEXT();
+    {
+#   else
+    for (;;) {
+        if (left == 0) goto df_slice;
+        left--;
+        switch (code[pc++]) {
+#   endif
+
+        _OP(HALT)   pc--;
+                    _EXIT(DF_DONE);
+
+        _OP(LIT8)   _ROOM(1);
+                    ds[sp++] = (df_cell)(ot_s8)code[pc];
+                    pc += 1;
+                    _NEXT();
+
+        _OP(LIT16)  _ROOM(1);
+                    ds[sp++] = (df_cell)(ot_s16)sub_imm16(&code[pc]);
+                    pc += 2;
+                    _NEXT();
+
+        _OP(LIT32)  _ROOM(1);
+                    ds[sp++] = (df_cell)( ((ot_u32)sub_imm16(&code[pc]) << 16) \
+                                        | (ot_u32)sub_imm16(&code[pc+2]) );
+                    pc += 4;
+                    _NEXT();
+
+        _OP(YIELD)  _EXIT(DF_YIELD_SLICE);
+
+        _OP(DUP)    _NEED(1); _ROOM(1);
+                    ds[sp] = ds[sp-1];
+                    sp++;
+                    _NEXT();
+
+        _OP(DROP)   _NEED(1);
+                    sp--;
+                    _NEXT();
+
+        _OP(SWAP)   _NEED(2);
+                    a = _DS(1); _DS(1) = _DS(2); _DS(2) = a;
+                    _NEXT();
+
+        _OP(OVER)   _NEED(2); _ROOM(1);
+                    ds[sp] = ds[sp-2];
+                    sp++;
+                    _NEXT();
+
+        _OP(ROT)    _NEED(3);
+                    a = _DS(3); _DS(3) = _DS(2); _DS(2) = _DS(1); _DS(1) = a;
+                    _NEXT();
+
+        _OP(TOR)    _NEED(1); _RROOM(1);
+                    rs[rp++] = ds[--sp];
+                    _NEXT();
+
+        _OP(FROMR)  _RNEED(1); _ROOM(1);
+                    ds[sp++] = rs[--rp];
+                    _NEXT();
+
+        _OP(RFETCH) _RNEED(1); _ROOM(1);
+                    ds[sp++] = rs[rp-1];
+                    _NEXT();
+
+        // Arithmetic wraps, as in two's complement, without relying on
+        // signed overflow behavior in C.
+        _OP(ADD)    _BINARY((df_cell)((ot_u32)a + (ot_u32)b));  _NEXT();
+        _OP(SUB)    _BINARY((df_cell)((ot_u32)a - (ot_u32)b));  _NEXT();
+        _OP(MUL)    _BINARY((df_cell)((ot_u32)a * (ot_u32)b));  _NEXT();
+
+        _OP(DIV)    _NEED(2);
+                    if (_DS(1) == 0) _EXIT(DF_ERR_MATH);
+                    _BINARY((b == -1) ? (df_cell)(0 - (ot_u32)a) : (a / b));
+                    _NEXT();
+
+        _OP(MOD)    _NEED(2);
+                    if (_DS(1) == 0) _EXIT(DF_ERR_MATH);
+                    _BINARY((b == -1) ? 0 : (a % b));
+                    _NEXT();
+
+        _OP(NEG)    _NEED(1);
+                    _DS(1) = (df_cell)(0 - (ot_u32)_DS(1));
+                    _NEXT();
+
+        _OP(ABS)    _NEED(1);
+                    if (_DS(1) < 0) _DS(1) = (df_cell)(0 - (ot_u32)_DS(1));
+                    _NEXT();
+
+        _OP(MIN)    _BINARY((a < b) ? a : b);           _NEXT();
+        _OP(MAX)    _BINARY((a > b) ? a : b);           _NEXT();
+        _OP(AND)    _BINARY(a & b);                     _NEXT();
+        _OP(OR)     _BINARY(a | b);                     _NEXT();
+        _OP(XOR)    _BINARY(a ^ b);                     _NEXT();
+
+        _OP(INV)    _NEED(1);
+                    _DS(1) = ~_DS(1);
+                    _NEXT();
+
+        _OP(SHL)    _BINARY((df_cell)((ot_u32)a << (b & 31)));  _NEXT();
+        _OP(SHR)    _BINARY(a >> (b & 31));                     _NEXT();
+        _OP(EQ)     _BINARY(_FLAG(a == b));             _NEXT();
+        _OP(LT)     _BINARY(_FLAG(a < b));              _NEXT();
+        _OP(GT)     _BINARY(_FLAG(a > b));              _NEXT();
+
+        _OP(ZEQ)    _NEED(1);
+                    _DS(1) = _FLAG(_DS(1) == 0);
+                    _NEXT();
+
+        _OP(JMP)    pc = sub_imm16(&code[pc]);
+                    _NEXT();
+
+        _OP(JZ)     _NEED(1);
+                    pc = (ds[--sp] == 0) ? sub_imm16(&code[pc]) : (pc + 2);
+                    _NEXT();
+
+        _OP(CALL)   _RROOM(1);
+                    rs[rp++] = (df_cell)(pc + 2);
+                    pc = sub_imm16(&code[pc]);
+                    _NEXT();
+
+        // The return address may have been swapped with data using >R and
+        // R>, so it is checked like a branch target.
+        _OP(RET)    _RNEED(1);
+                    a = rs[--rp];
+                    if ((a < 0) || (a > (df_cell)vm->codelen) \
+                    || !sub_isop(vm->opmap, (ot_uint)a)) {
+                        _EXIT(DF_ERR_RSTACK);
+                    }
+                    pc = (ot_uint)a;
+                    _NEXT();
+
+        _OP(NEXT)   _RNEED(1);
+                    if (--rs[rp-1] > 0) {
+                        pc = sub_imm16(&code[pc]);
+                    }
+                    else {
+                        rp--;
+                        pc += 2;
+                    }
+                    _NEXT();
+
+        _OP(VFETCH) _ROOM(1);
+                    ds[sp++] = vm->var[code[pc++]];
+                    _NEXT();
+
+        _OP(VSTORE) _NEED(1);
+                    vm->var[code[pc++]] = ds[--sp];
+                    _NEXT();
+
+        _OP(INLEN)  _ROOM(1);
+                    ds[sp++] = vm->inlen;
+                    _NEXT();
+
+        _OP(INFETCH) _NEED(1);
+                    if ((ot_u32)_DS(1) >= vm->inlen) _EXIT(DF_ERR_BOUNDS);
+                    _DS(1) = vm->in[_DS(1)];
+                    _NEXT();
+
+        _OP(OUT8)   b = 1;
+                    goto df_out;
+        _OP(OUT16)  b = 2;
+                    goto df_out;
+        _OP(OUT32)  b = 4;
+        df_out:     _NEED(1);
+                    if ((vm->outlen + b) > OT_PARAM(DASHFORTH_OUTSIZE)) _EXIT(DF_ERR_BOUNDS);
+                    a = ds[--sp];
+                    while (--b >= 0) {
+                        vm->out[vm->outlen++] = (ot_u8)((ot_u32)a >> (b << 3));
+                    }
+                    _NEXT();
+
+        _OP(FLEN)   _NEED(1);
+                    if (sub_fopen(vm, &fp, &fid, _DS(1)) == NULL) _EXIT(DF_ERR_ACCESS);
+                    _DS(1) = sub_flength(fp);
+                    _NEXT();
+
+        _OP(FREAD8) b = 1;
+                    goto df_fread;
+        _OP(FREAD16) b = 2;
+        df_fread:   _NEED(2);
+                    a = ds[--sp];
+                    if (sub_fopen(vm, &fp, &fid, _DS(1)) == NULL) _EXIT(DF_ERR_ACCESS);
+                    if ((a < 0) || (a > ((df_cell)sub_flength(fp) - b))) _EXIT(DF_ERR_BOUNDS);
+                    _DS(1) = sub_fbyte(fp, (ot_uint)a);
+                    if (b == 2) {
+                        _DS(1) = (_DS(1) << 8) | sub_fbyte(fp, (ot_uint)a+1);
+                    }
+                    _NEXT();
+
+#   if (_DF_THREADED)
+        op_BAD:     _EXIT(DF_ERR_VERIFY);
+    }
+#   else
+        default:    _EXIT(DF_ERR_VERIFY);
+        }
+    }
+#   endif
+
+    df_slice:
+    status = (slice == vm->fuel) ? DF_ERR_FUEL : DF_YIELD_SLICE;
+
+    df_exit:
+    if (fp != NULL) {
+        vl_close(fp);
+    }
+    vm->fuel   -= (slice - left);
+    vm->pc      = (ot_u16)pc;
+    vm->sp      = (ot_u8)sp;
+    vm->rp      = (ot_u8)rp;
+    vm->status  = status;
+    return status;
+}
+#endif
+
+
+#endif
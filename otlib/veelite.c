@@ -36,10 +36,15 @@
 #include <otlib/utils.h>
 #include <otlib/auth.h>
 #include <otlib/memcpy.h>
+#include <otlib/crc16.h>
 #include <otsys/veelite.h>
 //#include <otsys/veelite_core.h>
 #include <otsys/time.h>
 
+#if (OT_FEATURE(DASHFORTH) == ENABLED)
+#   include <otlib/dashforth.h>
+#endif
+
 #if defined(__C2000__)
 #   define LSB16(_x)        (_x&0xFF)
 #   define MSB16(_x)        (_x>>8)
@@ -67,6 +72,49 @@ static ot_u8    vlaction_users[OT_PARAM(VLACTIONS)];
 
 #endif
 
+// Bumped whenever file data, length, existence, or permissions change, so
+// upper layers can validate their caches of file data cheaply.
+static ot_u32 vlmodcount;
+
+
+// If file watching is enabled, watchers are kept in a table, and each file
+// hashes to a bucket holding a bitmask of the watchers that may want it.
+#if (OT_FEATURE(VLWATCH) == ENABLED)
+#   if (OT_PARAM(VLWATCHERS) > 16)
+#       error "OT_PARAM_VLWATCHERS must be 16 or less"
+#   endif
+#   define VLWATCH_BUCKETS      16
+#   define VLWATCH_HASH(BLOCK, ID)  (((ID) ^ ((BLOCK) << 2)) & (VLWATCH_BUCKETS-1))
+
+typedef struct {
+    ot_procv    action;
+    ot_u8       block_id;
+    ot_u8       data_id;
+    ot_u8       condition;
+} vlwatcher_t;
+
+static vlwatcher_t  vlwatcher[OT_PARAM(VLWATCHERS)];
+static ot_u16       vlwatch_bucket[VLWATCH_BUCKETS];
+static ot_u16       vlwatch_anyid[4];       // indexed by vlBLOCK
+#endif
+
+
+// If the header cache is enabled, header updates from vl_close() (length,
+// access time, modification time) are held in RAM and written back to the
+// header all at once, by vl_flush() or when the entry is evicted.
+#if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+#   define VLHDR_WORDS      (sizeof(vl_header_t) / 2)
+
+typedef struct {
+    vaddr   header;                 // NULL_vaddr when the entry is free
+    ot_u16  dirty;                  // bit i set: word[i] is newer than the header
+    ot_u16  word[VLHDR_WORDS];
+} vlhdr_t;
+
+static vlhdr_t  vlhdr[OT_PARAM(VLHDRCACHE)];
+static ot_u8    vlhdr_next;
+#endif
+
 
 
 // Two checks for File Pointer Validity
@@ -195,6 +243,36 @@ static void sub_copy_header(vl_header_t* output_header, vaddr header);
 static void sub_write_header(vaddr header, ot_u16* data, ot_uint length );
 
 
+/** @brief Reads a half-word of a header, through the header cache
+  * @param header : (vaddr) header base address
+  * @param offset : (ot_uint) even byte offset into the header
+  * @retval ot_u16 : header data
+  */
+static ot_u16 sub_read_header(vaddr header, ot_uint offset);
+
+
+/** @brief Writes a block of data to the header, through the header cache
+  * @param header : (vaddr) header base address
+  * @param offset : (ot_uint) even byte offset into the header
+  * @param data : (ot_u16*) pointer to half-word aligned data
+  * @param length : (ot_uint) number of BYTES to write
+  * @retval none
+  *
+  * Without the header cache, this is the same as sub_write_header().  With it,
+  * unchanged half-words are dropped and the others are held in RAM until the
+  * cache entry is flushed.
+  */
+static void sub_update_header(vaddr header, ot_uint offset, ot_u16* data, ot_uint length);
+
+
+/** @brief Drops the cache entry of a header, optionally writing it back first
+  * @param header : (vaddr) header base address, or NULL_vaddr for all headers
+  * @param writeback : (ot_bool) True to write dirty data to the header
+  * @retval none
+  */
+static void sub_flush_header(vaddr header, ot_bool writeback);
+
+
 
 /** @brief Searches for the first empty header
   * @param start_base : (vaddr*) physical pointer to the @c base @c file of a header
@@ -262,6 +340,26 @@ static vaddr sub_header_search(vaddr header, ot_u8 search_id, ot_int num_headers
 static ot_u8 sub_action(vlFILE* fp);
 
 
+/** @brief Notifies the watchers of a file about a change to it
+  * @param block_id : (ot_u8) Block ID of the file
+  * @param data_id : (ot_u8) ID of the file
+  * @param flags : (ot_u16) VL_FLAG_... change flags
+  * @param offset : (ot_uint) first byte of data that changed
+  * @param span : (ot_uint) number of bytes of data that changed
+  * @retval None
+  */
+static void sub_notify(ot_u8 block_id, ot_u8 data_id, ot_u16 flags, ot_uint offset, ot_uint span);
+
+
+/** @brief Extends the modified data range of an open file
+  * @param fp : (vlFILE*) file pointer
+  * @param lo : (ot_uint) first byte written
+  * @param hi : (ot_uint) byte after the last byte written
+  * @retval None
+  */
+static void sub_markrange(vlFILE* fp, ot_uint lo, ot_uint hi);
+
+
 
 
 
@@ -285,6 +383,22 @@ OT_WEAK ot_u8 vl_init(void) {
     memset(vlaction_users, 0, sizeof(vlaction_users));
 #   endif
 
+    /// Initialize file watchers, if enabled
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    memset(vlwatcher, 0, sizeof(vlwatcher));
+    memset(vlwatch_bucket, 0, sizeof(vlwatch_bucket));
+    memset(vlwatch_anyid, 0, sizeof(vlwatch_anyid));
+#   endif
+
+    /// Initialize header cache, if enabled
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    for (i=0; i<OT_PARAM(VLHDRCACHE); i++) {
+        vlhdr[i].header = NULL_vaddr;
+        vlhdr[i].dirty  = 0;
+    }
+    vlhdr_next = 0;
+#   endif
+
     /// Initialize environment variables
     memset(vlfile, 0, sizeof(vlfile));
     for (i=0; i<OT_PARAM(VLFPS); i++) {
@@ -412,6 +526,146 @@ static ot_u8 sub_action(vlFILE* fp) {
 
 
 
+#ifndef EXTF_vl_get_modcount
+OT_WEAK ot_u32 vl_get_modcount(void) {
+    return vlmodcount;
+}
+#endif
+
+
+#ifndef EXTF_vl_flush
+OT_WEAK void vl_flush(void) {
+    sub_flush_header(NULL_vaddr, True);
+}
+#endif
+
+
+
+
+// Add Watcher (Infrequently called)
+// This function is only accessible from internal code (not via protocol)
+#ifndef EXTF_vl_watch
+OT_WEAK ot_int vl_watch(vlBLOCK block_id, ot_u8 data_id, ot_u8 condition, ot_procv action) {
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    /// 1. If the same watch is already registered, return its handle
+    /// 2. If not present, add at the first free slot
+    ot_int i;
+    ot_int select = -1;
+
+    if ((block_id == VL_NULL_BLOCKID) || (block_id > VL_ISF_BLOCKID) || (action == NULL)) {
+        return -1;
+    }
+
+    for (i=0; i<OT_PARAM(VLWATCHERS); i++) {
+        vlwatcher_t* watcher = &vlwatcher[i];
+        if (watcher->action == NULL) {
+            if (select < 0) {
+                select = i;
+            }
+        }
+        else if ((watcher->action == action) && (watcher->block_id == block_id) \
+              && (watcher->data_id == data_id) && (watcher->condition == condition)) {
+            return i;
+        }
+    }
+
+    if (select >= 0) {
+        vlwatcher[select].action    = action;
+        vlwatcher[select].block_id  = block_id;
+        vlwatcher[select].data_id   = data_id;
+        vlwatcher[select].condition = condition;
+
+        if (condition & VL_WATCH_ANYID) {
+            vlwatch_anyid[block_id] |= (1 << select);
+        }
+        else {
+            vlwatch_bucket[VLWATCH_HASH(block_id, data_id)] |= (1 << select);
+        }
+    }
+
+    return select;
+
+#   else
+    return -1;
+
+#   endif
+}
+#endif
+
+
+#ifndef EXTF_vl_unwatch
+OT_WEAK void vl_unwatch(ot_int handle) {
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    if ((handle >= 0) && (handle < OT_PARAM(VLWATCHERS))) {
+        vlwatcher_t*    watcher = &vlwatcher[handle];
+        ot_u16          bit     = ~(1 << handle);
+        ot_int          i;
+
+        watcher->action = NULL;
+
+        /// Other watchers may share the bucket, so only this bit is cleared
+        for (i=0; i<VLWATCH_BUCKETS; i++) {
+            vlwatch_bucket[i] &= bit;
+        }
+        for (i=0; i<4; i++) {
+            vlwatch_anyid[i] &= bit;
+        }
+    }
+#   endif
+}
+#endif
+
+
+static void sub_notify(ot_u8 block_id, ot_u8 data_id, ot_u16 flags, ot_uint offset, ot_uint span) {
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    ot_u16 mask;
+    ot_int i;
+
+    /// Files nobody is watching are rejected with a single lookup
+    mask    = vlwatch_bucket[VLWATCH_HASH(block_id, data_id)];
+    mask   |= vlwatch_anyid[block_id & 3];
+
+    if (mask != 0) {
+        vl_event_t event;
+        event.block_id  = block_id;
+        event.data_id   = data_id;
+        event.flags     = flags;
+        event.offset    = (ot_u16)offset;
+        event.span      = (ot_u16)span;
+
+        for (i=0; mask!=0; i++, mask>>=1) {
+            vlwatcher_t* watcher = &vlwatcher[i];
+
+            if ((mask & 1) && (watcher->action != NULL) \
+             && (watcher->block_id == block_id)         \
+             && ((watcher->condition & VL_WATCH_ANYID) || (watcher->data_id == data_id)) \
+             && (watcher->condition & flags)) {
+                watcher->action(&event);
+            }
+        }
+    }
+#   endif
+}
+
+
+static void sub_markrange(vlFILE* fp, ot_uint lo, ot_uint hi) {
+#   if (OT_FEATURE(VLWATCH) == ENABLED)
+    if (lo < fp->mod_lo)    fp->mod_lo = lo;
+    if (hi > fp->mod_hi)    fp->mod_hi = hi;
+#   endif
+}
+
+
+#if (OT_FEATURE(VLWATCH) == ENABLED)
+static ot_u8 sub_header_block(vaddr header) {
+/// Block ID of a file, found from the location of its header
+    if (header < ISS_Header_START)  return VL_GFB_BLOCKID;
+    if (header < ISF_Header_START)  return VL_ISS_BLOCKID;
+    return VL_ISF_BLOCKID;
+}
+#endif
+
+
 #ifndef EXTF_vl_get_fsalloc
 OT_WEAK ot_u32 vl_get_fsalloc(const vlFSHEADER* fshdr) {
 ///@todo have this work for different core structures.
@@ -460,6 +714,9 @@ OT_WEAK ot_u8 vl_new(vlFILE** fp_new, vlBLOCK block_id, ot_u8 data_id, ot_u8 mod
     /// 2. Make sure the file does not already exist.
     ///    If it already exists, the error code is 0x02.
     ///    If the block is not available, the error code is 0xFF.
+    ///    Cached headers are written back first, because the heap may be
+    ///    defragmented to make room.
+    sub_flush_header(NULL_vaddr, True);
     block_id--;
     switch (block_id) {
         case 0: search_fn   = &sub_gfb_search;
@@ -493,6 +750,8 @@ OT_WEAK ot_u8 vl_new(vlFILE** fp_new, vlBLOCK block_id, ot_u8 data_id, ot_u8 mod
     {   vlBLOCKHEADER* block    = &vlfs.gfb;
         block[block_id].files  += 1;
     }
+    vlmodcount++;
+    sub_notify(block_id+1, data_id, VL_FLAG_CREATED, 0, 0);
 
     return 0;
 
@@ -556,10 +815,13 @@ OT_WEAK ot_u8 vl_delete(vlBLOCK block_id, ot_u8 data_id, const id_tmpl* user_id)
     }
     
     /// 4. Delete the file, and update the fs header.
+    sub_flush_header(header, False);
     sub_delete_file(header);
     {   vlBLOCKHEADER* block    = &vlfs.gfb;
         block[block_id].files  -= 1;
     }
+    vlmodcount++;
+    sub_notify(block_id+1, data_id, VL_FLAG_DELETED, 0, 0);
     
     return 0;
     
@@ -640,6 +902,10 @@ OT_WEAK vlFILE* vl_open_file(vaddr header) {
         fp->idmod   = vworm_read(header + 4);
         fp->start   = vworm_read(header + 8);               //mirror base addr
         fp->flags   = VL_FLAG_OPENED;
+#       if (OT_FEATURE(VLWATCH) == ENABLED)
+        fp->mod_lo  = 0xFFFF;
+        fp->mod_hi  = 0;
+#       endif
 
         if (fp->start != NULL_vaddr) {
             ot_u16 mlen = fp->start;
@@ -651,7 +917,7 @@ OT_WEAK vlFILE* vl_open_file(vaddr header) {
         else {
             fp->write   = &vworm_write;
             fp->read    = &vworm_read;
-            fp->length  = vworm_read(header + 0);           //length
+            fp->length  = sub_read_header(header, 0);       //length
             fp->start   = vworm_read(header + 6);           //vworm base addr
         }
     }
@@ -679,8 +945,8 @@ OT_WEAK ot_u32 vl_getmodtime(vlFILE* fp) {
     modtime.ulong = 0;
 #   if (OT_FEATURE(VLMODTIME) == ENABLED)
     if (fp != NULL) {
-        modtime.ushort[0]   = vworm_read(fp->header + 12);
-        modtime.ushort[1]   = vworm_read(fp->header + 14);
+        modtime.ushort[0]   = sub_read_header(fp->header, 12);
+        modtime.ushort[1]   = sub_read_header(fp->header, 14);
     }
 #   endif
     return modtime.ulong;
@@ -694,8 +960,8 @@ OT_WEAK ot_u32 vl_getacctime(vlFILE* fp) {
     ot_uni32 acctime;
     acctime.ulong = 0;
     if (fp != NULL) {
-        acctime.ushort[0]   = vworm_read(fp->header + 16);
-        acctime.ushort[1]   = vworm_read(fp->header + 18);
+        acctime.ushort[0]   = sub_read_header(fp->header, 16);
+        acctime.ushort[1]   = sub_read_header(fp->header, 18);
     }
     return acctime.ulong;
 #   else
@@ -711,8 +977,7 @@ OT_WEAK ot_u8 vl_setmodtime(vlFILE* fp, ot_u32 newtime) {
     modtime.ulong = newtime;
 #   if (OT_FEATURE(VLMODTIME) == ENABLED)
     if (fp != NULL) {
-        vworm_write(fp->header+12, modtime.ushort[0]);
-        vworm_write(fp->header+14, modtime.ushort[1]);
+        sub_update_header(fp->header, 12, &modtime.ushort[0], 4);
     }
 #   endif
     return modtime.ulong;
@@ -725,8 +990,7 @@ OT_WEAK ot_u8 vl_setacctime(vlFILE* fp, ot_u32 newtime) {
     acctime.ulong = newtime;
 #   if (OT_FEATURE(VLACCTIME) == ENABLED)
     if (fp != NULL) {
-        vworm_write(fp->header+16, acctime.ushort[0]);
-        vworm_write(fp->header+18, acctime.ushort[1]);
+        sub_update_header(fp->header, 16, &acctime.ushort[0], 4);
     }
 #   endif
     return acctime.ulong;
@@ -752,7 +1016,8 @@ OT_WEAK ot_u8 vl_chmod(vlBLOCK block_id, ot_u8 data_id, ot_u8 mod, const id_tmpl
         sub_write_header((header+4), &idmod, 2);
 #   endif
 
-        ///@todo could put file action for chmod here, if ever required
+        vlmodcount++;
+        sub_notify(block_id, data_id, VL_FLAG_CHMODDED, 0, 0);
     }
 
     return output;
@@ -798,6 +1063,7 @@ OT_WEAK ot_u8 vl_write( vlFILE* fp, ot_uint offset, ot_u16 data ) {
         fp->flags  |= VL_FLAG_RESIZED;
     }
     fp->flags |= VL_FLAG_MODDED;
+    sub_markrange(fp, offset, offset+2);
 
     return fp->write( (offset+fp->start), data);
 }
@@ -859,11 +1125,16 @@ OT_WEAK ot_u8 vl_store( vlFILE* fp, ot_uint length, const ot_u8* data ) {
     ot_uint cursor;
     ot_u8   test;
 
+    /// Ring files are only written through the vl_ring_...() functions
+    if (VL_MOD_ISRING(GET_B1_U16(fp->idmod))) {
+        return 255;
+    }
     if (length > fp->alloc) {
         length = fp->alloc;
     }
 
     fp->flags  |= (length != fp->length) ? (VL_FLAG_RESIZED|VL_FLAG_MODDED) : VL_FLAG_MODDED;
+    sub_markrange(fp, 0, (length > fp->length) ? length : fp->length);
     fp->length  = length;
     cursor      = fp->start;
     length      = cursor+length;
@@ -892,6 +1163,7 @@ OT_WEAK ot_u8 vl_append( vlFILE* fp, ot_uint length, const ot_u8* data ) {
     length = (fp->length+length);
     if (length <= fp->alloc) {
         cursor      = fp->start + fp->length;
+        sub_markrange(fp, fp->length, length);
         fp->length  = length;
         length     += cursor;
         fp->flags  |= (VL_FLAG_RESIZED|VL_FLAG_MODDED);
@@ -913,10 +1185,463 @@ OT_WEAK ot_u8 vl_append( vlFILE* fp, ot_uint length, const ot_u8* data ) {
 #endif
 
 
+#ifndef EXTF_vl_loadspan
+OT_WEAK ot_uint vl_loadspan( vlFILE* fp, ot_uint offset, ot_uint length, ot_u8* data ) {
+    ot_uint cursor;
+    ot_uint limit;
+
+    if (offset >= fp->length) {
+        return 0;
+    }
+    if (length > (fp->length - offset)) {
+        length = fp->length - offset;
+    }
+    cursor  = fp->start + offset;
+    limit   = cursor + length;
+
+#   if !defined(__C2000__)
+    {   ot_uni16 scratch;
+        if (cursor & 1) {
+            scratch.ushort = fp->read(cursor-1);
+        }
+        for (; cursor<limit; cursor++) {
+            ot_u8 align = (cursor & 1);
+            if (align == 0) {
+                scratch.ushort = fp->read(cursor);
+            }
+            *data++ = scratch.ubyte[align];
+        }
+    }
+#   else
+    for (; cursor<limit; cursor+=2) {
+        *data++ = fp->read(cursor);
+    }
+#   endif
+
+    return length;
+}
+#endif
+
+
+#ifndef EXTF_vl_storespan
+OT_WEAK ot_u8 vl_storespan( vlFILE* fp, ot_uint offset, ot_uint length, const ot_u8* data ) {
+    ot_uint cursor;
+    ot_uint limit;
+    ot_u8   test = 0;
+
+    limit = offset + length;
+    if (limit > fp->alloc) {
+        return 255;
+    }
+    if (limit > fp->length) {
+        fp->length  = limit;
+        fp->flags  |= VL_FLAG_RESIZED;
+    }
+    fp->flags  |= VL_FLAG_MODDED;
+    sub_markrange(fp, offset, limit);
+    cursor      = fp->start + offset;
+    limit      += fp->start;
+
+#   if !defined(__C2000__)
+    // Only the partial words at the edges of the span need to be read first
+    while (cursor < limit) {
+        ot_uni16 scratch;
+        ot_uint  base   = cursor & ~1;
+        ot_u8    align  = (cursor & 1);
+
+        if ((align != 0) || ((cursor+1) == limit)) {
+            scratch.ushort = fp->read(base);
+        }
+        do {
+            scratch.ubyte[align++] = *data++;
+            cursor++;
+        } while ((align < 2) && (cursor < limit));
+
+        test |= fp->write(base, scratch.ushort);
+    }
+#   else
+    for (; cursor<limit; cursor+=2) {
+        test |= fp->write(cursor, *data++);
+    }
+#   endif
+
+    return test;
+}
+#endif
+
+
+#if (OT_FEATURE(VLRESTORE) == ENABLED)
+/// Delta patching works through a small buffer, in chunks of this size
+#define VL_DELTA_CHUNK      16
+
+static ot_u16 sub_delta_crc(vlFILE* fp) {
+    ot_u8   chunk[VL_DELTA_CHUNK];
+    ot_uint offset;
+    ot_uint span;
+    ot_u16  crc = crc16drv_init();
+
+    for (offset=0; offset<fp->length; offset+=span) {
+        span    = vl_loadspan(fp, offset, VL_DELTA_CHUNK, chunk);
+        crc     = crc16drv_block_manual(chunk, span, crc);
+    }
+    return crc;
+}
+
+
+static ot_u8 sub_delta_shift(vlFILE* fp, ot_uint from, ot_uint to) {
+    ot_u8   chunk[VL_DELTA_CHUNK];
+    ot_uint tail    = fp->length - from;
+    ot_uint span;
+    ot_u8   test    = 0;
+
+    // Moving toward the end, the last chunk goes first, and vl_storespan()
+    // extends the file.  Moving toward the front, the file is cropped after.
+    if (to > from) {
+        while (tail != 0) {
+            span    = (tail > VL_DELTA_CHUNK) ? VL_DELTA_CHUNK : tail;
+            tail   -= span;
+            vl_loadspan(fp, from+tail, span, chunk);
+            test   |= vl_storespan(fp, to+tail, span, chunk);
+        }
+    }
+    else {
+        ot_uint i;
+        for (i=0; i<tail; i+=span) {
+            span    = vl_loadspan(fp, from+i, VL_DELTA_CHUNK, chunk);
+            test   |= vl_storespan(fp, to+i, span, chunk);
+        }
+        fp->length  = to + tail;
+        fp->flags  |= (VL_FLAG_RESIZED | VL_FLAG_MODDED);
+    }
+    return test;
+}
+#endif
+
+
+#ifndef EXTF_vl_patch
+OT_WEAK ot_u8 vl_patch( vlFILE* fp, ot_uint length, const ot_u8* delta ) {
+#   if (OT_FEATURE(VLRESTORE) == ENABLED)
+    const ot_u8* end = delta + length;
+    ot_u8   apply;
+    ot_u8   test = 0;
+
+    /// Ring files are only written through the vl_ring_...() functions
+    if ((length < 4) || VL_MOD_ISRING(GET_B1_U16(fp->idmod))) {
+        return 255;
+    }
+    if (sub_delta_crc(fp) != (((ot_u16)delta[0] << 8) | delta[1])) {
+        return 1;
+    }
+
+    // The first pass only checks the delta against the file bounds, so a bad
+    // delta is rejected before anything is written.  The second applies it.
+    for (apply=0; apply<2; apply++) {
+        const ot_u8* op = delta + 4;
+        ot_uint cursor  = 0;
+        ot_uint flen    = fp->length;
+
+        while (op < end) {
+            ot_u8   code    = *op & 0xE0;
+            ot_uint span    = *op++ & 0x1F;
+
+            if (code == VL_DELTA_TRUNC) {
+                if (op != end) {
+                    return 255;
+                }
+                if (apply) {
+                    sub_markrange(fp, cursor, fp->length);
+                    fp->flags  |= (cursor != fp->length) ? (VL_FLAG_RESIZED|VL_FLAG_MODDED) : 0;
+                    fp->length  = cursor;
+                }
+                break;
+            }
+            if (span == 0) {
+                if ((end - op) < 2) {
+                    return 255;
+                }
+                span    = ((ot_uint)op[0] << 8) | op[1];
+                op     += 2;
+            }
+
+            switch (code) {
+                case VL_DELTA_COPY:
+                    if (span > (flen - cursor)) {
+                        return 255;
+                    }
+                    break;
+
+                case VL_DELTA_SET:
+                    if ((span > (fp->alloc - cursor)) || (span > (ot_uint)(end - op))) {
+                        return 255;
+                    }
+                    if (apply) {
+                        test |= vl_storespan(fp, cursor, span, op);
+                    }
+                    op     += span;
+                    flen    = ((cursor + span) > flen) ? (cursor + span) : flen;
+                    break;
+
+                case VL_DELTA_INSERT:
+                    if ((span > (fp->alloc - flen)) || (span > (ot_uint)(end - op))) {
+                        return 255;
+                    }
+                    if (apply) {
+                        test |= sub_delta_shift(fp, cursor, cursor+span);
+                        test |= vl_storespan(fp, cursor, span, op);
+                    }
+                    op     += span;
+                    flen   += span;
+                    break;
+
+                case VL_DELTA_DELETE:
+                    if (span > (flen - cursor)) {
+                        return 255;
+                    }
+                    if (apply) {
+                        test |= sub_delta_shift(fp, cursor+span, cursor);
+                    }
+                    flen   -= span;
+                    span    = 0;
+                    break;
+
+                default:
+                    return 255;
+            }
+            cursor += span;
+        }
+    }
+
+    // The patched file must match the file the delta was made to produce
+    if (test != 0) {
+        return 255;
+    }
+    if (sub_delta_crc(fp) != (((ot_u16)delta[2] << 8) | delta[3])) {
+        return 2;
+    }
+    return 0;
+
+#   else
+    return 255;
+#   endif
+}
+#endif
+
+
+#if (OT_FEATURE(VLRING) == ENABLED)
+/// Ring files: a file is a ring when its mod has VL_MOD_RING, and the ring
+/// state is kept in a preamble at the front of the file data.  The file length
+/// stays fixed at the allocation, so appending does not touch the file header
+/// or resize the file.
+#define VL_RING_HEAD        0
+#define VL_RING_FILL        2
+#define VL_RING_SIZE(FP)    (((FP)->alloc - VL_RING_PREAMBLE) & ~1)
+
+static ot_int sub_ring_size(vlFILE* fp) {
+    ot_u16 size;
+    if (VL_MOD_ISRING(GET_B1_U16(fp->idmod)) == 0) {
+        return -1;
+    }
+    if ((fp->alloc < (VL_RING_PREAMBLE+2)) || (fp->length != fp->alloc)) {
+        return -1;
+    }
+    size = VL_RING_SIZE(fp);
+    if ((fp->read(fp->start+VL_RING_HEAD) >= size) || (fp->read(fp->start+VL_RING_FILL) > size)) {
+        return -1;
+    }
+    return (ot_int)size;
+}
+
+
+static void sub_ring_put(vlFILE* fp, ot_uint size, ot_uint pos, const ot_u8* data, ot_uint length) {
+    while (length != 0) {
+        ot_uni16 scratch;
+        ot_uint  cursor = fp->start + VL_RING_PREAMBLE + (pos & ~1);
+        ot_u8    align  = (pos & 1);
+
+        // Only partial words need to be read first
+        if ((align != 0) || (length == 1)) {
+            scratch.ushort = fp->read(cursor);
+        }
+        do {
+            scratch.ubyte[align++] = *data++;
+            length--;
+            pos++;
+        } while ((align < 2) && (length != 0));
+
+        fp->write(cursor, scratch.ushort);
+        if (pos >= size) {
+            pos = 0;
+        }
+    }
+}
+
+
+static void sub_ring_get(vlFILE* fp, ot_uint size, ot_uint pos, ot_u8* data, ot_uint length) {
+    ot_uni16 scratch;
+
+    scratch.ushort = fp->read(fp->start + VL_RING_PREAMBLE + (pos & ~1));
+    while (length != 0) {
+        *data++ = scratch.ubyte[pos & 1];
+        length--;
+        if (++pos >= size) {
+            pos = 0;
+        }
+        if ((pos & 1) == 0) {
+            scratch.ushort = fp->read(fp->start + VL_RING_PREAMBLE + pos);
+        }
+    }
+}
+#endif
+
+
+#ifndef EXTF_vl_ring_format
+OT_WEAK ot_u8 vl_ring_format( vlFILE* fp ) {
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_u8 test;
+
+    if (fp->alloc < (VL_RING_PREAMBLE+2)) {
+        return 255;
+    }
+    fp->flags  |= (fp->length != fp->alloc) ? (VL_FLAG_RESIZED|VL_FLAG_MODDED) : VL_FLAG_MODDED;
+    fp->length  = fp->alloc;
+    sub_markrange(fp, 0, fp->alloc);
+
+    test    = fp->write(fp->start+VL_RING_HEAD, 0);
+    test   |= fp->write(fp->start+VL_RING_FILL, 0);
+
+    // Mark the file as a ring in its mod, which replaces any execute rights
+    if (VL_MOD_ISRING(GET_B1_U16(fp->idmod)) == 0) {
+        GET_B1_U16(fp->idmod) = (GET_B1_U16(fp->idmod) & ~VL_ACCESS_X) | VL_MOD_RING;
+        sub_write_header((fp->header+4), &fp->idmod, 2);
+        vlmodcount++;
+#       if (OT_FEATURE(VLWATCH) == ENABLED)
+        sub_notify(sub_header_block(fp->header), GET_B0_U16(fp->idmod), VL_FLAG_CHMODDED, 0, 0);
+#       endif
+    }
+    return test;
+
+#   else
+    return 255;
+#   endif
+}
+#endif
+
+
+#ifndef EXTF_vl_ring_fill
+OT_WEAK ot_int vl_ring_fill( vlFILE* fp ) {
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    if (sub_ring_size(fp) < 0) {
+        return -1;
+    }
+    return (ot_int)fp->read(fp->start+VL_RING_FILL);
+
+#   else
+    return -1;
+#   endif
+}
+#endif
+
+
+#ifndef EXTF_vl_ring_append
+OT_WEAK ot_u8 vl_ring_append( vlFILE* fp, ot_uint length, const ot_u8* data ) {
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_int  size;
+    ot_uint head;
+    ot_uint fill;
+    ot_u8   test;
+
+    size = sub_ring_size(fp);
+    if (size < 0) {
+        return 255;
+    }
+    head    = fp->read(fp->start+VL_RING_HEAD);
+    fill    = fp->read(fp->start+VL_RING_FILL);
+
+    // Only the newest bytes of an oversized append can be kept
+    if (length > (ot_uint)size) {
+        head    = (head + (length - size)) % size;
+        data   += (length - size);
+        length  = size;
+    }
+
+    sub_ring_put(fp, size, head, data, length);
+
+    // The preamble always changes, and a wrapped write covers the whole ring
+    head += length;
+    sub_markrange(fp, 0, (head > (ot_uint)size) ? fp->alloc : (VL_RING_PREAMBLE+head));
+    fp->flags  |= VL_FLAG_MODDED;
+
+    fill   += length;
+    test    = fp->write(fp->start+VL_RING_HEAD, (head >= (ot_uint)size) ? (head-size) : head);
+    test   |= fp->write(fp->start+VL_RING_FILL, (fill > (ot_uint)size) ? size : fill);
+    return test;
+
+#   else
+    return 255;
+#   endif
+}
+#endif
+
+
+#ifndef EXTF_vl_ring_read
+OT_WEAK ot_uint vl_ring_read( vlFILE* fp, ot_uint offset, ot_uint length, ot_u8* data ) {
+#   if (OT_FEATURE(VLRING) == ENABLED)
+    ot_int  size;
+    ot_uint fill;
+    ot_uint pos;
+
+    size = sub_ring_size(fp);
+    if (size < 0) {
+        return 0;
+    }
+    fill = fp->read(fp->start+VL_RING_FILL);
+    if (offset >= fill) {
+        return 0;
+    }
+    if (length > (fill - offset)) {
+        length = fill - offset;
+    }
+
+    // Oldest byte is at (head - fill), modulo the ring size
+    pos = fp->read(fp->start+VL_RING_HEAD) + (size - fill) + offset;
+    while (pos >= (ot_uint)size) {
+        pos -= size;
+    }
+    sub_ring_get(fp, size, pos, data, length);
+    return length;
+
+#   else
+    return 0;
+#   endif
+}
+#endif
+
+
 #ifndef EXTF_vl_execute
-OT_WEAK ot_u8 vl_execute(vlFILE* fp, ot_uint input_size, ot_u8* input_stream) {
+OT_WEAK ot_u8 vl_execute(vlFILE* fp, ot_uint input_size, ot_u8* input_stream, const id_tmpl* user_id) {
     ot_u8 retval = 255;
 
+    /// Ring files carry the X flag as their ring marker, but they are never
+    /// executable.
+    if (VL_MOD_ISRING(GET_B1_U16(fp->idmod))) {
+        return retval;
+    }
+
+#   if (OT_FEATURE(DASHFORTH) == ENABLED)
+    /// Files starting with DF_MAGIC are DASHForth applets: the input is the
+    /// applet input, not new file data.  The applet runs as user_id, the
+    /// requester of the execution.  Continuing on the DASHForth task counts
+    /// as success, and errors are returned as -DF_Status.
+    ot_uni16 magic;
+    magic.ushort = vl_read(fp, 0);
+    if ((fp->length != 0) && (magic.ubyte[0] == DF_MAGIC)) {
+        ot_int status;
+        status = dashforth_exec(NULL, 0, fp, input_stream, (ot_int)input_size,
+                                user_id, OT_PARAM(DASHFORTH_SLICE), NULL);
+        return (status >= 0) ? 0 : (ot_u8)(-status);
+    }
+#   endif
+
 #   if (OT_FEATURE(VLACTIONS) == ENABLED)
     retval = vl_store(fp, input_size, input_stream);
     if (retval != 0) {
@@ -943,9 +1668,7 @@ OT_WEAK ot_u8 vl_close( vlFILE* fp ) {
         }
         else
 #       endif
-        if (vworm_read(fp->header+0) != fp->length) {
-            sub_write_header( (fp->header+0), &(fp->length), 2);
-        }
+        sub_update_header(fp->header, 0, &(fp->length), 2);
 
 
         // Change Modification Time if there was a modification
@@ -956,14 +1679,30 @@ OT_WEAK ot_u8 vl_close( vlFILE* fp ) {
         epoch_s = time_get_utc();
 #       endif
 #       if (OT_FEATURE(VLACCTIME) == ENABLED)
-        sub_write_header( (fp->header+16), (ot_u16*)&epoch_s, 4);    ///@todo make offset constant instead of 12
+        sub_update_header(fp->header, 16, (ot_u16*)&epoch_s, 4);    ///@todo make offset constant instead of 16
 #       endif
 #       if (OT_FEATURE(VLMODTIME) == ENABLED)
         if (fp->flags & VL_FLAG_MODDED) {
-            sub_write_header( (fp->header+12), (ot_u16*)&epoch_s, 4);    ///@todo make offset constant instead of 12
+            sub_update_header(fp->header, 12, (ot_u16*)&epoch_s, 4);    ///@todo make offset constant instead of 12
         }
 #       endif
 
+        if (fp->flags & (VL_FLAG_MODDED | VL_FLAG_RESIZED)) {
+            vlmodcount++;
+
+            // Notify watchers.  Modifications made outside of the veelite
+            // write functions have no range, so they cover the whole file.
+#           if (OT_FEATURE(VLWATCH) == ENABLED)
+            if (fp->mod_hi <= fp->mod_lo) {
+                fp->mod_lo  = 0;
+                fp->mod_hi  = fp->length;
+            }
+            sub_notify( sub_header_block(fp->header), GET_B0_U16(fp->idmod),
+                        (fp->flags & (VL_FLAG_MODDED | VL_FLAG_RESIZED)),
+                        fp->mod_lo, (fp->mod_hi - fp->mod_lo) );
+#           endif
+        }
+
         // Treatment of Actions
 #       if (OT_FEATURE(VLACTIONS) == ENABLED)
 #       if !defined(__C2000__)
@@ -1092,6 +1831,7 @@ OT_WEAK ot_u8 ISF_chmod_su( ot_u8 id, ot_u8 mod ) {
 
 
 OT_WEAK ot_u8 ISF_syncmirror() {
+    vl_flush();
 #   if (ISF_MIRROR_HEAP_BYTES > 0)
         return sub_isf_mirror(MIRROR_TO_FLASH);
 #   else
@@ -1646,8 +2386,7 @@ static void sub_copy_header(vl_header_t* output_header, vaddr header ) {
     ot_u16* header_u16  = (ot_u16*)output_header;
 
     for (i=0; i<copy_length; i++) {
-        header_u16[i] = vworm_read(header);
-        header += 2;
+        header_u16[i] = sub_read_header(header, i<<1);
     }
 }
 
@@ -1661,6 +2400,97 @@ static void sub_write_header(vaddr header, ot_u16* data, ot_uint length ) {
 }
 
 
+#if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+static vlhdr_t* sub_find_hdr(vaddr header) {
+    ot_int i;
+    for (i=0; i<OT_PARAM(VLHDRCACHE); i++) {
+        if (vlhdr[i].header == header) {
+            return &vlhdr[i];
+        }
+    }
+    return NULL;
+}
+
+static void sub_writeback_hdr(vlhdr_t* entry) {
+    ot_int i;
+    for (i=0; entry->dirty != 0; i++, entry->dirty >>= 1) {
+        if (entry->dirty & 1) {
+            vworm_write( (entry->header + (i<<1)), entry->word[i]);
+        }
+    }
+}
+#endif
+
+
+static ot_u16 sub_read_header(vaddr header, ot_uint offset) {
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    vlhdr_t* entry = sub_find_hdr(header);
+    if ((entry != NULL) && (entry->dirty & (1 << (offset>>1)))) {
+        return entry->word[offset>>1];
+    }
+#   endif
+    return vworm_read(header+offset);
+}
+
+
+static void sub_update_header(vaddr header, ot_uint offset, ot_u16* data, ot_uint length) {
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    vlhdr_t* entry;
+    ot_int   i;
+
+    entry = sub_find_hdr(header);
+    if (entry == NULL) {
+        /// Take a free entry, or write back and evict the oldest one
+        entry = sub_find_hdr(NULL_vaddr);
+        if (entry == NULL) {
+            entry       = &vlhdr[vlhdr_next];
+            vlhdr_next  = (vlhdr_next+1 == OT_PARAM(VLHDRCACHE)) ? 0 : vlhdr_next+1;
+            sub_writeback_hdr(entry);
+        }
+        entry->header   = header;
+        entry->dirty    = 0;
+    }
+
+    /// Only half-words that actually change are held for write-back
+    for (i=(offset>>1); length>0; i++, length-=2, data++) {
+        if (sub_read_header(header, i<<1) != *data) {
+            entry->word[i]  = *data;
+            entry->dirty   |= (1 << i);
+        }
+    }
+
+#   else
+    ot_u16  i;
+
+    /// Only half-words that actually change are written
+    for (i=0; i<length; i+=2, data++) {
+        if (vworm_read(header+offset+i) != *data) {
+            vworm_write((header+offset+i), *data);
+        }
+    }
+#   endif
+}
+
+
+static void sub_flush_header(vaddr header, ot_bool writeback) {
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    ot_int i;
+
+    for (i=0; i<OT_PARAM(VLHDRCACHE); i++) {
+        vlhdr_t* entry = &vlhdr[i];
+        if ((entry->header != NULL_vaddr) && \
+            ((header == NULL_vaddr) || (entry->header == header))) {
+            if (writeback) {
+                sub_writeback_hdr(entry);
+            }
+            entry->header   = NULL_vaddr;
+            entry->dirty    = 0;
+        }
+    }
+#   endif
+}
+
+
 static vaddr sub_find_empty_header(vaddr header, ot_int num_headers) {
     vaddr header_base;
 
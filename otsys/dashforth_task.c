@@ -0,0 +1,151 @@
+/* Copyright 2016 JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+/**
+  * @file       /otsys/dashforth_task.c
+  * @author     JP Norair
+  * @version    R100
+  * @date       20 Oct 2016
+  * @brief      Kernel task running DASHForth applets
+  * @ingroup    DASHForth
+  *
+  * The system VM runs one applet at a time.  An applet is started by ALP or
+  * by vl_execute(), runs synchronously for as long as its caller allows, and
+  * then continues on TASK_dashforth in slices.
+  *
+  * A slice is task->reserve ticks long, at OT_PARAM_DASHFORTH_OPSPERTICK
+  * instructions per tick.  Because the reserve is the slice length, the
+  * kernel's reserve checks hold: the task is not started when a higher
+  * priority task is due within one slice, and it returns to the scheduler
+  * after each slice.
+  *
+  ******************************************************************************
+  */
+
+#include <otstd.h>
+
+#if (OT_FEATURE(DASHFORTH) == ENABLED)
+
+#include <otlib/dashforth.h>
+#include <otsys/syskern.h>
+#include <otplatform.h>
+
+#define _DF_TASK    (&sys.task[TASK_dashforth])
+
+
+typedef struct {
+    ot_sig  donefn;
+    df_vm   vm;
+} dashforth_struct;
+
+static dashforth_struct dashforth;
+
+
+
+static ot_uint sub_budget(ot_uint ticks) {
+    ot_u32 budget = (ot_u32)ticks * OT_PARAM(DASHFORTH_OPSPERTICK);
+    return (budget > 65535) ? 65535 : (ot_uint)budget;
+}
+
+
+#ifndef EXTF_dashforth_init
+OT_WEAK void dashforth_init(void) {
+    ot_task task = _DF_TASK;
+
+    dashforth.donefn        = NULL;
+    dashforth.vm.codelen    = 0;
+    dashforth.vm.status     = DF_DONE;
+    task->event             = 0;
+    sys_task_setreserve(task, OT_PARAM(DASHFORTH_SLICE));
+    sys_task_setlatency(task, 255);
+}
+#endif
+
+
+#ifndef EXTF_dashforth_kill
+OT_WEAK void dashforth_kill(void) {
+    if (dashforth.vm.status == DF_YIELD_SLICE) {
+        dashforth.vm.status = DF_ERR_KILLED;
+    }
+    _DF_TASK->event = 0;
+}
+#endif
+
+
+#ifndef EXTF_dashforth_exec
+OT_WEAK ot_int dashforth_exec(const ot_u8* code, ot_int length, vlFILE* fp,
+                              const ot_u8* input, ot_int inlen, const id_tmpl* user_id,
+                              ot_uint ticks, ot_sig donefn) {
+    df_vm*  vm = &dashforth.vm;
+    ot_int  status;
+
+    if (vm->status == DF_YIELD_SLICE) {
+        return DF_ERR_BUSY;
+    }
+
+    status = (code != NULL) ? df_load(vm, code, length) : df_loadfile(vm, fp);
+    if (status == DF_DONE) {
+        status = df_start(vm, input, inlen, user_id);
+    }
+    if (status == DF_DONE) {
+        status = df_run(vm, sub_budget(ticks));
+    }
+
+    if (status == DF_YIELD_SLICE) {
+        ot_task task        = _DF_TASK;
+        dashforth.donefn    = donefn;
+        task->event         = 1;
+        sys_task_setnext(task, 0);
+        platform_ot_preempt();
+    }
+
+    return status;
+}
+#endif
+
+
+#ifndef EXTF_dashforth_vm
+OT_WEAK df_vm* dashforth_vm(void) {
+    return &dashforth.vm;
+}
+#endif
+
+
+#ifndef EXTF_dashforth_systask
+OT_WEAK void dashforth_systask(ot_task task) {
+    ot_int status;
+
+    if (task->event == 0) {
+        dashforth_kill();
+        return;
+    }
+
+    status = df_run(&dashforth.vm, sub_budget(task->reserve));
+
+    // Yielding: stay pending, and let the scheduler arbitrate the next slice
+    if (status == DF_YIELD_SLICE) {
+        sys_task_setnext(task, 0);
+        return;
+    }
+
+    task->event = 0;
+    if (dashforth.donefn != NULL) {
+        dashforth.donefn(status);
+    }
+}
+#endif
+
+
+#endif
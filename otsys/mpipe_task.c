@@ -128,12 +128,10 @@ void mpipeevt_rxdetect(ot_int code) {
 
 
 void mpipeevt_rxdone(ot_int code) {
-/// @note "32" in the array is given as the maximum time for protocol parsing.  
-/// It might need to be more dynamic, depending on protocol and length of packet.
-/// In the future, there might be a "guess runtime" function in ALP that 
-/// inspects these things.
+/// The reserve for protocol parsing comes from the runtime estimate of the
+/// ALP handler that will process the received record (byte 2 is ALP ID).
     if (code == 0) {
-        sub_mpipe_actuate(1, 32, 0);
+        sub_mpipe_actuate(1, alp_get_runtime(q_getcursor_val(mpipe.alp.inq, 2)), 0);
     }
 }
 
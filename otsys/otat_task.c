@@ -23,213 +23,435 @@
   *
   * OTAt is sort of similar to UNIX "at," except that it is implemented as a
   * sysqueue.  OTAt runs in co-operative tasking mode, and it is tickless. It
-  * may be used to schedule all kinds of infrequent features. Often it is used 
+  * may be used to schedule all kinds of infrequent features. Often it is used
   * for the filesystem, long-duty network stack sync, etc.
   *
+  * The sysqueue holds the scheduled actions in the order they are due.  Each
+  * action stores its due time as a delta from the action ahead of it, and the
+  * top action's delta is relative to the OTAt task's nextevent.  So the kernel
+  * only clocks one task, and OTAt only needs to re-sync the top delta when the
+  * queue is changed from outside the OTAt task.
+  *
   ******************************************************************************
   */
 
+#include <otstd.h>
 
-///@note under development
-#if (0)
+#if (OT_FEATURE(OTAT) == ENABLED)
 
 #include <otsys/otat.h>
 #include <otsys/sysqueue.h>
-//#include <otlib/memcpy.h>
-//#include <otlib/rand.h>
+#include <otsys/syskern.h>
+#include <otlib/memcpy.h>
+#include <otplatform.h>
+
+#if (OT_FEATURE(ALP) == ENABLED)
+#   include <otlib/alp.h>
+#   include <otlib/auth.h>
+#   include <otlib/queue.h>
+#endif
 
-// For testing purposes, even though this should be included in the platform
-#if (defined(__STDC__) || defined (__POSIX__))
-#   include <stdio.h>
+
+#if (OT_PARAM_OTAT_SIZE < 1)
+#   error "OT_PARAM_OTAT_SIZE must be at least 1"
 #endif
 
+#define _OTAT_TASK      (&sys.task[TASK_otat])
 
 
+typedef struct {
+    ot_atstub   action;
+    ot_long     delta;
+    ot_u32      period;
+    ot_u8       id;
+    ot_u8       scheduled;
+} otat_slot;
 
-#if defined(OT_PARAM_CRONSIZE)
-#   if (OT_PARAM_CRONSIZE < 4)
-#       define _DEFSIZE     4
-#   else
-#       define _DEFSIZE     OT_PARAM_CRONSIZE
-#   endif
-#endif
+typedef struct {
+    ot_bool     running;
+    ot_sq       sq;
+    ot_sqnode   heap[OT_PARAM(OTAT_SIZE)];
+    otat_slot   slot[OT_PARAM(OTAT_SIZE)];
+} otat_struct;
 
-#if (OS_FEATURE(MALLOC))
-#   include <otlib/otmalloc.h>
+static otat_struct otat;
 
-    typedef struct otat_struct {
-        ot_s32      delta0;
-        ot_sq       sq;
-        ot_sqnode*  heap;
-    } otat_type;
 
-#   define _CRONSIZE(SIZE)          (((SIZE) > _DEFSIZE) ? (SIZE) : _DEFSIZE) 
-#   define _ALLOCATE(SIZE)          ot_malloc((SIZE) * sizeof(ot_sqnode))
-#   define _EXITCHECK(PTR, CODE)    if (PTR == NULL) return CODE
-#   define _FREE()                  ot_free(otat.heap)
 
-#else
-    typedef struct otat_struct {
-        ot_s32      delta0;
-        ot_sq       sq;
-        ot_sqnode   heap[_DEFSIZE];
-    } otat_type;
 
-#   define _CRONSIZE(SIZE)          _DEFSIZE 
-#   define _ALLOCATE(SIZE)          otat_heap
-#   define _EXITCHECK(PTR, CODE);
-#   define _FREE();
 
-#endif
 
+/** Delta list subroutines <BR>
+  * =========================================================================== <BR>
+  * sub_sync()   : clocks the top delta to the time left on the OTAt task
+  * sub_arm()    : sets the OTAt task to run when the top action is due
+  * sub_insert() : puts a slot into the list, in order of due time
+  * sub_remove() : takes a slot out of the list
+  *
+  * While the OTAt task is running its actions, the top delta is already
+  * relative to the time of the run, so sub_sync() does nothing.
+  */
+
+static otat_slot* sub_find(ot_u8 id) {
+    ot_int i;
+    for (i=0; i<OT_PARAM(OTAT_SIZE); i++) {
+        if ((otat.slot[i].action != NULL) && (otat.slot[i].id == id)) {
+            return &otat.slot[i];
+        }
+    }
+    return NULL;
+}
+
+static ot_int sub_index(otat_slot* slot) {
+    ot_int i;
+    for (i=0; i<(ot_int)otat.sq.length; i++) {
+        if (otat.sq.top[i].handle == (void*)slot) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void sub_sync(void) {
+    if ((otat.running == False) && (otat.sq.length != 0)) {
+        ot_task task = _OTAT_TASK;
+        ((otat_slot*)otat.sq.top[0].handle)->delta = \
+                    (task->nextevent - (ot_long)systim_get()) >> _TI_SHIFT;
+    }
+}
+
+static void sub_arm(void) {
+    ot_task task = _OTAT_TASK;
+
+    if (otat.sq.length == 0) {
+        task->event = 0;
+    }
+    else if (otat.running == False) {
+        ot_long wait;
+        wait        = ((otat_slot*)otat.sq.top[0].handle)->delta;
+        task->event = 1;
+        sys_task_setnext(task, (wait > 0) ? (ot_u32)wait : 0);
+        platform_ot_preempt();
+    }
+}
+
+static void sub_remove(otat_slot* slot) {
+    ot_int index = sub_index(slot);
+
+    if (index >= 0) {
+        // The action behind the removed one inherits its delta
+        if ((index+1) < (ot_int)otat.sq.length) {
+            ((otat_slot*)otat.sq.top[index+1].handle)->delta += slot->delta;
+        }
+        sq_remove(&otat.sq, (ot_uint)index);
+    }
+    slot->scheduled = False;
+}
+
+static void sub_insert(otat_slot* slot, ot_long wait) {
+    ot_sqnode   node;
+    ot_long     cum;
+    ot_int      i;
+
+    // Find the first action due later than this one.  Ties go behind, so
+    // actions due together run in the order they were scheduled.
+    cum = 0;
+    for (i=0; i<(ot_int)otat.sq.length; i++) {
+        ot_long next = cum + ((otat_slot*)otat.sq.top[i].handle)->delta;
+        if (next > wait) {
+            ((otat_slot*)otat.sq.top[i].handle)->delta = next - wait;
+            break;
+        }
+        cum = next;
+    }
+
+    slot->delta     = wait - cum;
+    slot->scheduled = True;
+    node.handle     = (void*)slot;
+    node.counter    = 0;
+    node.ext        = slot->id;
+    sq_insert(&otat.sq, (ot_uint)i, &node);
+}
+
+static ot_long sub_remaining(otat_slot* slot) {
+    ot_long cum = 0;
+    ot_int  i;
+
+    for (i=0; i<(ot_int)otat.sq.length; i++) {
+        cum += ((otat_slot*)otat.sq.top[i].handle)->delta;
+        if (otat.sq.top[i].handle == (void*)slot) {
+            return (cum > 0) ? cum : 0;
+        }
+    }
+    return -1;
+}
 
 
-static otat_type otat;
 
 
 
 
 /** otat API functions <BR>
   * =========================================================================== <BR>
-  * 
   */
 
-OT_WEAK void otat_kill() {
-    sq_clear(otat.sq);
-    _FREE();
+#ifndef EXTF_otat_init
+OT_WEAK void otat_init(void) {
+    memset((ot_u8*)otat.slot, 0, sizeof(otat.slot));
+    otat.running = False;
+    sq_init(&otat.sq, otat.heap, OT_PARAM(OTAT_SIZE));
+    _OTAT_TASK->event = 0;
+
+#   if (OT_FEATURE(ALP) == ENABLED)
+    alp_register(OT_PARAM(OTAT_ALPID), &alp_proc_otat, NULL, 0);
+#   endif
 }
+#endif
 
-OT_WEAK ot_int otat_init(ot_uint size) {
-    ot_sqnode* heap;
-    
-    size = _CRONSIZE(size);
-    heap = _ALLOCATE(size);
-    _EXITCHECK(heap, -1);
-    
-    sq_init(&otat.sq, otat.heap, size);
-    otat.clock = 0;
-    return size;
+
+#ifndef EXTF_otat_kill
+OT_WEAK void otat_kill(void) {
+    ot_int i;
+    for (i=0; i<OT_PARAM(OTAT_SIZE); i++) {
+        otat.slot[i].scheduled = False;
+    }
+    sq_clear(&otat.sq);
+    _OTAT_TASK->event = 0;
 }
+#endif
 
 
+#ifndef EXTF_otat_register
+OT_WEAK ot_int otat_register(ot_u8 id, ot_atstub action) {
+    otat_slot* slot;
 
+    if (action == NULL) {
+        return -1;
+    }
+    slot = sub_find(id);
+    if (slot == NULL) {
+        ot_int i;
+        for (i=0; i<OT_PARAM(OTAT_SIZE); i++) {
+            if (otat.slot[i].action == NULL) {
+                slot            = &otat.slot[i];
+                slot->id        = id;
+                slot->scheduled = False;
+                break;
+            }
+        }
+        if (slot == NULL) {
+            return -1;
+        }
+    }
+    slot->action = action;
+    return 0;
+}
+#endif
 
 
+#ifndef EXTF_otat_unregister
+OT_WEAK void otat_unregister(ot_u8 id) {
+    otat_slot* slot = sub_find(id);
+    if (slot != NULL) {
+        otat_cancel(id);
+        slot->action = NULL;
+    }
+}
+#endif
+
 
+#ifndef EXTF_otat_schedule
+OT_WEAK ot_int otat_schedule(ot_u8 id, ot_u32 wait, ot_u32 period) {
+    otat_slot* slot = sub_find(id);
 
+    if (slot == NULL) {
+        return -1;
+    }
 
-/** Delta Computation subroutines <BR>
+    sub_sync();
+    if (slot->scheduled) {
+        sub_remove(slot);
+    }
+    slot->period = period;
+    sub_insert(slot, (ot_long)wait);
+    sub_arm();
+    return 0;
+}
+#endif
+
+
+#ifndef EXTF_otat_cancel
+OT_WEAK ot_int otat_cancel(ot_u8 id) {
+    otat_slot* slot = sub_find(id);
+
+    if ((slot == NULL) || (slot->scheduled == False)) {
+        return -1;
+    }
+
+    sub_sync();
+    sub_remove(slot);
+    sub_arm();
+    return 0;
+}
+#endif
+
+
+#ifndef EXTF_otat_remaining
+OT_WEAK ot_long otat_remaining(ot_u8 id) {
+    otat_slot* slot = sub_find(id);
+
+    if ((slot == NULL) || (slot->scheduled == False)) {
+        return -1;
+    }
+    sub_sync();
+    return sub_remaining(slot);
+}
+#endif
+
+
+
+
+
+
+/** otat task <BR>
   * =========================================================================== <BR>
-  * Timing delta is for managing multitasking delays.  Without this, if there
-  * is a delay in one task all future tasks get delayed.  With it, momentarily
-  * delays will not propagate.  Another option is to continually clock all the
-  * elements of the otat queue in the kernel scheduler, but that is much more
-  * expensive than managing a delta.
-  *
-  * sub_compute_delta0() : sets insertion delta (before otat task runs)
-  * sub_compute_delta1() : sets exit delta (after otat task completes)
+  * Event 0 is the destructor.  Event 1 runs the top action, plus any actions
+  * that are due within OT_PARAM_OTAT_WINDOW ticks of now, so that actions
+  * with nearby due times share one wakeup.  Periodic actions are re-inserted
+  * before they run, using the time they were due, which keeps them from
+  * drifting when the task runs late.
   */
 
-void sub_compute_delta0(ot_task task, ot_sqnode* node) {
-    ot_s32 t;
-    
-    // Necessary to disable interrupts during clocking phase.
-    platform_disable_interrupts();
-    
-    // delta0 is the insertion delta, always non-negative
-    // task->nextevent will be always <= 0 during this call
-    // node counter may be positive or negative
-    //  - if negative, it indicates we are behind schedule! So correct that.
-    t = (ot_s32)((ot_sqnode_cnt32*)node)->counter;
-    if (t < 0) {
-        t = -t;   
-    }
-    otat.delta0 = t - task->nextevent;
-    
-    // Reset nextevent to clock runtime of the otat task
-    task->nextevent = 0;
-    
-    // Clocking done, re-enable interrupts
-    platform_enable_interrupts();
-}
-
-
-void sub_compute_delta1(ot_task task, ot_sqnode* node) {
-    ot_s32 delta1;
-    
-    // Necessary to disable interrupts during clocking phase.
-    platform_disable_interrupts();
-    
-    // here, task->nextevent is <= 0, and represents tasking overshoot
-    // systim_get() returns >= 0, and represents kernel time
-    // delta0 is >= 0, and represents the clock delta ahead of last task
-    delta1 += otat.delta0 - task->nextevent + systim_get();
-    
-    // Set nextevent accordingly
-    task->nextevent = delta1;
-    
-    // Clocking done, re-enable interrupts
-    platform_enable_interrupts();
+#ifndef EXTF_otat_systask
+OT_WEAK void otat_systask(ot_task task) {
+    ot_uint batch;
+
+    if (task->event == 0) {
+        otat_kill();
+        return;
+    }
+
+    sub_sync();
+    otat.running = True;
+
+    // Each action runs at most once per batch, even if it has a short period
+    batch = otat.sq.length;
+    while ((batch-- != 0) && (otat.sq.length != 0)) {
+        otat_slot*  slot;
+        ot_long     late;
+
+        slot = (otat_slot*)otat.sq.top[0].handle;
+        if (slot->delta > OT_PARAM(OTAT_WINDOW)) {
+            break;
+        }
+
+        late = slot->delta;
+        sub_remove(slot);
+        if (slot->period != 0) {
+            late += (ot_long)slot->period;
+            sub_insert(slot, (late > 0) ? late : 0);
+        }
+        slot->action(slot->id);
+    }
+
+    otat.running = False;
+    sub_arm();
 }
+#endif
 
 
 
 
-/** otat task <BR>
+
+
+/** otat ALP processor <BR>
   * =========================================================================== <BR>
-  * Otat uses a unique task clocker, which can be used as an example on how 
-  * to clock task queues.
   */
 
-void otat_systask(ot_task task) {
-    switch (task->event) {
-        
-        // OTat task destructor is same as init
-        case 0: otat_kill();
-                break;
+#if (OT_FEATURE(ALP) == ENABLED)
+
+static ot_int sub_otat_list(alp_tmpl* alp, const id_tmpl* user_id, ot_int data_in) {
+    ot_int data_out = 0;
+    ot_int i;
+
+    if (auth_isuser(user_id) == False) {
+        return 0;
+    }
+
+    sub_sync();
+    for (i=0; i<OT_PARAM(OTAT_SIZE); i++) {
+        otat_slot* slot = &otat.slot[i];
+        if ((slot->action != NULL) && (q_writespace(alp->outq) >= 10)) {
+            q_writebyte(alp->outq, slot->id);
+            q_writebyte(alp->outq, slot->scheduled);
+            q_writelong(alp->outq, (ot_u32)(slot->scheduled ? sub_remaining(slot) : 0));
+            q_writelong(alp->outq, slot->period);
+            data_out += 10;
+        }
+    }
+    return data_out;
+}
 
-        // OTat task exit clocker
-        // - Always runs closely after state 2
-        // - Uses a trick with task->nextevent to clock elapsed time from
-        //   executing in state 2.
-        case 1: {
-            ot_sqnode* node;
-            
-            // Get the node, exit if somehow the queue has been deleted
-            node = sq_top(&otat.sq);
-            if (node == NULL) {
-                task->event = 0;
-                break;   
-            }
-            
-            // Compute the exit delta and setup otat for next task
-            sub_compute_delta1(task, node);
-            task->event = 2;
-        } break;
-
-        // OTat run the task
-        // If the queue is not empty after the task runs, re-schedule with kernel
-        case 2: {
-            ot_sqnode* node;
-            
-            // Get the node, exit if somehow the queue has been deleted
-            node = sq_pop(&otat.sq); 
-            if (node == NULL) {
-                task->event = 0;
-                break;   
-            }
-            
-            // Compute the insertion delta, then run the otat task from the node
-            sub_compute_delta0(task, node);
-            ((ot_atstub)node->handle)();
 
-            // If queue is not empty, the kernel will loop and we can clock-out
-            // the next queue item in state 1.
-            task->event = (ot_u8)sq_notempty(&otat.sq);
-        } break;
+static ot_int sub_otat_set(alp_tmpl* alp, const id_tmpl* user_id, ot_int data_in, ot_u8 cmd) {
+    ot_int  data_out    = 0;
+    ot_int  recsize     = (cmd == OTAT_CMD_SCHEDULE) ? 9 : 1;
+    ot_bool allowed     = auth_isroot(user_id);
+
+    while (data_in >= recsize) {
+        ot_u8   id;
+        ot_int  err;
+
+        data_in    -= recsize;
+        id          = q_readbyte(alp->inq);
+        if (cmd == OTAT_CMD_SCHEDULE) {
+            ot_u32 wait     = q_readlong(alp->inq);
+            ot_u32 period   = q_readlong(alp->inq);
+            err             = allowed ? otat_schedule(id, wait, period) : -1;
+        }
+        else {
+            err = allowed ? otat_cancel(id) : -1;
+        }
+
+        if (q_writespace(alp->outq) >= 2) {
+            q_writebyte(alp->outq, id);
+            q_writebyte(alp->outq, (ot_u8)(err != 0));
+            data_out += 2;
+        }
     }
+    return data_out;
 }
 
+
+#ifndef EXTF_alp_proc_otat
+OT_WEAK ot_bool alp_proc_otat(alp_tmpl* alp, const id_tmpl* user_id) {
+    ot_int  data_in = INREC(alp, PLEN);
+    ot_u8   cmd_in  = INREC(alp, CMD);
+    ot_u8   cmd     = cmd_in & 0x7F;
+
+    if (cmd == OTAT_CMD_LIST) {
+        alp->OUTREC(PLEN) = sub_otat_list(alp, user_id, data_in);
+    }
+    else if ((cmd == OTAT_CMD_SCHEDULE) || (cmd == OTAT_CMD_CANCEL)) {
+        alp->OUTREC(PLEN) = sub_otat_set(alp, user_id, data_in, cmd);
+    }
+    else {
+        alp->OUTREC(PLEN) = 0;
+    }
+
+    if (cmd_in & 0x80) {
+        //Transform input cmd to error or data return variant for response
+        alp->OUTREC(CMD) ^= 0x80;
+    }
+    else {
+        alp->outq->putcursor -= alp->OUTREC(PLEN);
+    }
+
+    return True;
+}
+#endif
+
 #endif
 
 
+#endif
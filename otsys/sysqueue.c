@@ -326,6 +326,45 @@ OT_WEAK ot_sqnode* sq_extend_fromargs(ot_sq* sq, ot_sqcond condfn, void* handle,
 
 
 
+/** sq_insert() and sq_remove() <BR>
+  * ======================================================================= <BR>
+  * Positional insert and remove, where index 0 is the top of the queue.
+  */
+
+#ifndef EXTF_sq_insert
+OT_WEAK ot_sqnode* sq_insert(ot_sq* sq, ot_uint index, ot_sqnode* node) {
+    ot_uint i;
+
+    if ((sq->top <= &_HEAP_1ST(sq)) || (index > sq->length)) {
+        return NULL;
+    }
+
+    // Nodes ahead of the index move up one notch to open a slot
+    sq->top--;
+    for (i=0; i<index; i++) {
+        sq->top[i] = sq->top[i+1];
+    }
+    sq->length++;
+    return sub_storenode(&sq->top[index], node);
+}
+#endif
+
+#ifndef EXTF_sq_remove
+OT_WEAK void sq_remove(ot_sq* sq, ot_uint index) {
+    if (index < sq->length) {
+        // Nodes ahead of the index move down one notch over the removed node
+        for (; index>0; index--) {
+            sq->top[index] = sq->top[index-1];
+        }
+        sq->top++;
+        sq->length--;
+    }
+}
+#endif
+
+
+
+
 /** sq data API functions <BR>
   * ======================================================================= <BR>
   */
@@ -36,6 +36,9 @@
 //#include "system_gulp.h"
 #include <otsys/mpipe.h>
 #include <otsys/sysext.h>
+#include <otsys/veelite.h>
+#include <otsys/otat.h>
+#include <otlib/dashforth.h>
 
 #include <m2/dll.h>
 #include <m2/radio.h>
@@ -99,6 +102,12 @@ static const systask_fn systask_call[]   = {
 #if (M2_FEATURE(ENDPOINT))
     &dll_systask_sleepscan,
 #endif
+#if (OT_FEATURE(OTAT))
+    &otat_systask,
+#endif
+#if (OT_FEATURE(DASHFORTH))
+    &dashforth_systask,
+#endif
 #if (OT_FEATURE(EXT_TASK))
     &ext_systask,
 #endif
@@ -144,6 +153,14 @@ void sys_init() {
 
     sys.active = TASK_MAX;
 
+    /// Initialize OTAt timed-action service if enabled
+#   if (OT_FEATURE(OTAT) == ENABLED)
+        otat_init();
+#   endif
+#   if (OT_FEATURE(DASHFORTH) == ENABLED)
+        dashforth_init();
+#   endif
+
     /// Initialize External module if enabled
 #   if (OT_FEATURE(EXT_TASK) == ENABLED)
         ext_init();
@@ -198,6 +215,13 @@ void sys_powerdown() {
     code    = (mpipe_status() <= 0) ? 1 : code;
 #   endif
 
+    /// Write back cached Veelite file headers before the deepest sleep
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    if (code == 3) {
+        vl_flush();
+    }
+#   endif
+
 #   if defined(EXTF_sys_sig_powerdown)
         sys_sig_powerdown(code);
 #   elif (OT_FEATURE(SYSKERN_CALLBACKS))
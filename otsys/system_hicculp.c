@@ -34,6 +34,9 @@
 #include <otsys/mpipe.h>
 #include <otsys/sysext.h>
 #include <otsys/time.h>
+#include <otsys/veelite.h>
+#include <otsys/otat.h>
+#include <otlib/dashforth.h>
 
 #include <otlib/memcpy.h>
 #include <otlib/utils.h>
@@ -132,9 +135,12 @@ static const systask_fn systask_call[]   = {
 #if (OT_FEATURE(M2))
     &dll_systask_sleepscan,
 #endif
-//#if (OT_FEATURE(CRON))
-//    &otcron_systask,
-//#endif
+#if (OT_FEATURE(OTAT))
+    &otat_systask,
+#endif
+#if (OT_FEATURE(DASHFORTH))
+    &dashforth_systask,
+#endif
 #if (OT_PARAM(KERNELTASKS) > 0)
     OT_PARAM_KERNELTASK_HANDLES,
 #elif (OT_FEATURE(EXT_TASK))
@@ -197,6 +203,12 @@ OT_WEAK void sys_init() {
     ///      which is the initialization/kill state.
     
     
+#   if (OT_FEATURE(OTAT) == ENABLED)
+        otat_init();
+#   endif
+#   if (OT_FEATURE(DASHFORTH) == ENABLED)
+        dashforth_init();
+#   endif
 //#   if (OT_FEATURE(CRON) == ENABLED)
 //        otcron_init();
 //#   endif
@@ -279,6 +291,13 @@ OT_WEAK void sys_powerdown() {
     // Shut down the clocker: a task isn't running during powerdown
     systim_stop_clocker();
 
+    /// Write back cached Veelite file headers before the deepest sleep
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    if (code == 3) {
+        vl_flush();
+    }
+#   endif
+
 #   if defined(EXTF_sys_sig_powerdown)
         sys_sig_powerdown(code);
 #   elif (OT_FEATURE(SYSKERN_CALLBACKS))
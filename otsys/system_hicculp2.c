@@ -33,6 +33,9 @@
 #include <otsys/syskern.h>
 #include <otsys/mpipe.h>
 #include <otsys/sysext.h>
+#include <otsys/veelite.h>
+#include <otsys/otat.h>
+#include <otlib/dashforth.h>
 
 #include <otlib/memcpy.h>
 #include <otlib/utils.h>
@@ -116,9 +119,12 @@ static const systask_fn systask_call[]   = {
 #if (OT_FEATURE(M2))
     &dll_systask_sleepscan,
 #endif
-//#if (OT_FEATURE(CRON))
-//    &otcron_systask,
-//#endif
+#if (OT_FEATURE(OTAT))
+    &otat_systask,
+#endif
+#if (OT_FEATURE(DASHFORTH))
+    &dashforth_systask,
+#endif
 #if (OT_PARAM(KERNELTASKS) > 0)
     OT_PARAM_KERNELTASK_HANDLES,
 #elif (OT_FEATURE(EXT_TASK))
@@ -186,6 +192,12 @@ OT_WEAK void sys_init() {
 #   if (OT_FEATURE(CRON) == ENABLED)
         otcron_init();
 #   endif
+#   if (OT_FEATURE(OTAT) == ENABLED)
+        otat_init();
+#   endif
+#   if (OT_FEATURE(DASHFORTH) == ENABLED)
+        dashforth_init();
+#   endif
 #   if (OT_FEATURE(EXT_TASK) == ENABLED)
         ext_init();
 #   endif
@@ -248,6 +260,13 @@ OT_WEAK void sys_powerdown() {
 #   if defined(OT_PARAM_USER_EXOTASKS)
 #   endif
 
+    /// Write back cached Veelite file headers before the deepest sleep
+#   if (OT_FEATURE(VLHDRCACHE) == ENABLED)
+    if (code == 3) {
+        vl_flush();
+    }
+#   endif
+
 #   if defined(EXTF_sys_sig_powerdown)
         sys_sig_powerdown(code);
 #   elif (OT_FEATURE(SYSKERN_CALLBACKS))
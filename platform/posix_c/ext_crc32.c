@@ -14,99 +14,295 @@
   *
   */
 /**
-  * @file       /otplatform/stm32l1xx/crc32_driver.c
+  * @file       /platform/posix_c/ext_crc32.c
   * @author     JP Norair
-  * @version    R100
+  * @version    R101
   * @date       21 Jan 2014
-  * @brief      32bit word-wise peripheral driver for HW CRC32
+  * @brief      Software CRC32 for POSIX C
   * @ingroup    CRC32
   *
-  * STM32L contains a hardware peripheral for doing CRC32.
+  * POSIX hosts have no CRC peripheral, so this is a software implementation
+  * of the Ethernet CRC32 (reflected polynomial 0xEDB88320, init and final XOR
+  * of 0xFFFFFFFF).  The CRC is appended little-endian, as Ethernet does.
+  *
+  * Two engines are available:
+  * <LI> Slicing-by-8: portable, 8 bytes per step, using 8KB of tables. </LI>
+  * <LI> PCLMUL folding: x86-64 only, 64 bytes per step, used automatically
+  *      on CPUs that support it, for inputs of 64 bytes or more. </LI>
   *
   ******************************************************************************
   */
 
-#if 0
-
-#include <otstd.h>
+#include <otstd.h>
 #include <platform/config.h>
 #include "crc32.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) && defined(__GNUC__) && !defined(__BIG_ENDIAN__))
+#   define _CRC32_PCLMUL    1
+#   include <immintrin.h>
+#else
+#   define _CRC32_PCLMUL    0
+#endif
+
+
+// ot_u32 may be wider than 32 bits on POSIX (LP64), so the engine works on
+// uint32_t and the CRC value is carried internally in non-inverted form.
+#define CRC32_POLY      0xEDB88320
+#define CRC32_RESIDUE   0xDEBB20E3      // internal state after data + CRC
+
 
 typedef struct {
-    ot_u8*  cursor;
-    ot_bool writeout;
-    ot_int  count;
+    ot_u8*      cursor;
+    ot_bool     writeout;
+    ot_int      count;
+    uint32_t    val;
 } crc32_struct;
 
-crc32_struct crc32;
+static crc32_struct crc32;
+
+static uint32_t crc32_table[8][256];
+static ot_bool  crc32_table_ready = False;
 
+#if (_CRC32_PCLMUL)
+static ot_int   crc32_has_pclmul  = -1;
+#endif
 
 
-ot_u32 crc32_calc_block(ot_u8* block_addr, ot_uint block_words) {
-    bloc_addr--;            // -1 due to little-endian unaligned access mechanism
-
-    while (block_words--) {
-        // This routine depends on the ability to do unaligned memory access,
-        // which the Cortex M3 and M4 can do, but the M0 cannot, nor can almost
-        // any other CPU.
-        ot_u32 scratch;
-        block_addr += 4;                        // little-endian byte ordering
-        scratch     = *(ot_u32*)block_addr;
-        CRC->DR     = scratch;
+
+
+/** Slicing-by-8 engine <BR>
+  * ========================================================================<BR>
+  */
+
+static void sub_build_tables(void) {
+    uint32_t c;
+    ot_int i, j;
+
+    for (i=0; i<256; i++) {
+        c = (uint32_t)i;
+        for (j=0; j<8; j++) {
+            c = (c & 1) ? ((c >> 1) ^ CRC32_POLY) : (c >> 1);
+        }
+        crc32_table[0][i] = c;
+    }
+    for (i=0; i<256; i++) {
+        c = crc32_table[0][i];
+        for (j=1; j<8; j++) {
+            c = crc32_table[0][c & 0xFF] ^ (c >> 8);
+            crc32_table[j][i] = c;
+        }
     }
-    
-    return CRC->DR;
+    crc32_table_ready = True;
+}
+
+
+static uint32_t sub_crc_slice8(uint32_t crc, const ot_u8* data, size_t length) {
+#   if !defined(__BIG_ENDIAN__)
+    uint32_t lo, hi;
+
+    while (length >= 8) {
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data+4, 4);
+        lo ^= crc;
+        crc = crc32_table[7][lo & 0xFF]         ^ crc32_table[6][(lo >> 8) & 0xFF]
+            ^ crc32_table[5][(lo >> 16) & 0xFF] ^ crc32_table[4][lo >> 24]
+            ^ crc32_table[3][hi & 0xFF]         ^ crc32_table[2][(hi >> 8) & 0xFF]
+            ^ crc32_table[1][(hi >> 16) & 0xFF] ^ crc32_table[0][hi >> 24];
+        data   += 8;
+        length -= 8;
+    }
+#   endif
+    while (length-- != 0) {
+        crc = crc32_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+
+
+
+/** PCLMUL folding engine <BR>
+  * ========================================================================<BR>
+  * Folds four 128 bit lanes in parallel, then folds them into one lane, and
+  * then does a Barrett reduction to 32 bits.  Constants are the bit-reflected
+  * fold and Barrett constants for the CRC32 polynomial, from the Intel paper
+  * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ".  The input
+  * must be at least 64 bytes, and only a multiple of 16 bytes is processed.
+  */
+#if (_CRC32_PCLMUL)
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t sub_crc_pclmul(uint32_t crc, const ot_u8* data, size_t length) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    data   += 64;
+    length -= 64;
+
+    // Parallel fold of 64 byte blocks
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+        data   += 64;
+        length -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Single fold of remaining 16 byte blocks
+    while (length >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+        data   += 16;
+        length -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+
+static uint32_t sub_crc_engine(uint32_t crc, const ot_u8* data, size_t length) {
+    if (crc32_table_ready == False) {
+        sub_build_tables();
+    }
+
+#   if (_CRC32_PCLMUL)
+    if (crc32_has_pclmul < 0) {
+        __builtin_cpu_init();
+        crc32_has_pclmul = (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"));
+    }
+    if ((crc32_has_pclmul > 0) && (length >= 64)) {
+        size_t bulk = length & ~(size_t)15;
+        crc     = sub_crc_pclmul(crc, data, bulk);
+        data   += bulk;
+        length -= bulk;
+    }
+#   endif
+
+    return sub_crc_slice8(crc, data, length);
+}
+
+
+
+
+/** CRC32 API <BR>
+  * ========================================================================<BR>
+  */
+
+ot_u32 crc32_update(ot_u32 crc, ot_u8* data, ot_u32 length) {
+    return (ot_u32)~sub_crc_engine(~(uint32_t)crc, data, (size_t)length);
+}
+
+
+ot_u32 crc32_calc_block(ot_u8* block_addr, ot_uint block_words) {
+    return crc32_update(0, block_addr, (ot_u32)block_words << 2);
 }
 
 
 
 void crc32_init_stream(ot_bool writeout, ot_uint stream_words, ot_u8* stream) {
     crc32.writeout  = writeout;
-    crc32.cursor    = stream - 1;               // -1 due to little-endian unaligned access mechanism
-    crc32.count     = stream_words + 1;         // +1 due to pre-decrement of counter
-    CRC->CR         = 1;
+    crc32.cursor    = stream;
+    crc32.count     = stream_words;
+    crc32.val       = 0xFFFFFFFF;
 }
 
 
 
 void crc32_calc_stream() {
-    crc.count--;
-    if (crc.count > 0) {
-        // This routine depends on the ability to do unaligned memory access,
-        // which the Cortex M3 and M4 can do, but the M0 cannot, nor can almost
-        // any other CPU.
-        ot_u32 scratch;
-        crc32.cursor   += 4;                        // little-endian byte ordering
-        scratch         = *(ot_u32*)crc32.cursor;
-        CRC->DR         = scratch;
-    }
-    else if ((crc.writeout) && (crc.count == 0)) {
-        // This uses unaligned write as opposed to unaligned read, above.
-        ot_u32 scratch          = CRC->DR;
-        crc32.cursor           += 4;
-        *(ot_u32*)crc32.cursor  = scratch;
-    }
+    crc32_calc_nstream(1);
 }
 
 
 
 void crc32_calc_nstream(ot_uint n_words) {
-    do {
-        crc32_calc_stream();
-    } while (--n_words);
+/// Words are consumed until the stream is exhausted.  The call after that
+/// writes out the CRC, if writeout is enabled.
+    ot_uint words;
+
+    if (crc32.count > 0) {
+        words = ((ot_int)n_words < crc32.count) ? n_words : (ot_uint)crc32.count;
+        crc32.val       = sub_crc_engine(crc32.val, crc32.cursor, (size_t)words << 2);
+        crc32.cursor   += (words << 2);
+        crc32.count    -= words;
+        n_words        -= words;
+    }
+    if ((n_words != 0) && (crc32.count == 0)) {
+        crc32.count--;
+        if (crc32.writeout) {
+            uint32_t scratch = ~crc32.val;
+            crc32.cursor[0] = (ot_u8)scratch;
+            crc32.cursor[1] = (ot_u8)(scratch >> 8);
+            crc32.cursor[2] = (ot_u8)(scratch >> 16);
+            crc32.cursor[3] = (ot_u8)(scratch >> 24);
+            crc32.cursor   += 4;
+        }
+    }
 }
 
 
 
 ot_bool crc32_check() {
-    return (CRC->DR == 0);
+/// For the check to work, the stream must include the CRC (i.e. stream_words
+/// is the data plus one word).  Running the CRC over the data and its CRC
+/// always leaves the same residue.
+    return (ot_bool)(crc32.val == CRC32_RESIDUE);
 }
 
 
-ot_u16 crc32_get() {
-    //return crc.val;
-    return CRC->DR;
+ot_u32 crc32_get() {
+    return (ot_u32)~crc32.val;
 }
 
-#endif
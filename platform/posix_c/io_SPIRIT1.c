@@ -1,4 +1,4 @@
-/* Copyright 2013 JP Norair
+/* Copyright 2013-2016 JP Norair
   *
   * Licensed under the OpenTag License, Version 1.0 (the "License");
   * you may not use this file except in compliance with the License.
@@ -14,415 +14,788 @@
   *
   */
 /**
-  * @file       /otradio/spirit1/SPIRIT1_STM32L1xx.h
+  * @file       /platform/posix_c/io_SPIRIT1.c
   * @author     JP Norair
-  * @version    R100
-  * @date       4 Jan 2013
-  * @brief      SPIRIT1 transceiver interface implementation for STM32L1xx
+  * @version    R101
+  * @date       20 Oct 2016
+  * @brief      SPIRIT1 transceiver interface implementation for POSIX C
   * @ingroup    SPIRIT1
   *
+  * On POSIX there is no SPIRIT1, so the SPI bus, pins and GPIO interrupts are
+  * implemented on a register-level model of the chip.  See
+  * include/io/spirit1/emulator.h for what the model covers and how to drive
+  * it.  The driver above this in io/spirit1 is not changed.
+  *
   ******************************************************************************
   */
 
 #include <otplatform.h>
-#if (OT_FEATURE(M2)) //defined(PLATFORM_STM32L1xx)
+#if (OT_FEATURE(M2) && defined(__SPIRIT1__))
 
-#include <otlib/utils.h>
 #include <otsys/types.h>
 #include <otsys/config.h>
-#include <m2/dll.h>
+#include <otlib/memcpy.h>
 
 #include <io/spirit1/config.h>
 #include <io/spirit1/interface.h>
+#include <io/spirit1/emulator.h>
 
-//For test
-#include <otlib/logger.h>
+#include <time.h>
 
 
 
+/// The POSIX boards don't have RF GPIO lines.  The model wires GPIOn to
+/// interrupt source n, with GPIO3 (READY) not used as an interrupt.
+#ifndef RADIO_IRQ0_SRCLINE
+#   define RADIO_IRQ0_SRCLINE   0
+#   define RADIO_IRQ1_SRCLINE   1
+#   define RADIO_IRQ2_SRCLINE   2
+#   define RADIO_IRQ3_SRCLINE   -1
+#endif
 
+/// Model clocks: digital clock (for the RX timer and data rate), RCO (for the
+/// LDC timer), and SPI bus (for the spi_us statistic).
+#ifndef SPIRIT1EMU_FDIG_HZ
+#   define SPIRIT1EMU_FDIG_HZ   24000000
+#endif
+#ifndef SPIRIT1EMU_FRCO_HZ
+#   define SPIRIT1EMU_FRCO_HZ   34700
+#endif
+#ifndef SPIRIT1EMU_SPI_HZ
+#   define SPIRIT1EMU_SPI_HZ    8000000
+#endif
 
+#define _FIFO_SIZE      96
+#define _FRAME_MAX      512
+
+/// MC_STATE0 state codes (bits 7:1)
+#define _MC_SHUTDOWN    0x00
+#define _MC_STANDBY     0x40
+#define _MC_SLEEP       0x36
+#define _MC_READY       0x03
+#define _MC_LOCK        0x0F
+#define _MC_RX          0x33
+#define _MC_TX          0x5F
+
+/// IRQ_STATUS bits (IRQ_STATUS3 is bits 31:24)
+#define _IRQ_RX_DATA_READY  (1UL<<0)
+#define _IRQ_TX_DATA_SENT   (1UL<<2)
+#define _IRQ_TX_FIFO_ERROR  (1UL<<5)
+#define _IRQ_RX_FIFO_ERROR  (1UL<<6)
+#define _IRQ_VALID_SYNC     (1UL<<13)
+#define _IRQ_WKUP_TOUT_LDC  (1UL<<15)
+#define _IRQ_POR            (1UL<<19)
+#define _IRQ_RX_TIMEOUT     (1UL<<29)
+#define _IRQ_AES_END        (1UL<<30)
+
+/// Pending chip events
+#define _EV_SYNC        (1<<0)
+#define _EV_AIREND      (1<<1)
+#define _EV_BYTE        (1<<2)
+#define _EV_RXTO        (1<<3)
+#define _EV_LDC         (1<<4)
+#define _EV_NUM         5
+
+
+typedef struct {
+    ot_u8   data[_FIFO_SIZE];
+    ot_u8   head;
+    ot_u8   count;
+} emu_fifo;
+
+typedef struct {
+    ot_bool active;
+    ot_u8   rssi;
+    ot_int  length;
+    ot_u32  sync;
+    ot_u8   data[_FRAME_MAX];
+} emu_frame;
+
+typedef struct {
+    ot_u32      now;
+    ot_u8       mc;
+    ot_u8       reg[256];
+    ot_u32      irq_status;
+    emu_fifo    rxf;
+    emu_fifo    txf;
+    ot_u8       bg_rssi;
+
+    ot_u8       lines;
+    ot_u8       sync_pulse;
+    ot_bool     in_isr;
+    ot_u32      ie;
+    ot_u32      pending;
+
+    ot_u8       armed;
+    ot_u32      due[_EV_NUM];
+    ot_bool     rx_synced;
+    ot_int      pkt_pos;
+
+    emu_frame   air;
+    ot_u8       txpkt[_FRAME_MAX];
+    spirit1emu_txfn txfn;
+    spirit1emu_stats stats;
+} emu_struct;
+
+static emu_struct emu;
+
+
+
+
+
+
+/** Model subroutines <BR>
+  * ========================================================================<BR>
+  */
 
+static ot_bool sub_fifo_put(emu_fifo* fifo, ot_u8 data) {
+    if (fifo->count >= _FIFO_SIZE) {
+        return False;
+    }
+    fifo->data[(fifo->head + fifo->count) % _FIFO_SIZE] = data;
+    fifo->count++;
+    return True;
+}
 
-/// RF IRQ GPIO Macros:
-#if (RADIO_IRQ3_SRCLINE < 0)
-#   define _READY_PORT  RADIO_IRQ3_PORT
-#   define _READY_PIN   RADIO_IRQ3_PIN
-#   undef _RFIRQ3
-#elif (RADIO_IRQ3_SRCLINE < 5)
-#   define _RFIRQ3  (EXTI0_IRQn + RADIO_IRQ3_SRCLINE)
-#elif ((RADIO_IRQ3_SRCLINE < 10) && !defined(_EXTI9_5_USED))
-#   define _EXTI9_5_USED
-#   define _RFIRQ3  (EXTI9_5_IRQn)
-#elif !defined(_EXTI15_10_USED)
-#   define _EXTI15_10_USED
-#   define _RFIRQ3  (EXTI15_10_IRQn)
-#endif
+static ot_u8 sub_fifo_get(emu_fifo* fifo) {
+    ot_u8 data = fifo->data[fifo->head];
+    fifo->head = (fifo->head + 1) % _FIFO_SIZE;
+    fifo->count--;
+    return data;
+}
 
+static ot_u32 sub_byte_us(void) {
+/// Data rate = fdig * (256 + DATARATE_M) * 2^DATARATE_E / 2^28
+    ot_u32 rate;
+    rate    = (SPIRIT1EMU_FDIG_HZ >> 8) * (256 + emu.reg[RFREG(MOD1)]);
+    rate  >>= (20 - (emu.reg[RFREG(MOD0)] & 0x0F));
+    return (rate == 0) ? 1000 : (8000000 + rate - 1) / rate;
+}
 
+static ot_u32 sub_presync_us(void) {
+    return (RF_PARAM_PREAMBLE_BYTES + RF_PARAM_SYNC_BYTES) * sub_byte_us();
+}
 
-#if (RADIO_IRQ0_SRCLINE < 0)
-#   undef _READY_PORT
-#   undef _READY_PIN
-#   define _READY_PORT  RADIO_IRQ2_PORT
-#   define _READY_PIN   RADIO_IRQ2_PIN
-#   undef _RFIRQ0
-#elif (RADIO_IRQ0_SRCLINE < 5)
-#   define _RFIRQ0  (EXTI0_IRQn + RADIO_IRQ0_SRCLINE)
-#elif (RADIO_IRQ0_SRCLINE < 10)
-#   define _EXTI9_5_USED
-#   define _RFIRQ0  (EXTI9_5_IRQn)
-#else
-#   define _EXTI15_10_USED
-#   define _RFIRQ0  (EXTI15_10_IRQn)
-#endif
+static ot_u32 sub_rxtimeout_us(void) {
+/// RX timeout = (TIMERS5 + 1) * TIMERS4 * 1210 / fdig.  TIMERS4 = 0 is no timeout
+    return ((ot_u32)(emu.reg[RFREG(TIMERS5)] + 1) * emu.reg[RFREG(TIMERS4)] * 1210) \
+            / (SPIRIT1EMU_FDIG_HZ / 1000000);
+}
 
-#if (RADIO_IRQ1_SRCLINE < 0)
-#   undef _READY_PORT
-#   undef _READY_PIN
-#   define _READY_PORT  RADIO_IRQ1_PORT
-#   define _READY_PIN   RADIO_IRQ1_PIN
-#   undef _RFIRQ1
-#elif (RADIO_IRQ1_SRCLINE < 5)
-#   define _RFIRQ1  (EXTI0_IRQn + RADIO_IRQ1_SRCLINE)
-#elif ((RADIO_IRQ0_SRCLINE < 10) && !defined(_EXTI9_5_USED))
-#   define _EXTI9_5_USED
-#   define _RFIRQ1  (EXTI9_5_IRQn)
-#elif !defined(_EXTI15_10_USED)
-#   define _EXTI15_10_USED
-#   define _RFIRQ1  (EXTI15_10_IRQn)
-#endif
+static ot_u32 sub_ldc_us(void) {
+/// LDC interval = (TIMERS3 + 1) * (TIMERS2 + 1) / frco
+    return ((ot_u32)(emu.reg[RFREG(TIMERS3)] + 1) * (emu.reg[RFREG(TIMERS2)] + 1) * 1000) \
+            / (SPIRIT1EMU_FRCO_HZ / 1000);
+}
 
-#if (RADIO_IRQ2_SRCLINE < 0)
-#   undef _READY_PORT
-#   undef _READY_PIN
-#   define _READY_PORT  RADIO_IRQ0_PORT
-#   define _READY_PIN   RADIO_IRQ0_PIN
-#   undef _RFIRQ2
-#elif (RADIO_IRQ2_SRCLINE < 5)
-#   define _RFIRQ2  (EXTI0_IRQn + RADIO_IRQ2_SRCLINE)
-#elif ((RADIO_IRQ2_SRCLINE < 10) && !defined(_EXTI9_5_USED))
-#   define _EXTI9_5_USED
-#   define _RFIRQ2  (EXTI9_5_IRQn)
-#elif !defined(_EXTI15_10_USED)
-#   define _EXTI15_10_USED
-#   define _RFIRQ2  (EXTI15_10_IRQn)
-#endif
+static ot_int sub_pktlen(void) {
+    ot_int len;
+    len = ((ot_int)emu.reg[RFREG(PCKTLEN1)] << 8) | emu.reg[RFREG(PCKTLEN0)];
+    return (len > 0) ? len : 1;
+}
 
+static ot_u32 sub_syncword(void) {
+    return  ((ot_u32)emu.reg[RFREG(SYNC1)] << 24) | ((ot_u32)emu.reg[RFREG(SYNC2)] << 16) \
+          | ((ot_u32)emu.reg[RFREG(SYNC3)] << 8)  |  (ot_u32)emu.reg[RFREG(SYNC4)];
+}
 
+static ot_bool sub_carrier(void) {
+    ot_u8 rssi = emu.air.active ? emu.air.rssi : emu.bg_rssi;
+    return (ot_bool)((emu.mc == _MC_RX) && (rssi >= emu.reg[RFREG(RSSI_TH)]));
+}
 
+static ot_bool sub_xo_on(void) {
+    return (ot_bool)((emu.mc == _MC_READY) || (emu.mc == _MC_LOCK) \
+                  || (emu.mc == _MC_RX) || (emu.mc == _MC_TX));
+}
 
+static void sub_arm(ot_u8 event, ot_u32 us) {
+    ot_int i;
+    for (i=0; (event>>i) != 1; i++);
+    emu.due[i]  = emu.now + us;
+    emu.armed  |= event;
+}
 
-/// SPI Bus Macros:
-/// Most are straightforward, but take special note of the clocking macros.
-/// On STM32L, the peripheral clock must be enabled for the peripheral to work.
-/// There are clock-enable bits for active and low-power mode.  Both should be
-/// enabled before SPI usage, and both disabled afterward.
-#if (RADIO_SPI_ID == 1)
-#   define _SPICLK          (PLATFORM_HSCLOCK_HZ/BOARD_PARAM_APB2CLKDIV)
-#   define _UART_IRQ        SPI1_IRQn
-#   define _DMA_ISR         platform_dma1ch2_isr
-#   define _DMARX           DMA1_Channel2
-#   define _DMATX           DMA1_Channel3
-#   define _DMARX_IRQ       DMA1_Channel2_IRQn
-#   define _DMATX_IRQ       DMA1_Channel3_IRQn
-#   define _DMARX_IFG       (0x2 << (4*(2-1)))
-#   define _DMATX_IFG       (0x2 << (4*(3-1)))
-#   define __DMA_CLEAR_IFG() (DMA1->IFCR = (0xF << (4*(2-1))) | (0xF << (4*(3-1))))
-#   define __SPI_CLKON()    (RCC->APB2ENR |= RCC_APB2ENR_SPI1EN)
-#   define __SPI_CLKOFF()   (RCC->APB2ENR &= ~RCC_APB2ENR_SPI1EN)
-
-#elif (RADIO_SPI_ID == 2)
-#   define _SPICLK          (PLATFORM_HSCLOCK_HZ/BOARD_PARAM_APB1CLKDIV)
-#   define _UART_IRQ        SPI2_IRQn
-#   define _DMA_ISR         platform_dma1ch4_isr
-#   define _DMARX           DMA1_Channel4
-#   define _DMATX           DMA1_Channel5
-#   define _DMARX_IRQ       DMA1_Channel4_IRQn
-#   define _DMATX_IRQ       DMA1_Channel5_IRQn
-#   define _DMARX_IFG       (0x2 << (4*(4-1)))
-#   define _DMATX_IFG       (0x2 << (4*(5-1)))
-#   define __DMA_CLEAR_IFG() (DMA1->IFCR = (0xF << (4*(4-1))) | (0xF << (4*(5-1))))
-#   define __SPI_CLKON()    (RCC->APB1ENR |= RCC_APB1ENR_SPI2EN)
-#   define __SPI_CLKOFF()   (RCC->APB1ENR &= ~RCC_APB1ENR_SPI2EN)
-
-#else
-#   error "RADIO_SPI_ID is misdefined, must be 1 or 2."
+static void sub_disarm(ot_u8 event) {
+    emu.armed &= ~event;
+}
 
-#endif
+static ot_u8 sub_mcstate0(void) {
+    return (ot_u8)((emu.mc << 1) | (sub_xo_on() ? 1 : 0));
+}
 
-/// Set-up SPI peripheral for Master Mode, Full Duplex, DMAs used for TRX.
-/// Configure SPI clock divider to make sure that clock rate is not above
-/// 10MHz.  SPI clock = bus clock/2, so only systems that have HSCLOCK
-/// above 20MHz need to divide.
-#   if (_SPICLK > 20000000)
-#       define _SPI_DIV (1<<3)
-#   else
-#       define _SPI_DIV (0<<3)
-#   endif
+static ot_u8 sub_mcstate1(void) {
+    return  (ot_u8)(((emu.txf.count >= _FIFO_SIZE) << 2) | ((emu.rxf.count == 0) << 1));
+}
 
 
-#define __DMA_CLEAR_IRQ()  (NVIC->ICPR[(ot_u32)(_DMARX_IRQ>>5)] = (1 << ((ot_u32)_DMARX_IRQ & 0x1F)))
-#define __DMA_ENABLE()     do { \
-                                _DMARX->CCR = (DMA_CCR1_MINC | DMA_CCR1_PL_VHI | DMA_CCR1_TCIE | DMA_CCR1_EN); \
-                                _DMATX->CCR |= (DMA_CCR1_DIR | DMA_CCR1_MINC | DMA_CCR1_PL_VHI | DMA_CCR1_EN); \
-                            } while(0)
-#define __DMA_DISABLE()    do { \
-                                _DMARX->CCR = 0; \
-                                _DMATX->CCR = 0; \
-                            } while(0)
 
-#define __SPI_CS_HIGH()     RADIO_SPICS_PORT->BSRRL = (ot_u32)RADIO_SPICS_PIN
-#define __SPI_CS_LOW()      RADIO_SPICS_PORT->BSRRH = (ot_u32)RADIO_SPICS_PIN
-#define __SPI_CS_ON()       __SPI_CS_LOW()
-#define __SPI_CS_OFF()      __SPI_CS_HIGH()
+static ot_u8 sub_signal(ot_u8 conf) {
+/// Output level of a GPIO, by its GPIOx_CONF setting.  Mode bits 1:0 must be
+/// digital output (2 or 3), otherwise the pin is an input or analog.
+    ot_u8 thr;
 
-#define __SPI_ENABLE()      do { \
-                                RADIO_SPI->CR2 = (SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN); \
-                                RADIO_SPI->SR  = 0; \
-                                RADIO_SPI->CR1 = (SPI_CR1_SSI | SPI_CR1_SSM | SPI_CR1_MSTR | _SPI_DIV | SPI_CR1_SPE); \
-                            } while(0)
+    if ((conf & 2) == 0) {
+        return 0;
+    }
+    switch (conf >> 3) {
+        case RFGPO_nIRQ:        return (emu.irq_status & \
+                                       (((ot_u32)emu.reg[RFREG(IRQ_MASK3)] << 24) \
+                                      | ((ot_u32)emu.reg[RFREG(IRQ_MASK2)] << 16) \
+                                      | ((ot_u32)emu.reg[RFREG(IRQ_MASK1)] << 8) \
+                                      |  (ot_u32)emu.reg[RFREG(IRQ_MASK0)])) == 0;
+        case RFGPO_nPOR:        return (emu.mc != _MC_SHUTDOWN);
+        case RFGPO_TX_INDICATOR: return (emu.mc == _MC_TX);
+        case RFGPO_TX_FIFO_ALMOST_EMPTY:
+                                thr = emu.reg[RFREG(FIFO_CONFIG0)] & 0x7F;
+                                return (emu.txf.count <= thr);
+        case RFGPO_TX_FIFO_ALMOST_FULL:
+                                thr = emu.reg[RFREG(FIFO_CONFIG1)] & 0x7F;
+                                return (emu.txf.count >= (_FIFO_SIZE - thr));
+        case RFGPO_RX_STATE_INDICATOR: return (emu.mc == _MC_RX);
+        case RFGPO_RX_FIFO_ALMOST_FULL:
+                                thr = emu.reg[RFREG(FIFO_CONFIG3)] & 0x7F;
+                                return (emu.rxf.count >= (_FIFO_SIZE - thr));
+        case RFGPO_RX_FIFO_ALMOST_EMPTY:
+                                thr = emu.reg[RFREG(FIFO_CONFIG2)] & 0x7F;
+                                return (emu.rxf.count <= thr);
+        case RFGPO_SYNC_WORD:   return emu.sync_pulse;
+        case RFGPO_RSSI_ABOVE_THR: return sub_carrier();
+        case RFGPO_TRX_INDICATOR: return ((emu.mc == _MC_RX) || (emu.mc == _MC_TX));
+        case RFGPO_VDD:         return 1;
+        case RFGPO_SLEEP_OR_STANDBY: return ((emu.mc == _MC_SLEEP) || (emu.mc == _MC_STANDBY));
+        case RFGPO_READY:       return sub_xo_on();
+        case RFGPO_LOCK:        return (emu.mc == _MC_LOCK);
+        default:                return 0;
+    }
+}
 
-#define __SPI_DISABLE()     (RADIO_SPI->CR1 = (SPI_CR1_SSI | SPI_CR1_SSM | SPI_CR1_MSTR | _SPI_DIV))
-#define __SPI_GET(VAL)      VAL = RADIO_SPI->DR
-#define __SPI_PUT(VAL)      RADIO_SPI->DR = VAL
 
+static void sub_dispatch(void) {
+/// ISRs don't nest: an edge raised while an ISR runs is taken after it returns
+    static const ot_u32 source[3] = { RFI_SOURCE0, RFI_SOURCE1, RFI_SOURCE2 };
+    static void (*const isr[3])(void) = { &spirit1_irq0_isr, &spirit1_irq1_isr, &spirit1_irq2_isr };
+    ot_int i;
 
+    if (emu.in_isr) {
+        return;
+    }
+    emu.in_isr = True;
+
+    for (i=0; (emu.pending & emu.ie & RFI_ALL) != 0; i=(i+1)%3) {
+        if (emu.pending & emu.ie & source[i]) {
+            struct timespec t0, t1;
+            emu.pending &= ~source[i];
+            emu.stats.isr_calls[i]++;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            isr[i]();
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            emu.stats.isr_ns[i] += (ot_u32)((t1.tv_sec - t0.tv_sec) * 1000000000L \
+                                            + (t1.tv_nsec - t0.tv_nsec));
+        }
+    }
 
+    emu.in_isr = False;
+}
 
-/** Embedded Interrupts <BR>
-  * ========================================================================<BR>
-  * None: The Radio core only uses the GPIO interrupts, which must be handled
-  * universally in platform_isr_STM32L1xx.c due to the multiplexed nature of
-  * the EXTI system.  However, the DMA RX complete EVENT is used by the SPI
-  * engine.  EVENTS are basically a way to sleep where you would otherwise
-  * need to use busywait loops.  ARM Cortex-M takes all 3 points.
-  */
 
+static void sub_update_lines(void) {
+/// GPIO0 interrupts on falling edge, GPIO1 and GPIO2 on rising edge, which is
+/// how the hardware drivers configure the MCU.  GPIO3 has no interrupt.
+    ot_u8 lines;
+    ot_u8 edges;
 
+    lines   = sub_signal(emu.reg[RFREG(GPIO0_CONF)]);
+    lines  |= sub_signal(emu.reg[RFREG(GPIO1_CONF)]) << 1;
+    lines  |= sub_signal(emu.reg[RFREG(GPIO2_CONF)]) << 2;
+    lines  |= sub_signal(emu.reg[RFREG(GPIO3_CONF)]) << 3;
+    edges   = (emu.lines & ~lines & 0x01) | (~emu.lines & lines & 0x06);
+    emu.lines = lines;
 
+    if (edges & 0x01)   emu.pending |= RFI_SOURCE0;
+    if (edges & 0x02)   emu.pending |= RFI_SOURCE1;
+    if (edges & 0x04)   emu.pending |= RFI_SOURCE2;
 
-/** Pin Check Functions <BR>
-  * ========================================================================
-  */
-inline ot_uint spirit1_resetpin_ishigh(void)   { return (RADIO_IRQ0_PORT->IDR & RADIO_IRQ0_PIN); }
-inline ot_uint spirit1_abortpin_ishigh(void)   { return (RADIO_IRQ0_PORT->IDR & RADIO_IRQ0_PIN); }
-inline ot_uint spirit1_readypin_ishigh(void)   { return (_READY_PORT->IDR & _READY_PIN); }
-inline ot_uint spirit1_cspin_ishigh(void)      { return (RADIO_IRQ2_PORT->IDR & RADIO_IRQ2_PIN); }
-inline ot_uint spirit1_sdnpin_setlow(void)     { return (RADIO_SDN_PORT->BSRRH = RADIO_SDN_PIN); }
-inline ot_uint spirit1_sdnpin_sethigh(void)    { return (RADIO_SDN_PORT->BSRRL = RADIO_SDN_PIN); }
+    sub_dispatch();
+}
 
 
 
-/** Bus interface (SPI + 2x GPIO) <BR>
-  * ========================================================================
-  */
+static void sub_goto(ot_u8 mc) {
+    ot_u8 old_mc = emu.mc;
+    emu.mc = mc;
 
-void spirit1_init_bus() {
-/// @note platform_init_periphclk() should have alread enabled RADIO_SPI clock
-/// and GPIO clocks
-    ot_u16 scratch;
+    if ((old_mc == _MC_RX) || (old_mc == _MC_TX)) {
+        sub_disarm(_EV_BYTE | _EV_RXTO);
+        emu.rx_synced   = False;
+        emu.sync_pulse  = 0;
+    }
+    if (mc == _MC_RX) {
+        emu.rx_synced   = False;
+        emu.pkt_pos     = 0;
+        if (emu.reg[RFREG(TIMERS4)] != 0) {
+            sub_arm(_EV_RXTO, sub_rxtimeout_us());
+        }
+    }
+    else if (mc == _MC_TX) {
+        emu.pkt_pos     = 0;
+        emu.stats.tx_trough = emu.txf.count;
+        sub_arm(_EV_BYTE, sub_presync_us() + sub_byte_us());
+    }
+    if ((mc != _MC_SLEEP) && (mc != _MC_RX)) {
+        sub_disarm(_EV_LDC);
+    }
+}
 
-    ///0. Preliminary Stuff
-#   if (BOARD_FEATURE_RFXTALOUT)
-    spirit1.clkreq = False;
-#   endif
 
-    ///1. Assure that Shutdown Line is Low
-    spirit1_sdnpin_setlow();
+static void sub_reset(void) {
+    memset(emu.reg, 0, sizeof(emu.reg));
+    emu.reg[RFREG(GPIO3_CONF)]      = RFGPO(GND);
+    emu.reg[RFREG(GPIO2_CONF)]      = RFGPO(GND);
+    emu.reg[RFREG(GPIO1_CONF)]      = RFGPO(GND);
+    emu.reg[RFREG(GPIO0_CONF)]      = RFGPO(nPOR);
+    emu.reg[RFREG(MOD1)]            = 0x83;
+    emu.reg[RFREG(MOD0)]            = 0x1A;
+    emu.reg[RFREG(RSSI_TH)]         = 0x24;
+    emu.reg[RFREG(PCKTLEN0)]        = 0x14;
+    emu.reg[RFREG(SYNC4)]           = 0x88;
+    emu.reg[RFREG(SYNC3)]           = 0x88;
+    emu.reg[RFREG(SYNC2)]           = 0x88;
+    emu.reg[RFREG(SYNC1)]           = 0x88;
+    emu.reg[RFREG(FIFO_CONFIG3)]    = 0x30;
+    emu.reg[RFREG(FIFO_CONFIG2)]    = 0x30;
+    emu.reg[RFREG(FIFO_CONFIG1)]    = 0x30;
+    emu.reg[RFREG(FIFO_CONFIG0)]    = 0x30;
+    emu.reg[RFREG(TIMERS5)]         = 0x01;
+    emu.reg[RFREG(TIMERS3)]         = 0x01;
+    emu.reg[RFREG(TIMERS2)]         = 0x01;
+    emu.reg[RFREG(DEVICE_INFO1)]    = 0x01;
+    emu.reg[RFREG(DEVICE_INFO0)]    = 0x30;
+    emu.rxf.head    = 0;
+    emu.rxf.count   = 0;
+    emu.txf.head    = 0;
+    emu.txf.count   = 0;
+    emu.irq_status  = _IRQ_POR;
+    emu.armed      &= (_EV_SYNC | _EV_AIREND);
+    emu.mc          = _MC_READY;
+    emu.rx_synced   = False;
+    emu.sync_pulse  = 0;
+}
 
-    ///2. Set-up DMA to work with SPI.  The DMA is bound to the SPI and it is
-    ///   used for Duplex TX+RX.  The DMA RX Channel is used as an EVENT.  The
-    ///   STM32L can do in-context naps using EVENTS.  To enable the EVENT, we
-    ///   enable the DMA RX interrupt bit, but not the NVIC.
-    BOARD_DMA_CLKON();
-    _DMARX->CMAR    = (ot_u32)&spirit1.status;
-    _DMARX->CPAR    = (ot_u32)&RADIO_SPI->DR;
-    _DMATX->CPAR    = (ot_u32)&RADIO_SPI->DR;
-    BOARD_DMA_CLKOFF();
-
-    // Don't enable NVIC, because we want an EVENT, not an interrupt.
-    //NVIC->IP[(ot_u32)_DMARX_IRQ]        = PLATFORM_NVIC_RF_GROUP;
-    //NVIC->ISER[(ot_u32)(_DMARX_IRQ>>5)] = (1 << ((ot_u32)_DMARX_IRQ & 0x1F));
-
-    /// 3. Connect GPIOs from SPIRIT1 to STM32L External Interrupt sources
-    /// The GPIO configuration should be done in BOARD_PORT_STARTUP() and the
-    /// binding of each GPIO to the corresponding EXTI should be done in
-    /// BOARD_EXTI_STARTUP().  This architecture is required because the STM32L
-    /// External interrupt mechanism must be shared by all drivers, and we can
-    /// only know this information at the board level.
-    ///
-    /// However, here we set the EXTI lines to the rising edge triggers we need
-    /// and configure the NVIC.  Eventually, the NVIC stuff might be done in
-    /// the platform module JUST FOR EXTI interrupts though.
-
-    EXTI->PR    =  RFI_ALL;         //clear flag bits
-    EXTI->IMR  &= ~RFI_ALL;         //clear interrupt enablers
-    EXTI->EMR  &= ~RFI_ALL;         //clear event enablers
-
-    // PIN0 is falling edge, 1 & 2 are rising edge
-    EXTI->FTSR |= (RFI_SOURCE0 /*| RFI_SOURCE1*/);
-    EXTI->RTSR |= (RFI_SOURCE1 | RFI_SOURCE2);
-
-    ///@note This block redefines priorities of the RF GPIO interrupts.
-    ///      It is not always required, since default EXTI prorities are
-    ///      already defined at startup, and they are usually the same.
-#   if (PLATFORM_NVIC_RF_GROUP != PLATFORM_NVIC_IO_GROUP)
-    NVIC->IP[(uint32_t)_RFIRQ0]         = (PLATFORM_NVIC_RF_GROUP << 4);
-    NVIC->ISER[((uint32_t)_RFIRQ0>>5)]  = (1 << ((uint32_t)_RFIRQ0 & 0x1F));
-#   ifdef _RFIRQ1
-    NVIC->IP[(uint32_t)_RFIRQ1]         = (PLATFORM_NVIC_RF_GROUP << 4);
-    NVIC->ISER[((uint32_t)_RFIRQ1>>5)]  = (1 << ((uint32_t)_RFIRQ1 & 0x1F));
-#   endif
-#   ifdef _RFIRQ2
-    NVIC->IP[(uint32_t)_RFIRQ2]         = (PLATFORM_NVIC_RF_GROUP << 4);
-    NVIC->ISER[((uint32_t)_RFIRQ2>>5)]  = (1 << ((uint32_t)_RFIRQ2 & 0x1F));
-#   endif
-#   ifdef _RFIRQ3
-    NVIC->IP[(uint32_t)_RFIRQ3]         = (PLATFORM_NVIC_RF_GROUP << 4);
-    NVIC->ISER[((uint32_t)_RFIRQ3>>5)]  = (1 << ((uint32_t)_RFIRQ3 & 0x1F));
-#   endif
-#   endif
 
-    ///4. The best way to wait for the SPIRIT1 to start is to wait for the reset
-    ///   line to come high.  Once it is high, the chip is in ready.
-    spirit1_waitforreset();
+static void sub_strobe(ot_u8 strobe) {
+    ot_bool ready = (ot_bool)((emu.mc == _MC_READY) || (emu.mc == _MC_LOCK));
+
+    switch (strobe) {
+        case RFSTROBE_TX:       if (ready) sub_goto(_MC_TX);
+                                break;
+        case RFSTROBE_RX:       if (ready) sub_goto(_MC_RX);
+                                break;
+        case RFSTROBE_READY:    if ((emu.mc == _MC_STANDBY) || (emu.mc == _MC_SLEEP) \
+                                 || (emu.mc == _MC_LOCK)) sub_goto(_MC_READY);
+                                break;
+        case RFSTROBE_STANDBY:  if (emu.mc == _MC_READY) sub_goto(_MC_STANDBY);
+                                break;
+        case RFSTROBE_SLEEP:    if (emu.mc == _MC_READY) sub_goto(_MC_SLEEP);
+                                break;
+        case RFSTROBE_LOCKRX:
+        case RFSTROBE_LOCKTX:   if (ready) sub_goto(_MC_LOCK);
+                                break;
+        case RFSTROBE_SABORT:   if ((emu.mc == _MC_RX) || (emu.mc == _MC_TX) \
+                                 || (emu.mc == _MC_LOCK) || (emu.mc == _MC_SLEEP)) {
+                                    sub_goto(_MC_READY);
+                                }
+                                break;
+        case RFSTROBE_LDC_RELOAD: if (emu.reg[RFREG(PROTOCOL2)] & _LDC_MODE) {
+                                    sub_arm(_EV_LDC, sub_ldc_us());
+                                }
+                                break;
+        case RFSTROBE_AES_ENC:
+        case RFSTROBE_AES_KEY:
+        case RFSTROBE_AES_DEC:
+        case RFSTROBE_AES_KEYDEC: emu.irq_status |= _IRQ_AES_END;
+                                break;
+        case RFSTROBE_SRES:     sub_reset();
+                                break;
+        case RFSTROBE_FLUSHRXFIFO: emu.rxf.count = 0;
+                                break;
+        case RFSTROBE_FLUSHTXFIFO: emu.txf.count = 0;
+                                break;
+        default:                break;
+    }
+}
 
-    ///5. Take GPIOs out of pull-down and into floating mode.  This is to save
-    ///   energy, which could otherwise just be draining over the pull-downs.
-    ///@todo this
 
-    ///6. Put the SPIRIT1 into a default IO configuration, and then to sleep.
-    ///   It is important to expose the READY signal on GPIO0, because the
-    ///   driver needs this signal to confirm state changes.
+static void sub_regwrite(ot_u8 addr, ot_u8 data) {
+/// Registers from MC_STATE1 up are read-only, except for the FIFO
+    if (addr == RFREG(FIFO)) {
+        if (sub_fifo_put(&emu.txf, data) == False) {
+            emu.stats.tx_overflows++;
+            emu.irq_status |= _IRQ_TX_FIFO_ERROR;
+        }
+    }
+    else if (addr < RFREG(MC_STATE1)) {
+        emu.reg[addr] = data;
+    }
 }
 
 
+static ot_u8 sub_regread(ot_u8 addr) {
+    ot_u8 data;
+
+    switch (addr) {
+        case RFREG(MC_STATE1):  return sub_mcstate1();
+        case RFREG(MC_STATE0):  return sub_mcstate0();
+        case RFREG(LINEAR_FIFO_STATUS1): return emu.txf.count;
+        case RFREG(LINEAR_FIFO_STATUS0): return emu.rxf.count;
+        case RFREG(FIFO):
+            if (emu.rxf.count == 0) {
+                emu.stats.rx_underreads++;
+                return 0;
+            }
+            return sub_fifo_get(&emu.rxf);
+
+        // IRQ status bytes clear as they are read
+        case RFREG(IRQ_STATUS3):
+        case RFREG(IRQ_STATUS2):
+        case RFREG(IRQ_STATUS1):
+        case RFREG(IRQ_STATUS0): {
+            ot_int shift = (RFREG(IRQ_STATUS0) - addr) * 8;
+            data = (ot_u8)(emu.irq_status >> shift);
+            emu.irq_status &= ~((ot_u32)0xFF << shift);
+            return data;
+        }
+        default: return emu.reg[addr];
+    }
+}
 
-void spirit1_spibus_wait() {
-/// Blocking wait for SPI bus to be over
-    while (RADIO_SPI->SR & SPI_SR_BSY);
+
+
+static void sub_event_sync(void) {
+/// The sync word of the packet on the air has ended
+    if ((emu.mc == _MC_RX) && (emu.rx_synced == False) \
+    && ((emu.air.sync == 0) || (emu.air.sync == sub_syncword()))) {
+        emu.stats.rx_syncs++;
+        emu.rx_synced   = True;
+        emu.sync_pulse  = 1;
+        emu.pkt_pos     = 0;
+        emu.irq_status |= _IRQ_VALID_SYNC;
+        emu.reg[RFREG(RSSI_LEVEL)]      = emu.air.rssi;
+        emu.reg[RFREG(LINK_QUALIF2)]    = 0x7F;
+        emu.reg[RFREG(LINK_QUALIF1)]    = 0x80 | 0x40;
+        emu.reg[RFREG(LINK_QUALIF0)]    = 0xF0;
+        if (emu.reg[RFREG(PROTOCOL2)] & _SQI_TIMEOUT_MASK) {
+            sub_disarm(_EV_RXTO);
+        }
+        sub_arm(_EV_BYTE, sub_byte_us());
+    }
+    else {
+        emu.stats.rx_missed++;
+    }
 }
 
 
+static void sub_event_rxtimeout(void) {
+    if ((emu.reg[RFREG(PROTOCOL2)] & _CS_TIMEOUT_MASK) && sub_carrier()) {
+        return;
+    }
+    emu.irq_status |= _IRQ_RX_TIMEOUT;
+    emu.reg[RFREG(RSSI_LEVEL)] = emu.air.active ? emu.air.rssi : emu.bg_rssi;
 
+    // LDC mode sleeps until the LDC timer re-enters RX
+    if (emu.reg[RFREG(PROTOCOL2)] & _LDC_MODE) {
+        sub_goto(_MC_SLEEP);
+        sub_arm(_EV_LDC, sub_ldc_us());
+    }
+    else {
+        sub_goto(_MC_READY);
+    }
+}
 
-void spirit1_spibus_io(ot_u8 cmd_len, ot_u8 resp_len, ot_u8* cmd) {
-///@note BOARD_DMA_CLKON() must be defined in the board support header as a
-/// macro or inline function.  As the board may be using DMA for numerous
-/// peripherals, we cannot assume in this module if it is appropriate to turn-
-/// off the DMA for all other modules.
-
-    platform_disable_interrupts();
-    __SPI_CLKON();
-    __SPI_ENABLE();
-    __SPI_CS_ON();
-
-    /// Set-up DMA, and trigger it.  TX goes out from parameter.  RX goes into
-    /// module buffer.  If doing a read, the garbage data getting duplexed onto
-    /// TX doesn't affect the SPIRIT1.  If doing a write, simply disregard the
-    /// RX duplexed data.
-    BOARD_RFSPI_CLKON();
-    BOARD_DMA_CLKON();
-    __DMA_CLEAR_IFG();
-    cmd_len        += resp_len;
-    _DMARX->CNDTR   = cmd_len;
-    _DMATX->CNDTR   = cmd_len;
-    _DMATX->CMAR    = (ot_u32)cmd;
-    __DMA_ENABLE();
-
-    /// Use Cortex-M WFE (Wait For Event) to hold until DMA is complete.  This
-    /// is the CM way of doing a busywait loop, but turning off the CPU core.
-    /// The while loop is for safety purposes, in case another event comes.
-    //do {
-        //__WFE();
-    //}
-    while((DMA1->ISR & _DMARX_IFG) == 0);
-    __DMA_CLEAR_IRQ();
-    __DMA_CLEAR_IFG();
-    __DMA_DISABLE();
-
-    /// Turn-off and disable SPI to save energy
-    __SPI_CS_OFF();
-    __SPI_DISABLE();
-    __SPI_CLKOFF();
-    BOARD_DMA_CLKOFF();
-    BOARD_RFSPI_CLKOFF();
-    platform_enable_interrupts();
+
+static void sub_event_ldc(void) {
+    emu.irq_status |= _IRQ_WKUP_TOUT_LDC;
+    if ((emu.mc == _MC_SLEEP) && (emu.reg[RFREG(PROTOCOL2)] & _LDC_MODE)) {
+        sub_goto(_MC_RX);
+    }
 }
 
 
+static void sub_event_rxbyte(void) {
+    ot_u8 data;
+
+    emu.sync_pulse = 0;
+    data = ((emu.pkt_pos < emu.air.length) && emu.air.active) ? emu.air.data[emu.pkt_pos] : 0;
+
+    if (sub_fifo_put(&emu.rxf, data)) {
+        emu.stats.rx_bytes++;
+        if (emu.rxf.count > emu.stats.rx_peak) {
+            emu.stats.rx_peak = emu.rxf.count;
+        }
+    }
+    else {
+        emu.stats.rx_overflows++;
+        emu.irq_status |= _IRQ_RX_FIFO_ERROR;
+    }
 
+    if (++emu.pkt_pos < sub_pktlen()) {
+        sub_arm(_EV_BYTE, sub_byte_us());
+    }
+    else {
+        emu.stats.rx_packets++;
+        emu.irq_status |= _IRQ_RX_DATA_READY;
+        emu.reg[RFREG(RX_PCKT_LEN1)] = (ot_u8)(emu.pkt_pos >> 8);
+        emu.reg[RFREG(RX_PCKT_LEN0)] = (ot_u8)emu.pkt_pos;
+        sub_goto(_MC_READY);
+        if (emu.reg[RFREG(PROTOCOL0)] & _PERS_RX) {
+            sub_goto(_MC_RX);
+        }
+    }
+}
 
 
+static void sub_event_txbyte(void) {
+    if (emu.txf.count == 0) {
+        emu.stats.tx_underflows++;
+        emu.irq_status |= _IRQ_TX_FIFO_ERROR;
+        sub_goto(_MC_READY);
+        return;
+    }
 
-/** Common GPIO setup & interrupt functions  <BR>
+    {   ot_u8 data = sub_fifo_get(&emu.txf);
+        if (emu.pkt_pos < _FRAME_MAX) {
+            emu.txpkt[emu.pkt_pos] = data;
+        }
+        emu.pkt_pos++;
+        emu.stats.tx_bytes++;
+        if (emu.txf.count < emu.stats.tx_trough) {
+            emu.stats.tx_trough = emu.txf.count;
+        }
+    }
+
+    if (emu.pkt_pos < sub_pktlen()) {
+        sub_arm(_EV_BYTE, sub_byte_us());
+        return;
+    }
+
+    emu.stats.tx_packets++;
+    emu.irq_status |= _IRQ_TX_DATA_SENT;
+    if (emu.txfn != NULL) {
+        emu.txfn(sub_syncword(), emu.txpkt, (emu.pkt_pos < _FRAME_MAX) ? emu.pkt_pos : _FRAME_MAX);
+    }
+
+    // Persistent TX (floods) starts the next packet, with a new preamble
+    if (emu.reg[RFREG(PROTOCOL0)] & _PERS_TX) {
+        emu.pkt_pos = 0;
+        sub_arm(_EV_BYTE, sub_presync_us() + sub_byte_us());
+    }
+    else {
+        sub_goto(_MC_READY);
+    }
+}
+
+
+static void sub_event(ot_u8 event) {
+    sub_disarm(event);
+    switch (event) {
+        case _EV_SYNC:      sub_event_sync();       break;
+        case _EV_AIREND:    emu.air.active = False; break;
+        case _EV_RXTO:      if (emu.mc == _MC_RX) sub_event_rxtimeout();
+                            break;
+        case _EV_LDC:       sub_event_ldc();        break;
+        case _EV_BYTE:      if (emu.mc == _MC_TX)       sub_event_txbyte();
+                            else if (emu.rx_synced)     sub_event_rxbyte();
+                            break;
+        default:            break;
+    }
+    sub_update_lines();
+}
+
+
+
+
+
+
+/** Emulator control <BR>
   * ========================================================================<BR>
-  * Your radio ISR function should be of the type void radio_isr(ot_u8), as it
-  * will be a soft ISR.  The input parameter is an interrupt vector.  The vector
-  * values are shown below:
-  *
-  * -------------- RX MODES (set spirit1_iocfg_rx()) --------------
-  * IMode = 0       RX Timeout (Finished):      0
-  * (Listen)        Sync word RX'ed:            1
-  *                 RX FIFO thr [IRQ off]:      -
-  *
-  * IMode = 2       RX Finished:                2
-  * (RX Data)       RX discarded (un-sync):     3
-  *                 RX FIFO threshold:          4
-  *
-  * -------------- TX MODES (set spirit1_iocfg_tx()) --------------
-  * IMode = 5       CCA Sense Timeout:          5   (pass)
-  * (CSMA)          CS Indicator:               6   (fail)
-  *                 TX FIFO thr [IRQ off]:      -
-  *
-  * IMode = 7       TX finished:                7
-  * (TX)            CS Indicator [IRQ off]:     -
-  *                 TX FIFO threshold:          9
   */
 
+void spirit1emu_reset(void) {
+    sub_goto(_MC_SHUTDOWN);
+    sub_reset();
+    sub_update_lines();
+}
 
-/// Simple configuration method:
-/// This I/O configuration does not use many of the SPIRIT1 advanced features.
-/// Those features will be experimented-with in the future.
+void spirit1emu_run(ot_u32 us) {
+    ot_u32 target = emu.now + us;
+
+    while (1) {
+        ot_u8   event = 0;
+        ot_u32  t     = target;
+        ot_int  i;
+
+        for (i=0; i<_EV_NUM; i++) {
+            if ((emu.armed & (1<<i)) && ((ot_long)(emu.due[i] - t) <= 0)) {
+                t       = emu.due[i];
+                event   = (1<<i);
+            }
+        }
+        if (event == 0) {
+            break;
+        }
+        emu.now = t;
+        sub_event(event);
+    }
+    emu.now = target;
+}
 
-///@todo test packet-discarding method, see if nIRQ must be added for RX
+ot_u32 spirit1emu_time(void) {
+    return emu.now;
+}
 
+void spirit1emu_set_rssi(ot_u8 rssi) {
+    emu.bg_rssi = rssi;
+    sub_update_lines();
+}
 
-void spirit1_int_config(ot_u32 ie_sel) {
-    ot_u32 scratch;
-    EXTI->PR    = (ot_u32)RFI_ALL;
-    scratch     = EXTI->IMR;
-    scratch    &= ~((ot_u32)RFI_ALL);
-    scratch    |= ie_sel;
-    EXTI->IMR   = scratch;
+ot_int spirit1emu_inject(ot_u32 sync, ot_u8 rssi, const ot_u8* data, ot_int length) {
+    if (emu.air.active || (length < 0)) {
+        return -1;
+    }
+    if (length > _FRAME_MAX) {
+        length = _FRAME_MAX;
+    }
+    memcpy(emu.air.data, data, length);
+    emu.air.active  = True;
+    emu.air.sync    = sync;
+    emu.air.rssi    = rssi;
+    emu.air.length  = length;
+    sub_arm(_EV_SYNC, sub_presync_us());
+    sub_arm(_EV_AIREND, sub_presync_us() + (length * sub_byte_us()));
+    sub_update_lines();
+    return 0;
 }
 
+void spirit1emu_set_txfn(spirit1emu_txfn txfn) {
+    emu.txfn = txfn;
+}
 
-void spirit1_int_txdone() {
-    ot_u32 scratch;
-    scratch     = EXTI->IMR & ~RFI_TXFIFO;
-    scratch    |= RFI_TXEND;
-    EXTI->PR    = RFI_TXEND;
-    EXTI->IMR   = scratch;
+ot_u8 spirit1emu_peek(ot_u8 addr) {
+    switch (addr) {
+        case RFREG(MC_STATE1):  return sub_mcstate1();
+        case RFREG(MC_STATE0):  return sub_mcstate0();
+        case RFREG(LINEAR_FIFO_STATUS1): return emu.txf.count;
+        case RFREG(LINEAR_FIFO_STATUS0): return emu.rxf.count;
+        case RFREG(IRQ_STATUS3): return (ot_u8)(emu.irq_status >> 24);
+        case RFREG(IRQ_STATUS2): return (ot_u8)(emu.irq_status >> 16);
+        case RFREG(IRQ_STATUS1): return (ot_u8)(emu.irq_status >> 8);
+        case RFREG(IRQ_STATUS0): return (ot_u8)emu.irq_status;
+        default:                return emu.reg[addr];
+    }
 }
 
+const spirit1emu_stats* spirit1emu_getstats(void) {
+    return &emu.stats;
+}
 
-inline void spirit1_int_clearall(void) {
-    EXTI->PR = RFI_ALL;
+void spirit1emu_clearstats(void) {
+    memset((ot_u8*)&emu.stats, 0, sizeof(spirit1emu_stats));
 }
 
-inline void spirit1_int_force(ot_u16 ifg_sel) { 
-    EXTI->SWIER |= (ot_u32)ifg_sel; 
+
+
+
+
+
+/** Pin Check Functions <BR>
+  * ========================================================================<BR>
+  * GPIO0 is nPOR after reset and TRX indicator while the driver runs, GPIO3
+  * is READY.  Carrier sense is read from the model directly, because the
+  * driver moves RSSI_ABOVE_THR between pins.
+  */
+ot_uint spirit1_resetpin_ishigh(void)   { return (emu.lines & 0x01); }
+ot_uint spirit1_abortpin_ishigh(void)   { return (emu.lines & 0x01); }
+ot_uint spirit1_readypin_ishigh(void)   { return (emu.lines & 0x08); }
+ot_uint spirit1_cspin_ishigh(void)      { return (ot_uint)sub_carrier(); }
+
+ot_uint spirit1_sdnpin_setlow(void) {
+    if (emu.mc == _MC_SHUTDOWN) {
+        sub_reset();
+        sub_update_lines();
+    }
+    return 0;
 }
 
-inline void spirit1_int_turnon(ot_u16 ie_sel) { 
-    EXTI->IMR   |= (ot_u32)ie_sel;  
+ot_uint spirit1_sdnpin_sethigh(void) {
+    sub_goto(_MC_SHUTDOWN);
+    sub_update_lines();
+    return 1;
 }
 
-inline void spirit1_int_turnoff(ot_u16 ie_sel)  {
-    EXTI->PR    = (ot_u32)ie_sel;
-    EXTI->IMR  &= ~((ot_u32)ie_sel);
+
+
+/** Bus interface (SPI + 2x GPIO) <BR>
+  * ========================================================================
+  */
+
+void spirit1_init_bus() {
+#   if (BOARD_FEATURE_RFXTALOUT)
+    spirit1.clkreq = False;
+#   endif
+
+    /// The model is in SHUTDOWN until the shutdown line goes low
+    emu.ie      = 0;
+    emu.pending = 0;
+    spirit1_sdnpin_setlow();
+    spirit1_waitforreset();
+}
+
+
+void spirit1_spibus_wait() {
+/// The emulated bus is never busy
+}
+
+
+void spirit1_spibus_io(ot_u8 cmd_len, ot_u8 resp_len, ot_u8* cmd) {
+/// cmd[0] is the header: 0 = write, 1 = read, 0x80 = command (strobe).
+/// cmd[1] is the address or the strobe.  Status goes to spirit1.status, in the
+/// same byte order as the DMA implementations, and read data to busrx.
+    ot_u8 addr = cmd[1];
+    ot_int i;
+
+    emu.stats.spi_transfers++;
+    emu.stats.spi_bytes    += cmd_len + resp_len;
+    emu.stats.spi_us       += ((cmd_len + resp_len) * 8 * 1000000UL) / SPIRIT1EMU_SPI_HZ;
+
+    spirit1.status = (ot_u16)sub_mcstate1() | ((ot_u16)sub_mcstate0() << 8);
+
+    switch (cmd[0]) {
+        case 0x00:
+            for (i=2; i<cmd_len; i++) {
+                sub_regwrite(addr, cmd[i]);
+                addr += (addr != RFREG(FIFO));
+            }
+            break;
+
+        case 0x01:
+            if (resp_len > sizeof(spirit1.busrx)) {
+                resp_len = sizeof(spirit1.busrx);
+            }
+            for (i=0; i<resp_len; i++) {
+                spirit1.busrx[i] = sub_regread(addr);
+                addr += (addr != RFREG(FIFO));
+            }
+            break;
+
+        case 0x80:
+            sub_strobe(addr);
+            break;
+
+        default:
+            break;
+    }
+
+    sub_update_lines();
 }
 
 
@@ -430,38 +803,67 @@ inline void spirit1_int_turnoff(ot_u16 ie_sel)  {
 
 
 
+/** Common GPIO setup & interrupt functions  <BR>
+  * ========================================================================<BR>
+  * Emulates the MCU external interrupt block: a pending flag is set on each
+  * edge, whether the source is enabled or not, and the ISR runs when both
+  * pending and enable are set.  See interface.h for the ISR vectors.
+  */
 
+void spirit1_int_config(ot_u32 ie_sel) {
+    emu.pending    &= ~RFI_ALL;
+    emu.ie          = (emu.ie & ~RFI_ALL) | ie_sel;
+}
 
+void spirit1_int_txdone() {
+    emu.pending    &= ~RFI_TXEND;
+    emu.ie          = (emu.ie & ~RFI_TXFIFO) | RFI_TXEND;
+}
 
+void spirit1_int_clearall(void) {
+    emu.pending &= ~RFI_ALL;
+}
+
+void spirit1_int_force(ot_u16 ifg_sel) {
+    emu.pending |= ifg_sel;
+    sub_dispatch();
+}
+
+void spirit1_int_turnon(ot_u16 ie_sel) {
+    emu.ie |= ie_sel;
+    sub_dispatch();
+}
+
+void spirit1_int_turnoff(ot_u16 ie_sel)  {
+    emu.pending    &= ~(ot_u32)ie_sel;
+    emu.ie         &= ~(ot_u32)ie_sel;
+}
 
 
 
 
 void spirit1_wfe() {
-    do {
-        __WFE();
+/// Wait for a masked IRQ (AES is the only user), then clear the IRQ mask.
+/// The model is run in 1us steps so that pending chip events still happen.
+    ot_u32  mask;
+    ot_uint watchdog = 10000;
+
+    mask    = ((ot_u32)emu.reg[RFREG(IRQ_MASK3)] << 24) | ((ot_u32)emu.reg[RFREG(IRQ_MASK2)] << 16) \
+            | ((ot_u32)emu.reg[RFREG(IRQ_MASK1)] << 8)  |  (ot_u32)emu.reg[RFREG(IRQ_MASK0)];
+    while (((emu.irq_status & mask) == 0) && (--watchdog)) {
+        spirit1emu_run(1);
     }
-    while((EXTI->PR & RFI_SOURCE2) == 0);
-
-    // clear pending register
-    EXTI->PR = RFI_SOURCE2;
+    emu.pending &= ~RFI_SOURCE2;
 
-    // clear IRQ value in SPIRIT by setting IRQMASK to 0
     {   ot_u8 cmd[8];
-        *(ot_u32*)&cmd[0]   = 0;
-        *(ot_u32*)&cmd[4]   = 0;
-        cmd[1]              = RFREG(IRQ_MASK3);
-        spirit1_burstwrite(6, 0, cmd);
+        memset(cmd, 0, sizeof(cmd));
+        cmd[1] = RFREG(IRQ_MASK3);
+        spirit1_spibus_io(6, 0, cmd);
     }
 }
 
 
-
 void spirit1_wfe_aes() {
-    // Kill any interrupts and activate the WFE event source (always pin 2)
-    EXTI->IMR  &= (RFI_SOURCE2 | RFI_SOURCE1 | RFI_SOURCE0);
-    EXTI->EMR  |= RFI_SOURCE2;
-
     // read-out all IRQ_STATUS bits to clear
     {   ot_u8 cmd[2];
         cmd[0]  = 1;
@@ -470,10 +872,9 @@ void spirit1_wfe_aes() {
     }
 
     // write AES to IRQ MASK
-    spirit1_write(0x40, RFREG(IRQ_MASK3));
+    spirit1_write(RFREG(IRQ_MASK3), 0x40);
 }
 
 
 
 #endif //#if from top of file
-
@@ -16,11 +16,16 @@
 /**
   * @file       /platform/stdc/otlib_rand.c
   * @author     JP Norair
-  * @version    R100
+  * @version    R101
   * @date       27 Oct 2017
   * @brief      Random Number driver for POSIX C & STD C
   * @ingroup    Rand
   *
+  * The PRNG is xoshiro128**, which has 128 bits of state and is very fast. 
+  * State is kept in a context (randctx_t) rather than in libc, so there is 
+  * no global lock, and each simulated node can run its own reproducible 
+  * sequence.  The context is selected per-thread with rand_setctx().
+  *
   ******************************************************************************
   */
 
@@ -29,35 +34,128 @@
 #include <otplatform.h>
 #include <otlib/rand.h>
 
+#include <stdint.h>
 #include <time.h>
-#include <stdlib.h>
 
 
-void rand_stream(ot_u8* rand_out, ot_int bytes_out) {
-    while (--bytes_out >= 0) {
-        *rand_out++ = rand_prn8();
+/// The default context is thread-local, like the selection, so threads that
+/// never call rand_setctx() do not race on shared state.  Each thread starts
+/// from the same seed until it calls rand_prnseed().
+static __thread randctx_t   rand_default = { {0x9E3779B9, 0x243F6A88, 0xB7E15162, 0x5A827999} };
+static __thread randctx_t*  rand_active  = NULL;
+
+#define _ACTIVECTX()    ((rand_active != NULL) ? rand_active : &rand_default)
+
+
+
+/** Context PRNG Routines <BR>
+  * ========================================================================<BR>
+  */
+
+// ot_u32 may be wider than 32 bits on POSIX (LP64), so arithmetic is done
+// on uint32_t and stored back into the context.
+#define _ROTL32(X, K)   (((X) << (K)) | ((X) >> (32 - (K))))
+
+
+void rand_ctxseed(randctx_t* ctx, ot_u32 seed) {
+/// State is expanded from the seed with SplitMix32, which guarantees that
+/// the state is not all zero.
+    ot_int   i;
+    uint32_t x = (uint32_t)seed;
+    uint32_t z;
+    
+    for (i=0; i<4; i++) {
+        x          += 0x9E3779B9;
+        z           = x;
+        z           = (z ^ (z >> 16)) * 0x85EBCA6B;
+        z           = (z ^ (z >> 13)) * 0xC2B2AE35;
+        ctx->s[i]   = z ^ (z >> 16);
     }
 }
 
+
+ot_u32 rand_ctxprn32(randctx_t* ctx) {
+    uint32_t s0 = (uint32_t)ctx->s[0];
+    uint32_t s1 = (uint32_t)ctx->s[1];
+    uint32_t s2 = (uint32_t)ctx->s[2];
+    uint32_t s3 = (uint32_t)ctx->s[3];
+    uint32_t result;
+    
+    result  = _ROTL32(s1 * 5, 7) * 9;
+    s2     ^= s0;
+    s3     ^= s1;
+    s1     ^= s2;
+    s0     ^= s3;
+    s2     ^= ((uint32_t)ctx->s[1] << 9);
+    s3      = _ROTL32(s3, 11);
+    
+    ctx->s[0] = s0;
+    ctx->s[1] = s1;
+    ctx->s[2] = s2;
+    ctx->s[3] = s3;
+    return result;
+}
+
+
+void rand_ctxstream(randctx_t* ctx, ot_u8* rand_out, ot_int bytes_out) {
+    ot_u32 r;
+    
+    while (bytes_out >= 4) {
+        r           = rand_ctxprn32(ctx);
+        rand_out[0] = (ot_u8)r;
+        rand_out[1] = (ot_u8)(r >> 8);
+        rand_out[2] = (ot_u8)(r >> 16);
+        rand_out[3] = (ot_u8)(r >> 24);
+        rand_out   += 4;
+        bytes_out  -= 4;
+    }
+    if (bytes_out > 0) {
+        r = rand_ctxprn32(ctx);
+        while (--bytes_out >= 0) {
+            *rand_out++ = (ot_u8)r;
+            r >>= 8;
+        }
+    }
+}
+
+
+randctx_t* rand_setctx(randctx_t* ctx) {
+    randctx_t* prev = rand_active;
+    rand_active     = ctx;
+    return prev;
+}
+
+
+
+
+/** Platform Random Number Generation Routines <BR>
+  * ========================================================================<BR>
+  * These operate on the context selected by the calling thread.
+  */
+
+void rand_stream(ot_u8* rand_out, ot_int bytes_out) {
+    rand_ctxstream(_ACTIVECTX(), rand_out, bytes_out);
+}
+
 void rand_prnseed(ot_u32 seed) {
     if (seed == 0) {
         seed = time(NULL);
     }
-    srand(seed);
+    rand_ctxseed(_ACTIVECTX(), seed);
 }
 
 
 ot_u32 rand_prn32() {
-    return (ot_u32)rand();
+    return rand_ctxprn32(_ACTIVECTX());
 }
 
 
 ot_u8 rand_prn8() {
-    return (ot_u8)(rand() & 255);
+    return (ot_u8)(rand_ctxprn32(_ACTIVECTX()) >> 24);
 }
 
 
 ot_u16 rand_prn16() {
-    return (ot_u8)(rand() & 65535);
+    return (ot_u16)(rand_ctxprn32(_ACTIVECTX()) >> 16);
 }
 